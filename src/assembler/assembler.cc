@@ -2,26 +2,25 @@
 
 namespace assembler {
 
-Assembler::Assembler() {
+Assembler::Assembler()
+  : pool_(std::make_shared<BufferPool>()) {
 }
 
-std::vector<std::unique_ptr<SessionPDU>> Assembler::process(const VCDU& vcdu) {
-  std::vector<std::unique_ptr<SessionPDU>> out;
-
+void Assembler::process(const VCDU& vcdu, const SessionPDUSink& sink) {
   // Ignore fill packets
   auto vcid = vcdu.getVCID();
   if (vcid == 63) {
-    return out;
+    return;
   }
 
   // Create virtual channel instance if it does not yet exist
-  if (vcs_.find(vcid) == vcs_.end()) {
-    vcs_.insert(std::make_pair(vcid, VirtualChannel(vcid)));
+  auto it = vcs_.find(vcid);
+  if (it == vcs_.end()) {
+    it = vcs_.insert(std::make_pair(vcid, VirtualChannel(vcid, pool_))).first;
   }
 
   // Let virtual channel process VCDU
-  auto it = vcs_.find(vcid);
-  return it->second.process(vcdu);
+  it->second.process(vcdu, sink);
 }
 
 } // namespace assembler
@@ -1,7 +1,9 @@
 #pragma once
 
 #include <map>
+#include <memory>
 
+#include "assembler/buffer_pool.h"
 #include "assembler/virtual_channel.h"
 
 namespace assembler {
@@ -12,12 +14,15 @@ class Assembler {
 public:
   explicit Assembler();
 
-  // For every packet processed, we may get back multiple completed
-  // Session PDUs for further processing.
-  std::vector<std::unique_ptr<SessionPDU>> process(const VCDU& p);
+  // For every packet processed, we may complete multiple
+  // Session PDUs, which are passed to the sink.
+  void process(const VCDU& p, const SessionPDUSink& sink);
 
 protected:
   std::map<int, VirtualChannel> vcs_;
+
+  // Buffers for Session PDUs, shared by all virtual channels
+  std::shared_ptr<BufferPool> pool_;
 };
 
 } // namespace assembler
@@ -0,0 +1,30 @@
+#include "buffer_pool.h"
+
+namespace assembler {
+
+BufferPool::BufferPool(size_t maxBuffers)
+  : maxBuffers_(maxBuffers) {
+  free_.reserve(maxBuffers_);
+}
+
+std::vector<uint8_t> BufferPool::get() {
+  if (free_.empty()) {
+    return std::vector<uint8_t>();
+  }
+
+  // Most recently used buffer is most likely to be in cache
+  auto buf = std::move(free_.back());
+  free_.pop_back();
+  return buf;
+}
+
+void BufferPool::put(std::vector<uint8_t> buf) {
+  if (free_.size() >= maxBuffers_ || buf.capacity() == 0) {
+    return;
+  }
+
+  buf.clear();
+  free_.push_back(std::move(buf));
+}
+
+} // namespace assembler
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace assembler {
+
+// Keeps the buffers of Session PDUs that have been handed out and are
+// no longer used, so that the next Session PDUs can reuse them (and
+// the capacity they have grown to) instead of allocating from scratch.
+//
+// Not thread safe; it is shared by the virtual channels of an assembler.
+//
+class BufferPool {
+public:
+  explicit BufferPool(size_t maxBuffers = 8);
+
+  // Returns an empty buffer (recycled if possible).
+  std::vector<uint8_t> get();
+
+  // Returns buffer to the pool. It is dropped if the pool is full.
+  void put(std::vector<uint8_t> buf);
+
+protected:
+  const size_t maxBuffers_;
+  std::vector<std::vector<uint8_t>> free_;
+};
+
+} // namespace assembler
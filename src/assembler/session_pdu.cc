@@ -1,15 +1,26 @@
 #include "session_pdu.h"
 
+#include <algorithm>
 #include <iostream>
 
 namespace assembler {
 
-SessionPDU::SessionPDU(int vcid, int apid)
+namespace {
+
+// Upper bound on the capacity that is reserved up front,
+// in case the primary header is bogus.
+constexpr uint64_t maxReserveBytes = 64 * 1024 * 1024;
+
+} // namespace
+
+SessionPDU::SessionPDU(int vcid, int apid, std::vector<uint8_t> buf)
   : vcid(vcid),
     apid(apid),
+    buf_(std::move(buf)),
     remainingHeaderBytes_(0),
     lastSequenceCount_(0),
     linesDone_(0) {
+  buf_.clear();
 }
 
 std::string SessionPDU::getName() const {
@@ -176,6 +187,11 @@ bool SessionPDU::append(
       return true;
     }
     ph_ = lrit::getHeader<lrit::PrimaryHeader>(buf_, 0);
+
+    // The final size is known from the primary header, so reserve
+    // capacity once instead of growing the buffer as data comes in.
+    auto size = ph_.totalHeaderLength + ((ph_.dataLength + 7) / 8);
+    buf_.reserve(std::min(size, maxReserveBytes));
   }
 
   // Copy secondary headers verbatim
@@ -35,7 +35,12 @@ int diffWithWrap(unsigned int a, unsigned int b) {
 
 class SessionPDU {
 public:
-  explicit SessionPDU(int vcid, int apid);
+  // The buffer (if specified) is cleared and used to hold the contents
+  // of this session PDU, so that its capacity can be reused.
+  explicit SessionPDU(
+    int vcid,
+    int apid,
+    std::vector<uint8_t> buf = std::vector<uint8_t>());
 
   // Returns false if this T_PDU could not be added.
   // This is the case if -- for example -- it contains a
@@ -71,6 +76,13 @@ public:
     return buf_.size();
   }
 
+  // Moves the buffer out of this session PDU (for reuse).
+  // This session PDU is empty afterwards.
+  std::vector<uint8_t> release() {
+    m_.clear();
+    return std::move(buf_);
+  }
+
   const lrit::HeaderMap& getHeaderMap() const {
     return m_;
   }
@@ -34,7 +34,7 @@ size_t TransportPDU::read(const uint8_t* buf, size_t len) {
   return nread;
 }
 
-bool TransportPDU::verifyCRC() {
+bool TransportPDU::verifyCRC() const {
   if (length() >= 2) {
     return (::assembler::crc(&data[0], length() - 2) == this->crc());
   } else {
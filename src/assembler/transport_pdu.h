@@ -21,6 +21,16 @@ public:
 
   size_t read(const uint8_t* buf, size_t len);
 
+  // Clears contents so the buffers can be reused for the next TP_PDU
+  void clear() {
+    header.clear();
+    data.clear();
+  }
+
+  bool empty() const {
+    return header.empty();
+  }
+
   bool headerComplete() {
     return (header.size() == headerBytes);
   }
@@ -72,7 +82,7 @@ public:
     return (b[0] << 8) | b[1];
   }
 
-  bool verifyCRC();
+  bool verifyCRC() const;
 
   std::vector<uint8_t> header;
   std::vector<uint8_t> data;
@@ -6,13 +6,12 @@
 
 namespace assembler {
 
-VirtualChannel::VirtualChannel(int id)
-  : id_(id), n_(-1) {
+VirtualChannel::VirtualChannel(int id, std::shared_ptr<BufferPool> pool)
+  : id_(id), n_(-1), pool_(std::move(pool)) {
 }
 
 // Combine virtual VirtualChannel packets into transport PDUs.
-std::vector<std::unique_ptr<SessionPDU>> VirtualChannel::process(const VCDU& vcdu) {
-  std::vector<std::unique_ptr<SessionPDU>> out;
+void VirtualChannel::process(const VCDU& vcdu, const SessionPDUSink& sink) {
   uint16_t firstHeader;
   size_t pos;
 
@@ -29,7 +28,7 @@ std::vector<std::unique_ptr<SessionPDU>> VirtualChannel::process(const VCDU& vcd
         << "; packet: " << vcdu.getCounter()
         << ")"
         << std::endl;
-      tpdu_.reset();
+      tpdu_.clear();
     }
   }
 
@@ -49,11 +48,11 @@ std::vector<std::unique_ptr<SessionPDU>> VirtualChannel::process(const VCDU& vcd
 
   // Resume extracting a packet if we still have a pointer
   pos = 0;
-  if (tpdu_) {
+  if (!tpdu_.empty()) {
     // Double check that the number of bytes left to read correspond
     // with the first header pointer. The latter takes precedence.
-    if (tpdu_->headerComplete()) {
-      auto bytesNeeded = tpdu_->length() - tpdu_->data.size();
+    if (tpdu_.headerComplete()) {
+      auto bytesNeeded = tpdu_.length() - tpdu_.data.size();
       // If the first header pointer is 2047, there is no additional
       // header in the VCDU and we can read the entire thing.
       auto bytesAvailable = (firstHeader == 2047) ? len : firstHeader;
@@ -63,7 +62,7 @@ std::vector<std::unique_ptr<SessionPDU>> VirtualChannel::process(const VCDU& vcd
         // if they are aligned on the VCDU boundary. I suspect this
         // number comes from the the 6 header bytes in a VCDU and
         // that this is a mistake in the HRIT feed assembly code.
-        if (!(bytesAvailable == 0 && bytesNeeded == 6 && tpdu_->apid() == 2047)) {
+        if (!(bytesAvailable == 0 && bytesNeeded == 6 && tpdu_.apid() == 2047)) {
           std::cerr
             <<  "VC " << id_
             << ": M_SDU continuation failed; "
@@ -71,48 +70,49 @@ std::vector<std::unique_ptr<SessionPDU>> VirtualChannel::process(const VCDU& vcd
             << bytesAvailable << " byte(s) available"
             << std::endl;
         }
-        tpdu_.reset();
+        tpdu_.clear();
       } else {
-        pos += tpdu_->read(&data[pos], len - pos);
-        if (tpdu_->dataComplete()) {
-          process(std::move(tpdu_), out);
+        pos += tpdu_.read(&data[pos], len - pos);
+        if (tpdu_.dataComplete()) {
+          process(tpdu_, sink);
+          tpdu_.clear();
         }
       }
     } else {
-      pos += tpdu_->read(&data[pos], len - pos);
-      if (tpdu_->dataComplete()) {
-        process(std::move(tpdu_), out);
+      pos += tpdu_.read(&data[pos], len - pos);
+      if (tpdu_.dataComplete()) {
+        process(tpdu_, sink);
+        tpdu_.clear();
       }
     }
 
     // Return early if we consumed all bytes
     if (pos == len) {
-      return out;
+      return;
     }
   }
 
   // Must have pointer to first header to continue
   if (firstHeader == 2047) {
-    return out;
+    return;
   }
 
   // Extract TP_PDUs until there is no more data
   pos = firstHeader;
   while (pos < len) {
-    tpdu_ = std::unique_ptr<TransportPDU>(new TransportPDU);
-    pos += tpdu_->read(&data[pos], len - pos);
-    if (tpdu_->dataComplete()) {
-      process(std::move(tpdu_), out);
+    tpdu_.clear();
+    pos += tpdu_.read(&data[pos], len - pos);
+    if (tpdu_.dataComplete()) {
+      process(tpdu_, sink);
+      tpdu_.clear();
     }
   }
-
-  return out;
 }
 
 void VirtualChannel::process(
-    std::unique_ptr<TransportPDU> tpdu,
-    std::vector<std::unique_ptr<SessionPDU>>& out) {
-  auto apid = tpdu->apid();
+    const TransportPDU& tpdu,
+    const SessionPDUSink& sink) {
+  auto apid = tpdu.apid();
 
   // Ignore fill packets
   if (apid == 2047) {
@@ -120,7 +120,7 @@ void VirtualChannel::process(
   }
 
   // Verify CRC is correct
-  if (!tpdu->verifyCRC()) {
+  if (!tpdu.verifyCRC()) {
     std::cerr
       << "VC "
       << id_
@@ -129,7 +129,7 @@ void VirtualChannel::process(
 
     // Clear state for this APID.
     apidSeq_.erase(apid);
-    apidSessionPDU_.erase(apid);
+    erase(apid);
     return;
   }
 
@@ -140,7 +140,7 @@ void VirtualChannel::process(
   //
   // Sanity check on this counter to protect against drops.
   //
-  auto seq = tpdu->sequenceCount();
+  auto seq = tpdu.sequenceCount();
   if (apidSeq_.count(apid) > 0) {
     auto skip = diffWithWrap<16384>(apidSeq_[apid], seq) - 1;
     if (skip > 0) {
@@ -166,7 +166,7 @@ void VirtualChannel::process(
   //   user data file still extending through subsequent packets;
   // - Set to 2 if the user data contains the last segment of a user data
   //   file beginning in an earlier packet.
-  auto flag = tpdu->sequenceFlag();
+  auto flag = tpdu.sequenceFlag();
   if (flag == 3 || flag == 1) {
     auto it = apidSessionPDU_.find(apid);
     if (it != apidSessionPDU_.end()) {
@@ -188,21 +188,22 @@ void VirtualChannel::process(
           << apid
           << " (" << spdu->getName() << ")"
           << std::endl;
-        finish(std::move(spdu), out);
+        finish(std::move(spdu), sink);
       }
 
       // Erase pending S_PDU as it won't be finished now
-      apidSessionPDU_.erase(apid);
+      erase(apid);
     }
 
-    auto spdu = std::make_unique<SessionPDU>(id_, apid);
-    if (!spdu->append(*tpdu)) {
+    auto spdu = std::make_unique<SessionPDU>(id_, apid, pool_->get());
+    if (!spdu->append(tpdu)) {
       std::cerr
         << "VC "
         << id_
         << ": Invalid first S_PDU for APID "
         << apid
         << std::endl;
+      pool_->put(spdu->release());
     } else {
       // Check if this S_PDU is contained in a single TP_PDU
       if (flag == 3) {
@@ -213,8 +214,9 @@ void VirtualChannel::process(
             << ": Zero length S_PDU for APID "
             << apid
             << std::endl;
+          pool_->put(spdu->release());
         } else {
-          finish(std::move(spdu), out);
+          finish(std::move(spdu), sink);
         }
       } else {
         // Expecting subsequent TP_PDUs to fill this S_PDU
@@ -238,7 +240,7 @@ void VirtualChannel::process(
     } else {
       // Append data from TP_PDU to S_PDU
       auto& spdu = it->second;
-      if (!spdu->append(*tpdu)) {
+      if (!spdu->append(tpdu)) {
         std::cerr
           << "VC "
           << id_
@@ -257,44 +259,63 @@ void VirtualChannel::process(
             << apid
             << " (" << spdu->getName() << ")"
             << std::endl;
-          finish(std::move(spdu), out);
+          finish(std::move(spdu), sink);
         }
 
         // Erase S_PDU regardless if it was finished or not
-        apidSessionPDU_.erase(apid);
+        erase(apid);
       } else {
         // Successfully appended TP_PDU to S_PDU
         if (flag == 2) {
-          finish(std::move(spdu), out);
-          apidSessionPDU_.erase(apid);
+          finish(std::move(spdu), sink);
+          erase(apid);
         }
       }
     }
   }
 }
 
-// Add session PDU to output vector if sanity checks pass
+// Pass session PDU to sink if sanity checks pass
 void VirtualChannel::finish(
     std::unique_ptr<SessionPDU> spdu,
-    std::vector<std::unique_ptr<SessionPDU>>& out) {
+    const SessionPDUSink& sink) {
+  bool ok = false;
+
   // Must have complete header
   if (spdu->hasCompleteHeader()) {
     // Ensure that the reported size is equal to the actual size
     auto ph = spdu->getPrimaryHeader();
     auto size = ph.totalHeaderLength + ((ph.dataLength + 7) / 8);
-    if (size == spdu->size()) {
-      out.push_back(std::move(spdu));
-      return;
-    }
+    ok = (size == spdu->size());
+  }
+
+  if (ok) {
+    sink(*spdu);
+  } else {
+    std::cerr
+      << "VC "
+      << spdu->vcid
+      << ": Dropping malformed S_PDU for APID "
+      << spdu->apid
+      << " (" << spdu->size() << " bytes)"
+      << std::endl;
   }
 
-  std::cerr
-    << "VC "
-    << spdu->vcid
-    << ": Dropping malformed S_PDU for APID "
-    << spdu->apid
-    << " (" << spdu->size() << " bytes)"
-    << std::endl;
+  // The sink is done with the buffer
+  pool_->put(spdu->release());
+}
+
+void VirtualChannel::erase(int apid) {
+  auto it = apidSessionPDU_.find(apid);
+  if (it == apidSessionPDU_.end()) {
+    return;
+  }
+
+  // The S_PDU may have been moved out to be finished
+  if (it->second) {
+    pool_->put(it->second->release());
+  }
+  apidSessionPDU_.erase(it);
 }
 
 } // namespace assembler
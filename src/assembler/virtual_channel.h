@@ -1,43 +1,52 @@
 #pragma once
 
+#include <functional>
 #include <map>
 #include <memory>
 #include <vector>
 
+#include "buffer_pool.h"
 #include "session_pdu.h"
 #include "transport_pdu.h"
 #include "vcdu.h"
 
 namespace assembler {
 
+// Called for every completed Session PDU. The Session PDU (and its
+// buffer) is only valid for the duration of the call.
+using SessionPDUSink = std::function<void(const SessionPDU&)>;
+
 class VirtualChannel {
 public:
-  explicit VirtualChannel(int id);
+  explicit VirtualChannel(int id, std::shared_ptr<BufferPool> pool);
 
-  // For every packet processed, we may get back multiple completed
-  // Session PDUs for further processing.
-  std::vector<std::unique_ptr<SessionPDU>> process(const VCDU& p);
+  // For every packet processed, we may complete multiple
+  // Session PDUs, which are passed to the sink.
+  void process(const VCDU& p, const SessionPDUSink& sink);
 
 protected:
-  void process(
-    std::unique_ptr<TransportPDU> tpdu,
-    std::vector<std::unique_ptr<SessionPDU>>& out);
+  void process(const TransportPDU& tpdu, const SessionPDUSink& sink);
+
+  void finish(std::unique_ptr<SessionPDU> spdu, const SessionPDUSink& sink);
 
-  void finish(
-    std::unique_ptr<SessionPDU> spdu,
-    std::vector<std::unique_ptr<SessionPDU>>& out);
+  // Drops incomplete Session PDU for APID (if any)
+  void erase(int apid);
 
   int id_;
   int n_;
 
-  // Incomplete Transport Protocol Data Unit.
-  std::unique_ptr<TransportPDU> tpdu_;
+  // Incomplete Transport Protocol Data Unit (empty if there is none).
+  // Its buffers are reused for every TP_PDU on this virtual channel.
+  TransportPDU tpdu_;
 
   // Sequence number by APID. Used to detect drops.
   std::map<int, int> apidSeq_;
 
   // Incomplete Session Protocol Data Unit per APID.
   std::map<int, std::unique_ptr<SessionPDU>> apidSessionPDU_;
+
+  // Buffers for Session PDUs
+  std::shared_ptr<BufferPool> pool_;
 };
 
 } // namespace assembler
@@ -0,0 +1,123 @@
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "derandomizer.h"
+
+using namespace decoder;
+
+class Timer {
+public:
+  Timer() {
+    start();
+  }
+
+  void start() {
+    start_ = std::chrono::high_resolution_clock::now();
+  }
+
+  long long ns() const {
+    auto now = std::chrono::high_resolution_clock::now();
+    return std::chrono::nanoseconds(now - start_).count();
+  }
+
+protected:
+  std::chrono::time_point<std::chrono::high_resolution_clock> start_;
+};
+
+// Size of the Viterbi decoder output for a frame
+// (frame prelude, sync word, and code block).
+constexpr auto packetBytes = 4 + 1024;
+constexpr auto skip = 8;
+constexpr auto len = packetBytes - skip;
+
+// Previous post-Viterbi transforms, kept to compare against.
+// Every transform is a separate pass over the packet, one byte at a
+// time, and the frame prelude and sync word are dropped with memmove.
+void reference(
+    Derandomizer& derandomizer,
+    std::array<uint8_t, packetBytes>& packet,
+    Derandomizer::Coding coding) {
+  if (coding == Derandomizer::INVERTED) {
+    for (unsigned i = 0; i < packet.size(); i++) {
+      packet[i] ^= 0xff;
+    }
+  }
+
+  if (coding == Derandomizer::NRZM) {
+    uint8_t b0 = 0;
+    uint8_t m;
+    auto data = packet.data();
+    for (unsigned i = 0; i < packet.size(); i++) {
+      m = (b0 << 7) | ((data[i] >> 1) & 0x7f);
+      b0 = data[i] & 0x1;
+      data[i] ^= m;
+    }
+  }
+
+  memmove(&packet[0], &packet[skip], packet.size() - skip);
+  derandomizer.run(&packet[0], len);
+}
+
+// Run both implementations on the same random packets, report the
+// number of packets where their output differs, and the time spent
+// per packet.
+void compare(Derandomizer::Coding coding) {
+  Derandomizer derandomizer;
+  const size_t n = 4096;
+  std::mt19937 gen(0);
+  std::vector<std::array<uint8_t, packetBytes> > packets(n);
+  for (auto& packet : packets) {
+    for (auto& b : packet) {
+      b = gen();
+    }
+  }
+
+  std::vector<std::array<uint8_t, packetBytes> > out0(packets);
+  std::vector<std::array<uint8_t, len> > out1(n);
+
+  Timer dt;
+  for (size_t i = 0; i < n; i++) {
+    reference(derandomizer, out0[i], coding);
+  }
+  const auto referenceNs = dt.ns();
+
+  dt.start();
+  for (size_t i = 0; i < n; i++) {
+    derandomizer.run(&packets[i][skip], out1[i].data(), len, coding);
+  }
+  const auto fusedNs = dt.ns();
+
+  size_t mismatches = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (memcmp(out0[i].data(), out1[i].data(), len) != 0) {
+      mismatches++;
+    }
+  }
+
+  std::cerr.setf(std::ios::fixed, std:: ios::floatfield);
+  std::cerr.precision(3);
+  std::cerr << "  Time per packet (reference): " << (float) referenceNs / n << "ns" << std::endl;
+  std::cerr << "  Time per packet:             " << (float) fusedNs / n << "ns" << std::endl;
+  std::cerr << "  Mismatches:                  " << mismatches << std::endl;
+}
+
+int main(int argc, char** argv) {
+  std::string name;
+  if (argc == 2) {
+    name = std::string(argv[1]);
+  }
+
+  if (name.empty() || name == "derandomizer") {
+    std::cerr << "Derandomizer (LRIT)" << std::endl;
+    compare(Derandomizer::NONE);
+    std::cerr << "Derandomizer (LRIT, 180 degree phase)" << std::endl;
+    compare(Derandomizer::INVERTED);
+    std::cerr << "Derandomizer (HRIT, NRZ-M)" << std::endl;
+    compare(Derandomizer::NRZM);
+  }
+}
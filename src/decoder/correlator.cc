@@ -1,5 +1,17 @@
 #include "correlator.h"
 
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+#ifdef HAVE_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
 namespace decoder {
 
 namespace {
@@ -16,6 +28,68 @@ const uint64_t encodedSyncWords[4] = {
   0xdafef4fd0cc2df89,
 };
 
+// Number of sync words (and correlation scores per position)
+constexpr size_t numSyncWords = 4;
+
+// Sync words with the first bit in the LSB (instead of the MSB),
+// to match the order of the hard bits packed by Correlator.
+const uint64_t* reversedSyncWords() {
+  static const auto words = [] {
+    std::array<uint64_t, numSyncWords> out;
+    for (size_t j = 0; j < numSyncWords; j++) {
+      out[j] = 0;
+      for (unsigned k = 0; k < 64; k++) {
+        out[j] |= ((encodedSyncWords[j] >> (63 - k)) & 0x1) << k;
+      }
+    }
+    return out;
+  }();
+  return words.data();
+}
+
+// Loads 8 bytes as a little endian 64-bit integer
+inline uint64_t load64(const uint8_t* p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  v = __builtin_bswap64(v);
+#endif
+  return v;
+}
+
+// Returns the 64 hard bits starting at position i.
+// Reads one byte past the last byte holding these bits.
+inline uint64_t window(const uint8_t* packed, size_t i) {
+  const unsigned r = i & 0x7;
+  const uint64_t lo = load64(&packed[i >> 3]);
+  const uint64_t hi = packed[(i >> 3) + 8];
+  return (lo >> r) | ((hi << 1) << (63 - r));
+}
+
+// Packs 8 soft bits into a byte with the first bit in the LSB
+inline uint8_t pack8(const uint8_t* data) {
+  uint64_t x = (load64(data) >> 7) & 0x0101010101010101ULL;
+  return (x * 0x0102040810204080ULL) >> 56;
+}
+
+// Correlation for every position in [begin, end). This is inlined
+// into the target specific functions below so that the popcount
+// compiles to a single instruction where the target supports it.
+__attribute__((always_inline))
+inline void scoreLoop(
+    const uint8_t* packed,
+    uint8_t* scores,
+    size_t begin,
+    size_t end) {
+  const auto words = reversedSyncWords();
+  for (size_t i = begin; i < end; i++) {
+    const auto w = window(packed, i);
+    for (size_t j = 0; j < numSyncWords; j++) {
+      scores[i * numSyncWords + j] = 64 - __builtin_popcountll(w ^ words[j]);
+    }
+  }
+}
+
 } // namespace
 
 const unsigned encodedSyncWordBits = 64;
@@ -34,7 +108,7 @@ const char* correlationTypeToString(correlationType t) {
   return "";
 }
 
-int correlate(uint8_t* data, size_t len, int* maxOut, correlationType* maxType) {
+int correlate(const uint8_t* data, size_t len, int* maxOut, correlationType* maxType) {
   uint64_t tmp = 0;
 
   // Position with maximum correlation
@@ -53,7 +127,7 @@ int correlate(uint8_t* data, size_t len, int* maxOut, correlationType* maxType)
 
     // Match tmp against encoded sync words
     for (unsigned j = 0; j < 4; j++) {
-      auto v = 64 - __builtin_popcount(tmp ^ encodedSyncWords[j]);
+      auto v = 64 - __builtin_popcountll(tmp ^ encodedSyncWords[j]);
       if (v > max[j]) {
         max[j] = v;
         pos[j] = i - (encodedSyncWordBits - 1);
@@ -78,4 +152,369 @@ int correlate(uint8_t* data, size_t len, int* maxOut, correlationType* maxType)
   return pos[j];
 }
 
+Correlator::Correlator() : valid_(0) {
+}
+
+void Correlator::reset() {
+  valid_ = 0;
+}
+
+void Correlator::discard(size_t n) {
+  if (n >= valid_) {
+    valid_ = 0;
+    return;
+  }
+
+  valid_ -= n;
+  memmove(
+    &scores_[0],
+    &scores_[n * numSyncWords],
+    valid_ * numSyncWords);
+}
+
+int Correlator::run(
+    const uint8_t* data,
+    size_t len,
+    int* maxOut,
+    correlationType* maxType) {
+  const size_t npos = (len >= encodedSyncWordBits)
+    ? len - (encodedSyncWordBits - 1)
+    : 0;
+
+  // Allow reading past the last byte (see window()), and processing
+  // scores in chunks of 32 bytes (see findMax()).
+  packed_.resize((len / 8) + 16);
+  scores_.resize((npos * numSyncWords) + 32);
+  if (valid_ > npos) {
+    valid_ = npos;
+  }
+
+  // Pack hard bits for positions that were not yet correlated
+  const size_t begin = valid_ & ~((size_t) 0x7);
+  const size_t end = len & ~((size_t) 0x7);
+  pack(data, begin, end);
+  if (end < len) {
+    uint8_t tail = 0;
+    for (size_t i = end; i < len; i++) {
+      tail |= ((data[i] >> 7) & 0x1) << (i - end);
+    }
+    packed_[end / 8] = tail;
+  }
+
+  score(valid_, npos);
+  valid_ = npos;
+
+  // Padding must not affect the maximum
+  memset(
+    &scores_[npos * numSyncWords],
+    0,
+    scores_.size() - (npos * numSyncWords));
+
+  int max[numSyncWords];
+  int pos[numSyncWords];
+  findMax(npos, max, pos);
+
+  // Return position for best correlating sync word
+  int j = 0;
+  for (unsigned i = 0; i < numSyncWords; i++) {
+    if (max[i] > max[j]) {
+      j = i;
+    }
+  }
+
+  if (maxOut != nullptr) {
+    *maxOut = max[j];
+  }
+  if (maxType != nullptr) {
+    *maxType = static_cast<correlationType>(j);
+  }
+  return pos[j];
+}
+
+void Correlator::pack(const uint8_t* data, size_t begin, size_t end) {
+#ifdef HAVE_X86_DISPATCH
+  if (util::cpu::level() >= util::cpu::AVX2) {
+    packAVX2(data, begin, end);
+    return;
+  }
+  if (util::cpu::level() >= util::cpu::SSE41) {
+    packSSE41(data, begin, end);
+    return;
+  }
+#endif
+
+  size_t i = begin;
+
+#ifdef __ARM_NEON
+  // Shift the MSB of every byte to the position it has
+  // in the packed byte, and add up pairs until every
+  // 64-bit lane holds 8 bits.
+  const int8_t shifts[16] = {
+    -7, -6, -5, -4, -3, -2, -1, 0,
+    -7, -6, -5, -4, -3, -2, -1, 0,
+  };
+  const int8x16_t shift = vld1q_s8(shifts);
+  const uint8x16_t mask = vdupq_n_u8(0x80);
+  for (; i + 16 <= end; i += 16) {
+    uint8x16_t v = vandq_u8(vld1q_u8(&data[i]), mask);
+    v = vshlq_u8(v, shift);
+    uint64x2_t s = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(v)));
+    packed_[(i / 8) + 0] = vgetq_lane_u64(s, 0);
+    packed_[(i / 8) + 1] = vgetq_lane_u64(s, 1);
+  }
+#endif
+
+  for (; i < end; i += 8) {
+    packed_[i / 8] = pack8(&data[i]);
+  }
+}
+
+void Correlator::score(size_t begin, size_t end) {
+#ifdef HAVE_X86_DISPATCH
+  if (util::cpu::level() >= util::cpu::AVX2) {
+    scoreAVX2(begin, end);
+    return;
+  }
+  if (util::cpu::level() >= util::cpu::SSE41) {
+    scoreSSE41(begin, end);
+    return;
+  }
+#endif
+
+  scoreLoop(packed_.data(), scores_.data(), begin, end);
+}
+
+void Correlator::findMax(size_t npos, int* max, int* pos) {
+#ifdef HAVE_X86_DISPATCH
+  if (util::cpu::level() >= util::cpu::AVX2) {
+    findMaxAVX2(npos, max, pos);
+    return;
+  }
+  if (util::cpu::level() >= util::cpu::SSE41) {
+    findMaxSSE41(npos, max, pos);
+    return;
+  }
+#endif
+
+  for (size_t j = 0; j < numSyncWords; j++) {
+    max[j] = 0;
+    pos[j] = 0;
+  }
+
+  for (size_t i = 0; i < npos; i++) {
+    for (size_t j = 0; j < numSyncWords; j++) {
+      const int v = scores_[i * numSyncWords + j];
+      if (v > max[j]) {
+        max[j] = v;
+        pos[j] = i;
+      }
+    }
+  }
+}
+
+#ifdef HAVE_X86_DISPATCH
+
+namespace {
+
+// Count bits per byte with a nibble lookup table
+TARGET_SSE41 __attribute__((always_inline))
+inline __m128i popcount8(__m128i x) {
+  const __m128i lut = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m128i low = _mm_set1_epi8(0x0f);
+  const __m128i lo = _mm_shuffle_epi8(lut, _mm_and_si128(x, low));
+  const __m128i hi = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(x, 4), low));
+  return _mm_add_epi8(lo, hi);
+}
+
+// Returns mask with bit k set if the score at byte i + k equals the
+// maximum for its sync word. Byte j of target holds the maximum for
+// sync word j. These are functors instead of lambdas because lambdas
+// don't inherit the target attribute of the enclosing function.
+struct EqualSSE41 {
+  static constexpr size_t width = 16;
+  const uint8_t* scores;
+  uint32_t target;
+
+  TARGET_SSE41 uint32_t operator()(size_t i) const {
+    const __m128i v = _mm_loadu_si128((const __m128i*) &scores[i]);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi32(target)));
+  }
+};
+
+struct EqualAVX2 {
+  static constexpr size_t width = 32;
+  const uint8_t* scores;
+  uint32_t target;
+
+  TARGET_AVX2 uint32_t operator()(size_t i) const {
+    const __m256i v = _mm256_loadu_si256((const __m256i*) &scores[i]);
+    return _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi32(target)));
+  }
+};
+
+// Find first position with maximum correlation for every sync word.
+template <typename Equal>
+__attribute__((always_inline))
+inline void findFirst(
+    size_t npos,
+    const Equal& equal,
+    int* max,
+    int* pos) {
+  unsigned pending = 0;
+  for (size_t j = 0; j < numSyncWords; j++) {
+    max[j] = (equal.target >> (8 * j)) & 0xff;
+    pos[j] = 0;
+    pending |= 1 << j;
+  }
+
+  for (size_t i = 0; pending && i < npos * numSyncWords; i += Equal::width) {
+    uint32_t bits = equal(i);
+    while (bits) {
+      const unsigned k = __builtin_ctz(bits);
+      const unsigned j = k % numSyncWords;
+      if (pending & (1 << j)) {
+        pos[j] = (i + k) / numSyncWords;
+        pending &= ~(1 << j);
+      }
+      bits &= bits - 1;
+    }
+  }
+}
+
+} // namespace
+
+void Correlator::packSSE41(const uint8_t* data, size_t begin, size_t end) {
+  size_t i = begin;
+  for (; i + 16 <= end; i += 16) {
+    const unsigned m = _mm_movemask_epi8(_mm_loadu_si128((const __m128i*) &data[i]));
+    packed_[(i / 8) + 0] = m & 0xff;
+    packed_[(i / 8) + 1] = m >> 8;
+  }
+  for (; i < end; i += 8) {
+    packed_[i / 8] = pack8(&data[i]);
+  }
+}
+
+void Correlator::packAVX2(const uint8_t* data, size_t begin, size_t end) {
+  size_t i = begin;
+  for (; i + 32 <= end; i += 32) {
+    const uint32_t m = _mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*) &data[i]));
+    memcpy(&packed_[i / 8], &m, sizeof(m));
+  }
+  _mm256_zeroupper();
+  for (; i < end; i += 8) {
+    packed_[i / 8] = pack8(&data[i]);
+  }
+}
+
+void Correlator::scoreSSE41(size_t begin, size_t end) {
+  const auto words = reversedSyncWords();
+  const __m128i w01 = _mm_set_epi64x(words[1], words[0]);
+  const __m128i w23 = _mm_set_epi64x(words[3], words[2]);
+  const __m128i order = _mm_setr_epi8(0, 8, 4, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+  const __m128i total = _mm_set1_epi8(64);
+  const uint8_t* packed = packed_.data();
+  uint8_t* scores = scores_.data();
+
+  // Correlate every position with all 4 sync words at once
+  for (size_t i = begin; i < end; i++) {
+    const __m128i w = _mm_set1_epi64x(window(packed, i));
+    const __m128i c01 = _mm_sad_epu8(popcount8(_mm_xor_si128(w, w01)), _mm_setzero_si128());
+    const __m128i c23 = _mm_sad_epu8(popcount8(_mm_xor_si128(w, w23)), _mm_setzero_si128());
+
+    // Count for sync word j ends up in byte j
+    __m128i c = _mm_or_si128(c01, _mm_slli_epi64(c23, 32));
+    c = _mm_sub_epi8(total, _mm_shuffle_epi8(c, order));
+    const uint32_t v = _mm_cvtsi128_si32(c);
+    memcpy(&scores[i * numSyncWords], &v, sizeof(v));
+  }
+}
+
+void Correlator::scoreAVX2(size_t begin, size_t end) {
+  const auto words = reversedSyncWords();
+  const __m256i lut = _mm256_setr_epi8(
+    0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+    0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low = _mm256_set1_epi8(0x0f);
+  const __m256i total = _mm256_set1_epi8(64);
+  const __m256i even = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+  const __m256i shift[2] = {
+    _mm256_setr_epi64x(0, 1, 2, 3),
+    _mm256_setr_epi64x(4, 5, 6, 7),
+  };
+  const uint8_t* packed = packed_.data();
+  uint8_t* scores = scores_.data();
+
+  // Positions up to the first multiple of 8 (the popcnt
+  // instruction is available with the AVX2 target)
+  const size_t head = std::min(end, (begin + 7) & ~((size_t) 0x7));
+  scoreLoop(packed, scores, begin, head);
+
+  // Correlate the 8 positions that start in the same packed byte,
+  // 4 positions per register (one per 64-bit lane).
+  size_t i = head;
+  for (; i + 8 <= end; i += 8) {
+    const __m256i lo = _mm256_set1_epi64x(load64(&packed[i >> 3]));
+    const __m256i hi = _mm256_set1_epi64x(packed[(i >> 3) + 8]);
+    for (size_t k = 0; k < 2; k++) {
+      const __m256i w = _mm256_or_si256(
+        _mm256_srlv_epi64(lo, shift[k]),
+        _mm256_sllv_epi64(hi, _mm256_sub_epi64(_mm256_set1_epi64x(64), shift[k])));
+
+      // Byte j of every lane holds the count for sync word j
+      __m256i c = _mm256_setzero_si256();
+      for (size_t j = 0; j < numSyncWords; j++) {
+        const __m256i x = _mm256_xor_si256(w, _mm256_set1_epi64x(words[j]));
+        const __m256i n = _mm256_add_epi8(
+          _mm256_shuffle_epi8(lut, _mm256_and_si256(x, low)),
+          _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(x, 4), low)));
+        c = _mm256_or_si256(c, _mm256_slli_epi64(_mm256_sad_epu8(n, _mm256_setzero_si256()), 8 * j));
+      }
+
+      // Gather low 32 bits of every lane (4 positions)
+      c = _mm256_sub_epi8(total, _mm256_permutevar8x32_epi32(c, even));
+      _mm_storeu_si128(
+        (__m128i*) &scores[(i + 4 * k) * numSyncWords],
+        _mm256_castsi256_si128(c));
+    }
+  }
+
+  scoreLoop(packed, scores, i, end);
+}
+
+void Correlator::findMaxSSE41(size_t npos, int* max, int* pos) {
+  const uint8_t* scores = scores_.data();
+  const size_t n = npos * numSyncWords;
+
+  // Maximum per byte; padding is zero
+  __m128i m = _mm_setzero_si128();
+  for (size_t i = 0; i < n; i += 16) {
+    m = _mm_max_epu8(m, _mm_loadu_si128((const __m128i*) &scores[i]));
+  }
+  m = _mm_max_epu8(m, _mm_srli_si128(m, 8));
+  m = _mm_max_epu8(m, _mm_srli_si128(m, 4));
+
+  findFirst(npos, EqualSSE41{scores, (uint32_t) _mm_cvtsi128_si32(m)}, max, pos);
+}
+
+void Correlator::findMaxAVX2(size_t npos, int* max, int* pos) {
+  const uint8_t* scores = scores_.data();
+  const size_t n = npos * numSyncWords;
+
+  // Maximum per byte; padding is zero
+  __m256i m = _mm256_setzero_si256();
+  for (size_t i = 0; i < n; i += 32) {
+    m = _mm256_max_epu8(m, _mm256_loadu_si256((const __m256i*) &scores[i]));
+  }
+  __m128i m128 = _mm_max_epu8(
+    _mm256_castsi256_si128(m),
+    _mm256_extracti128_si256(m, 1));
+  m128 = _mm_max_epu8(m128, _mm_srli_si128(m128, 8));
+  m128 = _mm_max_epu8(m128, _mm_srli_si128(m128, 4));
+
+  findFirst(npos, EqualAVX2{scores, (uint32_t) _mm_cvtsi128_si32(m128)}, max, pos);
+}
+
+#endif
+
 } // namespace decoder
@@ -4,6 +4,9 @@
 #include <unistd.h>
 
 #include <string>
+#include <vector>
+
+#include <util/cpu.h>
 
 namespace decoder {
 
@@ -24,6 +27,65 @@ const char* correlationTypeToString(correlationType type);
 // afford to correlate with both LRIT and HRIT sync words. Doing this
 // means we don't need a run time flag for the type of stream because
 // we can detect which one we correlate best with.
-int correlate(uint8_t* data, size_t len, int* maxOut, correlationType* maxType);
+int correlate(const uint8_t* data, size_t len, int* maxOut, correlationType* maxType);
+
+// Correlator computes the same thing as correlate(), but keeps state
+// between calls for when the caller discards the head of its buffer,
+// moves the remainder to the front, and fills the tail with new data
+// (as the packetizer does while it reacquires a lock). Then, only the
+// hard bits and correlation of the new data have to be computed.
+//
+// Soft bits are packed into hard bits 16 or 32 at a time (if the CPU
+// supports it), and every position is correlated with all sync words
+// in one go.
+//
+class Correlator {
+public:
+  Correlator();
+
+  // Forget about previous calls (e.g. when the buffer was refilled).
+  void reset();
+
+  // Tell the correlator that the caller removed the first n soft bits
+  // from the buffer of the previous call, and moved the remainder to
+  // the front of the buffer.
+  void discard(size_t n);
+
+  // Same as correlate(). Correlation for the positions that were
+  // already computed by the previous call (minus the positions that
+  // were discarded since) is not computed again.
+  int run(const uint8_t* data, size_t len, int* maxOut, correlationType* maxType);
+
+protected:
+  // Packs soft bits [begin, end) into hard bits (LSB first).
+  // Both begin and end must be a multiple of 8.
+  void pack(const uint8_t* data, size_t begin, size_t end);
+
+  // Computes correlation for positions [begin, end).
+  void score(size_t begin, size_t end);
+
+  // Finds maximum correlation and first position
+  // with maximum correlation for every sync word.
+  void findMax(size_t npos, int* max, int* pos);
+
+#ifdef HAVE_X86_DISPATCH
+  TARGET_SSE41 void packSSE41(const uint8_t* data, size_t begin, size_t end);
+  TARGET_AVX2 void packAVX2(const uint8_t* data, size_t begin, size_t end);
+  TARGET_SSE41 void scoreSSE41(size_t begin, size_t end);
+  TARGET_AVX2 void scoreAVX2(size_t begin, size_t end);
+  TARGET_SSE41 void findMaxSSE41(size_t npos, int* max, int* pos);
+  TARGET_AVX2 void findMaxAVX2(size_t npos, int* max, int* pos);
+#endif
+
+  // Hard bits, 8 per byte, first bit in the LSB
+  std::vector<uint8_t> packed_;
+
+  // Correlation per position with every sync word (interleaved)
+  std::vector<uint8_t> scores_;
+
+  // Number of positions at the start of the buffer for which
+  // the correlation was computed by a previous call
+  size_t valid_;
+};
 
 } // namespace decoder
@@ -1,9 +1,32 @@
 #include "derandomizer.h"
 
+#include <cstring>
+
 #include <util/error.h>
 
 namespace decoder {
 
+namespace {
+
+// Loads 8 bytes as a big endian 64-bit integer (first byte in the MSB)
+inline uint64_t load64(const uint8_t* p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  v = __builtin_bswap64(v);
+#endif
+  return v;
+}
+
+inline void store64(uint8_t* p, uint64_t v) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  v = __builtin_bswap64(v);
+#endif
+  memcpy(p, &v, sizeof(v));
+}
+
+} // namespace
+
 Derandomizer::Derandomizer() {
   // Build de-randomization table (per CCSDS standard).
   // The pseudo random sequence is generated by the polynomial:
@@ -28,6 +51,11 @@ Derandomizer::Derandomizer() {
       lfsr = (lfsr >> 1) | (bit << 7);
     }
   }
+
+  for (unsigned i = 0; i < words_.size(); i++) {
+    words_[i] = load64(&table_[i * 8]);
+    invertedWords_[i] = ~words_[i];
+  }
 }
 
 void Derandomizer::run(uint8_t* data, size_t len) {
@@ -37,4 +65,36 @@ void Derandomizer::run(uint8_t* data, size_t len) {
   }
 }
 
+void Derandomizer::run(const uint8_t* in, uint8_t* out, size_t len, Coding coding) {
+  ASSERT(len == table_.size());
+
+  // An NRZ-M encoder performs a bit wise: o[i+1] = in[i] ^ o[i].
+  // Hence, for the decoder we perform: in[i] = o[i+1] ^ o[i],
+  // which for a word is x ^ ((x >> 1) | carry), where the carry is
+  // the last bit of the previous word. Inversion is folded into
+  // the derandomization table.
+  const uint64_t nrzm = (coding == NRZM) ? ~0ULL : 0;
+  const uint8_t invert = (coding == INVERTED) ? 0xff : 0;
+  const auto words = (coding == INVERTED) ? invertedWords_.data() : words_.data();
+  uint64_t carry = (coding == NRZM) ? ((uint64_t) in[-1] << 63) : 0;
+  size_t i = 0;
+  for (; i + 8 <= len; i += 8) {
+    uint64_t x = load64(&in[i]);
+    const uint64_t next = x << 63;
+    x ^= ((x >> 1) | carry) & nrzm;
+    carry = next;
+    store64(&out[i], x ^ words[i / 8]);
+  }
+
+  // Remaining bytes (the table is not a multiple of 8 bytes)
+  uint8_t b0 = carry >> 63;
+  for (; i < len; i++) {
+    uint8_t x = in[i];
+    const uint8_t next = x & 0x1;
+    x ^= ((x >> 1) | (b0 << 7)) & nrzm;
+    b0 = next;
+    out[i] = x ^ table_[i] ^ invert;
+  }
+}
+
 } // namespace decoder
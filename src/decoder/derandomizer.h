@@ -9,12 +9,34 @@ namespace decoder {
 
 class Derandomizer {
 public:
+  // Coding of the bit stream that is undone before derandomization
+  enum Coding {
+    NONE = 0,
+
+    // Every bit is inverted (LRIT with a 180 degree phase ambiguity)
+    INVERTED = 1,
+
+    // NRZ-M (HRIT)
+    NRZM = 2,
+  };
+
   Derandomizer();
 
   void run(uint8_t* data, size_t len);
 
+  // Undoes the coding of the bit stream and derandomizes it in a
+  // single pass, 64 bits at a time, from in to out. For NRZ-M, the
+  // byte before in (in[-1]) must be the one that precedes it in the
+  // bit stream (e.g. the last byte of the sync word).
+  void run(const uint8_t* in, uint8_t* out, size_t len, Coding coding);
+
 protected:
   std::array<uint8_t, 1020> table_;
+
+  // Same as table_, 8 bytes at a time (first byte in the MSB),
+  // as is and inverted (to undo inversion at no extra cost)
+  std::array<uint64_t, 1020 / 8> words_;
+  std::array<uint64_t, 1020 / 8> invertedWords_;
 };
 
 } // namespace decoder
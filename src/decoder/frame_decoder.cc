@@ -0,0 +1,76 @@
+#include "frame_decoder.h"
+
+namespace decoder {
+
+int FrameDecoder::run(
+    const EncodedFrame& frame,
+    std::array<uint8_t, 892>& out,
+    int* viterbiBits,
+    int* erasures) {
+  return run(frame.bits.data(), frame.syncType, out, viterbiBits, erasures);
+}
+
+int FrameDecoder::run(
+    const uint8_t* bits,
+    correlationType syncType,
+    std::array<uint8_t, 892>& out,
+    int* viterbiBits,
+    int* erasures) {
+  constexpr auto framePreludeBytes = EncodedFrame::framePreludeBytes;
+  constexpr auto frameBytes = EncodedFrame::frameBytes;
+  constexpr auto syncWordBytes = EncodedFrame::syncWordBytes;
+
+  constexpr auto encodedBits =
+    EncodedFrame::encodedFramePreludeBits + EncodedFrame::encodedFrameBits;
+
+  std::array<uint8_t, framePreludeBytes + frameBytes> packet;
+  viterbi_.decodeSoft(bits, encodedBits, packet.data());
+
+  // Re-code packet to compute number of Viterbi corrected bits
+  if (viterbiBits) {
+    *viterbiBits = viterbi_.compareSoft(bits, packet.data(), packet.size());
+  }
+
+  // Undo NRZ-M coding or inversion and de-randomize in a single pass,
+  // skipping the warmup frame prelude and sync word. The Viterbi
+  // decoder output is left intact for retrying Reed-Solomon with
+  // erasures.
+  //
+  // If maximum correlation was found for an out of phase
+  // LRIT sync word, the packet is negated to make it in-phase.
+  // We can do this after Viterbi because it works just as
+  // well for negated signals. It just yields negated output.
+  //
+  // If maximum correlation was found for an HRIT sync word,
+  // the bit stream is NRZ-M coded. NRZ-M decoding yields the
+  // same output regardless of phase.
+  auto coding = Derandomizer::NONE;
+  if (syncType == LRIT_PHASE_180) {
+    coding = Derandomizer::INVERTED;
+  } else if (syncType == HRIT_PHASE_000 || syncType == HRIT_PHASE_180) {
+    coding = Derandomizer::NRZM;
+  }
+
+  constexpr auto skip = framePreludeBytes + syncWordBytes;
+  constexpr auto len = frameBytes - syncWordBytes;
+  std::array<uint8_t, len> data;
+  derandomizer_.run(&packet[skip], data.data(), len, coding);
+
+  // Reed-Solomon
+  if (erasures) {
+    *erasures = 0;
+  }
+  auto rv = reedSolomon_.run(data.data(), len, &out[0]);
+  if (rv >= 0 || maxErasures_ == 0) {
+    return rv;
+  }
+
+  // Retry with erasures. The reliability is only computed for frames
+  // that need it. It has a value for every byte of the decoder output,
+  // which still includes the frame prelude and sync word.
+  std::array<int16_t, framePreludeBytes + frameBytes> reliability;
+  viterbi_.reliability(bits, packet.data(), packet.size(), reliability.data());
+  return reedSolomon_.run(data.data(), len, &reliability[skip], &out[0], erasures);
+}
+
+} // namespace decoder
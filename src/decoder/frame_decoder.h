@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "correlator.h"
+#include "derandomizer.h"
+#include "reed_solomon.h"
+#include "viterbi.h"
+
+namespace decoder {
+
+// Soft bits for a single frame, as cut from the symbol stream by the
+// packetizer, along with the type of sync word that was found.
+struct EncodedFrame {
+  static constexpr auto frameBits = 8192;
+  static constexpr auto syncWordBits = 32;
+  static constexpr auto framePreludeBits = 32;
+
+  // Encoding is twice the size of the original (convolutional code has r=1/2)
+  static constexpr auto encodedFrameBits = 2 * frameBits;
+  static constexpr auto encodedSyncWordBits = 2 * syncWordBits;
+  static constexpr auto encodedFramePreludeBits = 2 * framePreludeBits;
+
+  // For convenience
+  static constexpr auto frameBytes = frameBits / 8;
+  static constexpr auto syncWordBytes = syncWordBits / 8;
+  static constexpr auto framePreludeBytes = framePreludeBits / 8;
+
+  // Frame prelude (for Viterbi decoder warmup) followed by the frame
+  std::array<uint8_t, encodedFramePreludeBits + encodedFrameBits> bits;
+
+  correlationType syncType;
+};
+
+// Runs Viterbi decoding, NRZ-M decoding, derandomization, and
+// Reed-Solomon decoding on a frame.
+//
+// There is no state that carries over from one frame to the next,
+// so multiple instances can decode different frames concurrently.
+//
+class FrameDecoder {
+public:
+  // Returns the number of bytes corrected by Reed-Solomon,
+  // or -1 if the frame could not be corrected.
+  // If viterbiBits is not null, it is set to the number of
+  // bits corrected by the Viterbi decoder.
+  // If erasures is not null, it is set to the number of bytes
+  // that were marked as erasures to correct the frame.
+  int run(
+      const EncodedFrame& frame,
+      std::array<uint8_t, 892>& out,
+      int* viterbiBits,
+      int* erasures = nullptr);
+
+  // Same as above for soft bits that are not held by an EncodedFrame.
+  // The bits pointer must point to the frame prelude followed by
+  // the frame (EncodedFrame::bits has the expected size).
+  int run(
+      const uint8_t* bits,
+      correlationType syncType,
+      std::array<uint8_t, 892>& out,
+      int* viterbiBits,
+      int* erasures = nullptr);
+
+  // If Reed-Solomon decoding fails, retry with up to this many of
+  // the least reliable bytes of every codeword marked as erasures,
+  // as judged by the agreement between the soft bits and the
+  // Viterbi decoder output. Defaults to 0 (no retries).
+  void setMaxErasures(int n) {
+    reedSolomon_.setMaxErasures(n);
+    maxErasures_ = n;
+  }
+
+protected:
+  Viterbi viterbi_;
+  Derandomizer derandomizer_;
+  ReedSolomon reedSolomon_;
+  int maxErasures_ = 0;
+};
+
+} // namespace decoder
@@ -1,27 +1,44 @@
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <cstring>
 #include <ctime>
 #include <fstream>
 #include <iostream>
 #include <memory>
+#include <thread>
+#include <vector>
 
 #include <util/error.h>
 
 #include "packetizer.h"
 #include "reader.h"
 
-// Read from file descriptor.
 // Stores time when most recent read completed.
 // This is used to name output files.
-class FileReader : public decoder::Reader {
+class TimedReader {
 public:
-  FileReader(int fd) :
-    fd_(fd) {}
+  TimedReader() : t_(0) {}
+
+  virtual ~TimedReader() {}
 
   time_t lastRead() const {
     return t_;
   }
 
+protected:
+  time_t t_;
+};
+
+// Read from file descriptor.
+class FileReader : public decoder::Reader, public TimedReader {
+public:
+  FileReader(int fd) :
+    fd_(fd) {}
+
   virtual size_t read(void* buf, size_t count) {
     size_t nread = 0;
     while (nread < count) {
@@ -43,7 +60,48 @@ public:
 
 private:
   int fd_;
-  time_t t_;
+};
+
+// Read from memory mapped regular file.
+// The packetizer works directly on the mapping; nothing is copied.
+class MmapReader : public decoder::MemoryReader, public TimedReader {
+public:
+  MmapReader(int fd, size_t size) :
+    decoder::MemoryReader(map(fd, size), size) {
+  }
+
+  virtual ~MmapReader() {
+    munmap(const_cast<uint8_t*>(data_), size_);
+  }
+
+  const uint8_t* data() const {
+    return data_;
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  virtual size_t read(void* buf, size_t count) {
+    t_ = time(0);
+    return decoder::MemoryReader::read(buf, count);
+  }
+
+  virtual const uint8_t* peek(size_t count) {
+    t_ = time(0);
+    return decoder::MemoryReader::peek(count);
+  }
+
+private:
+  static const uint8_t* map(int fd, size_t size) {
+    auto addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      perror("mmap");
+      exit(1);
+    }
+    madvise(addr, size, MADV_SEQUENTIAL);
+    return static_cast<const uint8_t*>(addr);
+  }
 };
 
 class FileWriter {
@@ -95,26 +153,211 @@ protected:
   }
 };
 
-int main(int argc, char** argv) {
-  auto reader = std::make_shared<FileReader>(0);
-  auto writer = std::make_shared<FileWriter>(".");
+struct Options {
+  int threads = 1;
+  size_t chunkSize = 64 << 20;
+  int erasures = 0;
+};
+
+// Number of packets to cut per call to the packetizer
+constexpr size_t batchSize = 64;
+
+void handle(
+    FileWriter& writer,
+    const std::array<uint8_t, 892>& buf,
+    const decoder::Packetizer::Details& details,
+    time_t t) {
+  if (details.reedSolomonBytes > 0) {
+    std::cerr << "RS corrected " << details.reedSolomonBytes << " bytes" << std::endl;
+  } else if (details.reedSolomonBytes < 0) {
+    std::cerr << "RS unable to correct packet; dropping!" << std::endl;
+  }
+
+  if (details.ok) {
+    writer.write(buf, t);
+  }
+}
+
+void decode(
+    const Options& opts,
+    const std::shared_ptr<decoder::Reader>& reader,
+    const TimedReader& timed,
+    FileWriter& writer) {
   decoder::Packetizer p(reader);
-  decoder::Packetizer::Details details;
-  std::array<uint8_t, 892> buf;
+  p.setMaxErasures(opts.erasures);
+  std::vector<std::array<uint8_t, 892> > bufs(batchSize);
+  std::vector<decoder::Packetizer::Details> details(batchSize);
   for (;;) {
-    auto ok = p.nextPacket(buf, &details);
-    if (!ok) {
+    auto n = p.nextPackets(bufs.data(), details.data(), batchSize);
+    for (size_t i = 0; i < n; i++) {
+      handle(writer, bufs[i], details[i], timed.lastRead());
+    }
+    if (n < batchSize) {
+      break;
+    }
+  }
+}
+
+// Packets cut from a chunk of the input
+struct Chunk {
+  std::vector<std::array<uint8_t, 892> > bufs;
+  std::vector<decoder::Packetizer::Details> details;
+};
+
+// Cuts and decodes the packets with a sync word in [begin, end).
+// The packetizer starts without a lock on the stream, so it first
+// searches for the sync word, and it stops at the last frame that
+// starts before the end of the chunk (the next chunk starts with
+// the frame after that one).
+void decodeChunk(
+    const Options& opts,
+    const uint8_t* data,
+    size_t size,
+    size_t begin,
+    size_t end,
+    Chunk& out) {
+  using decoder::EncodedFrame;
+
+  // Include the prelude of a frame starting at begin, and the rest
+  // of the frame and the next sync word for a frame starting at end-1
+  const auto from = begin - std::min<size_t>(begin, EncodedFrame::encodedFramePreludeBits);
+  const auto to = std::min<size_t>(
+    size,
+    end + EncodedFrame::encodedFrameBits + EncodedFrame::encodedSyncWordBits - 1);
+
+  auto reader = std::make_shared<decoder::MemoryReader>(data + from, to - from);
+  decoder::Packetizer p(reader);
+  p.setMaxErasures(opts.erasures);
+  p.setSymbolPos(from);
+  for (;;) {
+    const auto pos = out.bufs.size();
+    out.bufs.resize(pos + batchSize);
+    out.details.resize(pos + batchSize);
+    auto n = p.nextPackets(&out.bufs[pos], &out.details[pos], batchSize);
+    out.bufs.resize(pos + n);
+    out.details.resize(pos + n);
+    if (n < batchSize) {
+      break;
+    }
+  }
+}
+
+// Decodes chunks of a memory mapped file on multiple threads.
+// Packets are written in the order of the input.
+void decodeParallel(
+    const Options& opts,
+    const MmapReader& reader,
+    FileWriter& writer) {
+  const auto data = reader.data();
+  const auto size = reader.size();
+  const auto chunks = (size + opts.chunkSize - 1) / opts.chunkSize;
+  const size_t threads = opts.threads;
+
+  // Decode as many chunks as there are threads at a time,
+  // to limit the number of packets that are kept in memory
+  for (size_t first = 0; first < chunks; first += threads) {
+    const auto last = std::min(first + threads, chunks);
+    std::vector<Chunk> out(last - first);
+    std::vector<std::thread> workers;
+    for (auto i = first; i < last; i++) {
+      const auto begin = i * opts.chunkSize;
+      const auto end = std::min(size, begin + opts.chunkSize);
+      workers.emplace_back(
+        decodeChunk,
+        std::cref(opts),
+        data,
+        size,
+        begin,
+        end,
+        std::ref(out[i - first]));
+    }
+    for (auto& worker : workers) {
+      worker.join();
+    }
+
+    const auto t = time(0);
+    for (const auto& chunk : out) {
+      for (size_t i = 0; i < chunk.bufs.size(); i++) {
+        handle(writer, chunk.bufs[i], chunk.details[i], t);
+      }
+    }
+  }
+}
+
+void usage(int argc, char** argv) {
+  fprintf(stderr, "Usage: %s [OPTIONS] < FILE\n", argv[0]);
+  fprintf(stderr, "Decode packets from soft bits on stdin.\n");
+  fprintf(stderr, "Packets are written to files in the current directory.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Options:\n");
+  fprintf(stderr, "  -j, --threads N        Decode chunks of the input on N threads\n");
+  fprintf(stderr, "                         (only if stdin is a regular file; default: 1)\n");
+  fprintf(stderr, "      --chunk-size MB    Size of a chunk in MiB (default: 64)\n");
+  fprintf(stderr, "      --rs-erasures N    Retry Reed-Solomon with up to N erasures (default: 0)\n");
+  fprintf(stderr, "      --help             Show this help\n");
+  fprintf(stderr, "\n");
+  exit(0);
+}
+
+int main(int argc, char** argv) {
+  Options opts;
+
+  while (1) {
+    static struct option longOpts[] = {
+      {"threads",     required_argument, nullptr, 'j'},
+      {"chunk-size",  required_argument, nullptr, 0x1001},
+      {"rs-erasures", required_argument, nullptr, 0x1002},
+      {"help",        no_argument,       nullptr, 0x1337},
+      {nullptr,       0,                 nullptr, 0},
+    };
+
+    auto c = getopt_long(argc, argv, "j:", longOpts, nullptr);
+    if (c == -1) {
       break;
     }
 
-    if (details.reedSolomonBytes > 0) {
-      std::cerr << "RS corrected " << details.reedSolomonBytes << " bytes" << std::endl;
-    } else if (details.reedSolomonBytes < 0) {
-      std::cerr << "RS unable to correct packet; dropping!" << std::endl;
+    switch (c) {
+    case 0:
+      break;
+    case 'j':
+      opts.threads = atoi(optarg);
+      break;
+    case 0x1001:
+      opts.chunkSize = (size_t) atoi(optarg) << 20;
+      break;
+    case 0x1002:
+      opts.erasures = atoi(optarg);
+      break;
+    case 0x1337:
+      usage(argc, argv);
+      break;
+    default:
+      exit(1);
     }
+  }
+
+  if (opts.threads <= 0 || opts.chunkSize == 0) {
+    std::cerr << "Number of threads and chunk size must be positive" << std::endl;
+    exit(1);
+  }
+
+  if (opts.erasures < 0 || opts.erasures > 24) {
+    std::cerr << "Number of Reed-Solomon erasures must be between 0 and 24" << std::endl;
+    exit(1);
+  }
 
-    if (details.ok) {
-      writer->write(buf, reader->lastRead());
+  // Map regular files, so that nothing is copied
+  FileWriter writer(".");
+  struct stat st;
+  if (fstat(0, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    auto reader = std::make_shared<MmapReader>(0, st.st_size);
+    if (opts.threads > 1) {
+      decodeParallel(opts, *reader, writer);
+    } else {
+      decode(opts, reader, *reader, writer);
     }
+  } else {
+    auto reader = std::make_shared<FileReader>(0);
+    decode(opts, reader, *reader, writer);
   }
 }
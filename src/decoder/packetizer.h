@@ -3,27 +3,15 @@
 #include <memory>
 
 #include "correlator.h"
-#include "derandomizer.h"
+#include "frame_decoder.h"
 #include "reader.h"
-#include "reed_solomon.h"
-#include "viterbi.h"
 
 namespace decoder {
 
 class Packetizer {
-  static constexpr auto frameBits = 8192;
-  static constexpr auto syncWordBits = 32;
-  static constexpr auto framePreludeBits = 32;
-
-  // Encoding is twice the size of the original (convolutional code has r=1/2)
-  static constexpr auto encodedFrameBits = 2 * frameBits;
-  static constexpr auto encodedSyncWordBits = 2 * syncWordBits;
-  static constexpr auto encodedFramePreludeBits = 2 * framePreludeBits;
-
-  // For convenience
-  static constexpr auto frameBytes = frameBits / 8;
-  static constexpr auto syncWordBytes = syncWordBits / 8;
-  static constexpr auto framePreludeBytes = framePreludeBits / 8;
+  static constexpr auto encodedFrameBits = EncodedFrame::encodedFrameBits;
+  static constexpr auto encodedSyncWordBits = EncodedFrame::encodedSyncWordBits;
+  static constexpr auto encodedFramePreludeBits = EncodedFrame::encodedFramePreludeBits;
 
 public:
   struct Details {
@@ -34,12 +22,17 @@ public:
     int64_t skippedSymbols;
 
     // Number of Viterbi corrected bits
+    // This is -1 if it was not computed for this packet
     int viterbiBits;
 
     // Number of Reed-Solomon corrected bytes
     // This is -1 if the packet was not correctable
     int reedSolomonBytes;
 
+    // Number of bytes marked as erasures to correct the packet
+    // This is 0 if it could be corrected without erasures
+    int reedSolomonErasures;
+
     // If this call yielded a valid packet
     bool ok;
 
@@ -51,20 +44,74 @@ public:
 
   bool nextPacket(std::array<uint8_t, 892>& out, Details* details);
 
+  // Cuts and decodes up to n packets. Details (if not null) must have
+  // room for n entries as well. Returns the number of packets, which
+  // is only less than n at end of stream. Packets that could not be
+  // decoded are included (see Details::ok), as with nextPacket.
+  size_t nextPackets(std::array<uint8_t, 892>* out, Details* details, size_t n);
+
+  // Cuts the next frame from the symbol stream without decoding it.
+  // Only the fields of details that relate to the position of the
+  // frame in the symbol stream are set. Returns false at end of stream.
+  //
+  // The frame can be decoded with a FrameDecoder, possibly on another
+  // thread. The lock on the stream is kept until the caller reports
+  // that a frame could not be decoded (see setLock).
+  bool nextFrame(EncodedFrame& frame, Details* details);
+
+  // Compute the number of Viterbi corrected bits for every Nth packet
+  // only (defaults to every packet). If zero, it is never computed.
+  void setViterbiErrorInterval(int interval) {
+    viterbiErrorInterval_ = interval;
+  }
+
+  // Retry Reed-Solomon decoding with up to this many erasures per
+  // codeword if it fails (see FrameDecoder::setMaxErasures).
+  void setMaxErasures(int n) {
+    frameDecoder_.setMaxErasures(n);
+  }
+
+  // Set the position of the start of the stream in the symbol stream
+  // it is part of, for example when decoding chunks of a file, such
+  // that Details::symbolPos and relativeTime refer to the whole.
+  void setSymbolPos(int64_t pos) {
+    symbolPos_ = pos;
+  }
+
+  // Report whether or not a frame could be decoded. If it could not,
+  // the next call to nextFrame reacquires the sync word position.
+  void setLock(bool lock) {
+    lock_ = lock;
+  }
+
 protected:
-  bool read();
+  // Returns pointer to the window of len_ soft bits at the current
+  // position in the symbol stream, or nullptr at end of stream.
+  const uint8_t* peek();
+
+  // Moves the window forward by n soft bits.
+  void advance(size_t n);
+
+  // Finds the next frame and returns a pointer to its soft bits
+  // (starting with the frame prelude) in the reader's memory.
+  // The pointer is valid until the call to release.
+  bool next(const uint8_t** bits, correlationType* syncType, Details* details);
+
+  // Moves past the frame returned by next.
+  void release();
 
   std::shared_ptr<Reader> reader_;
-  Viterbi viterbi_;
-  Derandomizer derandomizer_;
-  ReedSolomon reedSolomon_;
+  Correlator correlator_;
+  FrameDecoder frameDecoder_;
 
-  uint8_t* buf_;
   size_t len_;
-  size_t pos_;
   bool lock_;
+  int viterbiErrorInterval_;
+  int64_t packets_;
   correlationType syncType_;
   int symbolRate_;
+
+  // Position of the window in the symbol stream
   int64_t symbolPos_;
 };
 
@@ -1,8 +1,73 @@
 #include "reader.h"
 
+#include <algorithm>
+#include <cstring>
+
+#include <util/error.h>
+
 namespace decoder {
 
+Reader::Reader() : begin_(0), end_(0) {
+}
+
 Reader::~Reader() {
 }
 
+const uint8_t* Reader::peek(size_t count) {
+  if (end_ - begin_ >= count) {
+    return &buf_[begin_];
+  }
+
+  // Move unconsumed bytes to the front. Reserve space for more than
+  // count bytes, so that this doesn't happen for every call.
+  if (buf_.size() < 2 * count) {
+    buf_.resize(2 * count);
+  }
+  if (begin_ + count > buf_.size()) {
+    memmove(&buf_[0], &buf_[begin_], end_ - begin_);
+    end_ -= begin_;
+    begin_ = 0;
+  }
+
+  // Fill up to count bytes
+  auto nbytes = begin_ + count - end_;
+  auto rv = read(&buf_[end_], nbytes);
+  end_ += rv;
+  if (rv < nbytes) {
+    return nullptr;
+  }
+
+  return &buf_[begin_];
+}
+
+void Reader::advance(size_t count) {
+  ASSERT(count <= end_ - begin_);
+  begin_ += count;
+}
+
+MemoryReader::MemoryReader(const uint8_t* data, size_t size)
+    : data_(data),
+      size_(size),
+      pos_(0) {
+}
+
+size_t MemoryReader::read(void* buf, size_t count) {
+  auto nread = std::min(count, size_ - pos_);
+  memcpy(buf, data_ + pos_, nread);
+  pos_ += nread;
+  return nread;
+}
+
+const uint8_t* MemoryReader::peek(size_t count) {
+  if (count > size_ - pos_) {
+    return nullptr;
+  }
+  return data_ + pos_;
+}
+
+void MemoryReader::advance(size_t count) {
+  ASSERT(count <= size_ - pos_);
+  pos_ += count;
+}
+
 } // namespace decoder
@@ -1,14 +1,53 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
+#include <vector>
 
 namespace decoder {
 
 class Reader {
 public:
+  Reader();
   virtual ~Reader();
 
   virtual size_t read(void* buf, size_t count) = 0;
+
+  // Returns pointer to the next count bytes in the stream without
+  // consuming them, or nullptr if the stream ends before that.
+  // The pointer is valid until the next call to peek or advance.
+  //
+  // The default implementation copies the stream into an internal
+  // buffer through read. Readers that already hold the stream in
+  // memory (e.g. a memory mapped file or queued buffers) should
+  // override peek and advance to return pointers into that memory.
+  virtual const uint8_t* peek(size_t count);
+
+  // Consumes count bytes. This must not be more than
+  // the number of bytes returned by the last call to peek.
+  virtual void advance(size_t count);
+
+private:
+  // Buffer for the default implementation of peek
+  std::vector<uint8_t> buf_;
+  size_t begin_;
+  size_t end_;
+};
+
+// Reads from a stream that is held in memory in its entirety (e.g. a
+// memory mapped file, or a chunk of one). Nothing is copied by peek.
+class MemoryReader : public Reader {
+public:
+  MemoryReader(const uint8_t* data, size_t size);
+
+  virtual size_t read(void* buf, size_t count) override;
+  virtual const uint8_t* peek(size_t count) override;
+  virtual void advance(size_t count) override;
+
+protected:
+  const uint8_t* data_;
+  size_t size_;
+  size_t pos_;
 };
 
 } // namespace decoder
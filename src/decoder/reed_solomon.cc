@@ -1,5 +1,16 @@
 #include "reed_solomon.h"
 
+#include <algorithm>
+#include <cstring>
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+#ifdef HAVE_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
 #include <util/error.h>
 
 namespace decoder {
@@ -19,9 +30,19 @@ const uint32_t tal[] = {
   0b11000111,
 };
 
+// Parameters of the CCSDS code (as passed to libcorrect below)
+constexpr unsigned firstRoot = 112;
+constexpr unsigned rootGap = 11;
+constexpr unsigned numRoots = 32;
+
+// Lookup of a byte in a table for its low and high nibble
+inline uint8_t lookup(const std::array<uint8_t, 32>& t, uint8_t v) {
+  return t[v & 0xf] ^ t[16 + (v >> 4)];
+}
+
 } // namespace
 
-ReedSolomon::ReedSolomon() {
+ReedSolomon::ReedSolomon() : maxErasures_(0) {
   // Initialize lookup tables to convert between conventional and dual
   // basis representation. The Reed-Solomon implementation in libcorrect
   // uses conventional representation, yet the data we process uses dual
@@ -43,34 +64,125 @@ ReedSolomon::ReedSolomon() {
     dualToConv_[convToDual_[i]] = i;
   }
 
+  for (int i = 0; i < 16; i++) {
+    dualToConvNibbles_[i] = dualToConv_[i];
+    dualToConvNibbles_[16 + i] = dualToConv_[i << 4];
+    convToDualNibbles_[i] = convToDual_[i];
+    convToDualNibbles_[16 + i] = convToDual_[i << 4];
+  }
+
+  // Powers of the generator of the field (x^8 + x^7 + x^2 + x + 1)
+  unsigned x = 1;
+  for (int i = 0; i < 255; i++) {
+    exp_[i] = x;
+    exp_[i + 255] = x;
+    log_[x] = i;
+    x <<= 1;
+    if (x & 0x100) {
+      x ^= correct_rs_primitive_polynomial_ccsds;
+    }
+  }
+  exp_[510] = exp_[0];
+  exp_[511] = exp_[1];
+  log_[0] = 0;
+
+  // Multiplication by a constant is linear as well
+  for (unsigned i = 0; i < numRoots; i++) {
+    roots_[i] = (rootGap * (firstRoot + i)) % 255;
+    const auto r4 = (4 * roots_[i]) % 255;
+    for (int j = 0; j < 16; j++) {
+      rootNibbles_[i][j] = j ? exp_[log_[j] + r4] : 0;
+      rootNibbles_[i][16 + j] = j ? exp_[log_[j << 4] + r4] : 0;
+    }
+  }
+
   // Initialize Reed-Solomon decoder
   rs_ = correct_reed_solomon_create(
     correct_rs_primitive_polynomial_ccsds,
-    112,
-    11,
-    32);
+    firstRoot,
+    rootGap,
+    numRoots);
 }
 
 ReedSolomon::~ReedSolomon() {
   correct_reed_solomon_destroy(rs_);
 }
 
+void ReedSolomon::setMaxErasures(int n) {
+  ASSERT(n >= 0 && n <= 24);
+  maxErasures_ = n;
+}
+
 int ReedSolomon::run(const uint8_t* data, size_t len, uint8_t* dst) {
-  std::array<uint8_t, 255> tmp1, tmp2;
+  return run(data, len, nullptr, dst, nullptr);
+}
+
+int ReedSolomon::run(
+    const uint8_t* data,
+    size_t len,
+    const int16_t* reliability,
+    uint8_t* dst,
+    int* erasures) {
+  alignas(32) std::array<uint8_t, paddedBytes> padded;
+  Codewords in, out;
+  std::array<uint8_t, 255> order;
   int err = 0;
 
+  if (erasures) {
+    *erasures = 0;
+  }
+
   // Expect 4x 255 byte block (223 data + 32 parity)
   ASSERT(len == 1020);
 
+  // Most frames don't need any correction. If every syndrome is
+  // zero, the data bytes are the output as is (still in dual basis).
+  convert(data, padded.data());
+  const auto bad = check(padded.data());
+  if (bad == 0) {
+    memcpy(dst, data, 892);
+    return 0;
+  }
+
+  deinterleave(padded.data(), in);
+
   // Process block by block
   for (auto i = 0; i < 4; i++) {
-    // Deinterleave and convert
-    for (auto j = 0; j < 255; j++) {
-      tmp1[j] = dualToConv_[data[(j * 4) + i]];
+    if ((bad & (1 << i)) == 0) {
+      out[i] = in[i];
+      continue;
     }
 
     // Run Reed-Solomon (in conventional representation)
+    auto& tmp1 = in[i];
+    auto& tmp2 = out[i];
     auto rv = correct_reed_solomon_decode(rs_, tmp1.data(), tmp1.size(), tmp2.data());
+    if (rv == -1 && reliability != nullptr && maxErasures_ > 0) {
+      // Order bytes in this codeword from least to most reliable
+      for (auto j = 0; j < 255; j++) {
+        order[j] = j;
+      }
+      auto end = order.begin() + maxErasures_;
+      std::partial_sort(
+        order.begin(),
+        end,
+        order.end(),
+        [&] (uint8_t a, uint8_t b) {
+          return reliability[(a * 4) + i] < reliability[(b * 4) + i];
+        });
+
+      // Every erasure that hits an error saves one parity byte, and
+      // every one that misses costs one, so try increasing numbers
+      // of erasures until the codeword can be decoded.
+      for (auto n = 0; rv == -1 && n < maxErasures_;) {
+        n = std::min(n + 4, maxErasures_);
+        rv = correct_reed_solomon_decode_with_erasures(
+          rs_, tmp1.data(), tmp1.size(), order.data(), n, tmp2.data());
+        if (rv != -1 && erasures) {
+          *erasures += n;
+        }
+      }
+    }
     if (rv == -1) {
       return -1;
     }
@@ -81,14 +193,288 @@ int ReedSolomon::run(const uint8_t* data, size_t len, uint8_t* dst) {
         err++;
       }
     }
+  }
+
+  // Convert and interleave (ignoring parity)
+  interleave(out, dst);
+  return err;
+}
+
+void ReedSolomon::convert(const uint8_t* data, uint8_t* padded) {
+#ifdef HAVE_X86_DISPATCH
+  if (util::cpu::level() >= util::cpu::SSE41) {
+    convertSSE41(data, padded);
+    return;
+  }
+#endif
+
+  memset(padded, 0, 4);
+  size_t i = 0;
+
+#ifdef __ARM_NEON
+  const uint8x8x2_t lo = {{ vld1_u8(&dualToConvNibbles_[0]), vld1_u8(&dualToConvNibbles_[8]) }};
+  const uint8x8x2_t hi = {{ vld1_u8(&dualToConvNibbles_[16]), vld1_u8(&dualToConvNibbles_[24]) }};
+  const uint8x8_t mask = vdup_n_u8(0x0f);
+  for (; i + 8 <= 1020; i += 8) {
+    const uint8x8_t v = vld1_u8(&data[i]);
+    const uint8x8_t c = veor_u8(
+      vtbl2_u8(lo, vand_u8(v, mask)),
+      vtbl2_u8(hi, vshr_n_u8(v, 4)));
+    vst1_u8(&padded[4 + i], c);
+  }
+#endif
+
+  for (; i < 1020; i++) {
+    padded[4 + i] = dualToConv_[data[i]];
+  }
+}
+
+unsigned ReedSolomon::check(const uint8_t* padded) {
+  // Every group of 16 bytes holds 4 rows of 4 interleaved bytes, with
+  // the first group starting with the row of zeros (which does not
+  // change the value of the codeword polynomials). Lane 4t+c holds
+  // the value of codeword c, evaluated over rows t, t+4, t+8, etc.,
+  // in the 4th power of a root. Combine the lanes to get the value
+  // in the root itself: the row after the last one is 3-t rows away.
+  alignas(32) std::array<uint8_t, 16 * numRoots> lanes;
+  horner(padded, lanes.data());
+
+  unsigned bad = 0;
+  for (unsigned i = 0; i < numRoots; i++) {
+    for (unsigned c = 0; c < 4; c++) {
+      uint8_t s = 0;
+      for (unsigned t = 0; t < 4; t++) {
+        const auto v = lanes[(i * 16) + (t * 4) + c];
+        if (v) {
+          s ^= exp_[log_[v] + ((3 - t) * roots_[i]) % 255];
+        }
+      }
+      if (s) {
+        bad |= 1 << c;
+      }
+    }
+  }
+
+  return bad;
+}
+
+void ReedSolomon::horner(const uint8_t* padded, uint8_t* lanes) {
+#ifdef HAVE_X86_DISPATCH
+  if (util::cpu::level() >= util::cpu::AVX2) {
+    hornerAVX2(padded, lanes);
+    return;
+  }
+  if (util::cpu::level() >= util::cpu::SSE41) {
+    hornerSSE41(padded, lanes);
+    return;
+  }
+#endif
+
+#ifdef __ARM_NEON
+  const uint8x16_t mask = vdupq_n_u8(0x0f);
+  for (unsigned i = 0; i < numRoots; i++) {
+    const auto& t = rootNibbles_[i];
+    const uint8x8x2_t lo = {{ vld1_u8(&t[0]), vld1_u8(&t[8]) }};
+    const uint8x8x2_t hi = {{ vld1_u8(&t[16]), vld1_u8(&t[24]) }};
+    uint8x16_t acc = vdupq_n_u8(0);
+    for (size_t j = 0; j < paddedBytes; j += 16) {
+      const uint8x16_t l = vandq_u8(acc, mask);
+      const uint8x16_t h = vshrq_n_u8(acc, 4);
+      const uint8x16_t m = vcombine_u8(
+        veor_u8(vtbl2_u8(lo, vget_low_u8(l)), vtbl2_u8(hi, vget_low_u8(h))),
+        veor_u8(vtbl2_u8(lo, vget_high_u8(l)), vtbl2_u8(hi, vget_high_u8(h))));
+      acc = veorq_u8(m, vld1q_u8(&padded[j]));
+    }
+    vst1q_u8(&lanes[i * 16], acc);
+  }
+#else
+  for (unsigned i = 0; i < numRoots; i++) {
+    const auto& t = rootNibbles_[i];
+    uint8_t* acc = &lanes[i * 16];
+    memset(acc, 0, 16);
+    for (size_t j = 0; j < paddedBytes; j += 16) {
+      for (size_t k = 0; k < 16; k++) {
+        acc[k] = lookup(t, acc[k]) ^ padded[j + k];
+      }
+    }
+  }
+#endif
+}
+
+void ReedSolomon::deinterleave(const uint8_t* padded, Codewords& out) {
+#ifdef HAVE_X86_DISPATCH
+  if (util::cpu::level() >= util::cpu::SSE41) {
+    deinterleaveSSE41(padded, out);
+    return;
+  }
+#endif
+
+  for (auto j = 0; j < 255; j++) {
+    for (auto i = 0; i < 4; i++) {
+      out[i][j] = padded[4 + (j * 4) + i];
+    }
+  }
+}
+
+void ReedSolomon::interleave(const Codewords& in, uint8_t* dst) {
+#ifdef HAVE_X86_DISPATCH
+  if (util::cpu::level() >= util::cpu::SSE41) {
+    interleaveSSE41(in, dst);
+    return;
+  }
+#endif
+
+  for (auto j = 0; j < (255 - 32); j++) {
+    for (auto i = 0; i < 4; i++) {
+      dst[(j * 4) + i] = lookup(convToDualNibbles_, in[i][j]);
+    }
+  }
+}
+
+void ReedSolomon::encode(const uint8_t* data, size_t len, uint8_t* dst) {
+  std::array<uint8_t, 255> tmp1, tmp2;
+
+  // Expect 4x 223 byte block
+  ASSERT(len == 892);
 
-    // Convert and interleave (ignoring parity)
+  // Process block by block
+  for (auto i = 0; i < 4; i++) {
+    // Deinterleave and convert
     for (auto j = 0; j < (255 - 32); j++) {
+      tmp1[j] = dualToConv_[data[(j * 4) + i]];
+    }
+
+    // Run Reed-Solomon (in conventional representation)
+    auto rv = correct_reed_solomon_encode(rs_, tmp1.data(), 255 - 32, tmp2.data());
+    ASSERT(rv == 255);
+
+    // Convert and interleave (including parity)
+    for (auto j = 0; j < 255; j++) {
       dst[(j * 4) + i] = convToDual_[tmp2[j]];
     }
   }
+}
 
-  return err;
+#ifdef HAVE_X86_DISPATCH
+
+namespace {
+
+// Lookup of every byte in a table for its low and high nibble
+TARGET_SSE41 __attribute__((always_inline))
+inline __m128i lookup16(__m128i lo, __m128i hi, __m128i v) {
+  const __m128i mask = _mm_set1_epi8(0x0f);
+  const __m128i l = _mm_shuffle_epi8(lo, _mm_and_si128(v, mask));
+  const __m128i h = _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+  return _mm_xor_si128(l, h);
+}
+
+TARGET_AVX2 __attribute__((always_inline))
+inline __m256i lookup32(__m256i lo, __m256i hi, __m256i v) {
+  const __m256i mask = _mm256_set1_epi8(0x0f);
+  const __m256i l = _mm256_shuffle_epi8(lo, _mm256_and_si256(v, mask));
+  const __m256i h = _mm256_shuffle_epi8(hi, _mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+  return _mm256_xor_si256(l, h);
 }
 
+} // namespace
+
+void ReedSolomon::convertSSE41(const uint8_t* data, uint8_t* padded) {
+  const __m128i lo = _mm_loadu_si128((const __m128i*) &dualToConvNibbles_[0]);
+  const __m128i hi = _mm_loadu_si128((const __m128i*) &dualToConvNibbles_[16]);
+  memset(padded, 0, 4);
+  size_t i = 0;
+  for (; i + 16 <= 1020; i += 16) {
+    const __m128i v = _mm_loadu_si128((const __m128i*) &data[i]);
+    _mm_storeu_si128((__m128i*) &padded[4 + i], lookup16(lo, hi, v));
+  }
+  for (; i < 1020; i++) {
+    padded[4 + i] = dualToConv_[data[i]];
+  }
+}
+
+void ReedSolomon::hornerSSE41(const uint8_t* padded, uint8_t* lanes) {
+  for (unsigned i = 0; i < numRoots; i++) {
+    const __m128i lo = _mm_loadu_si128((const __m128i*) &rootNibbles_[i][0]);
+    const __m128i hi = _mm_loadu_si128((const __m128i*) &rootNibbles_[i][16]);
+    __m128i acc = _mm_setzero_si128();
+    for (size_t j = 0; j < paddedBytes; j += 16) {
+      const __m128i v = _mm_load_si128((const __m128i*) &padded[j]);
+      acc = _mm_xor_si128(lookup16(lo, hi, acc), v);
+    }
+    _mm_storeu_si128((__m128i*) &lanes[i * 16], acc);
+  }
+}
+
+void ReedSolomon::hornerAVX2(const uint8_t* padded, uint8_t* lanes) {
+  // Two roots at a time (one per 128-bit lane, as the byte
+  // shuffle only looks up bytes within the same 128-bit lane)
+  for (unsigned i = 0; i < numRoots; i += 2) {
+    const __m256i lo = _mm256_inserti128_si256(
+      _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*) &rootNibbles_[i][0])),
+      _mm_loadu_si128((const __m128i*) &rootNibbles_[i + 1][0]),
+      1);
+    const __m256i hi = _mm256_inserti128_si256(
+      _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*) &rootNibbles_[i][16])),
+      _mm_loadu_si128((const __m128i*) &rootNibbles_[i + 1][16]),
+      1);
+    __m256i acc = _mm256_setzero_si256();
+    for (size_t j = 0; j < paddedBytes; j += 16) {
+      const __m256i v = _mm256_broadcastsi128_si256(
+        _mm_load_si128((const __m128i*) &padded[j]));
+      acc = _mm256_xor_si256(lookup32(lo, hi, acc), v);
+    }
+    _mm256_storeu_si256((__m256i*) &lanes[i * 16], acc);
+  }
+  _mm256_zeroupper();
+}
+
+void ReedSolomon::deinterleaveSSE41(const uint8_t* padded, Codewords& out) {
+  // Transpose 4 rows of 4 bytes into 4 bytes of every codeword
+  const __m128i order = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+  auto j = 0;
+  for (; j + 4 <= 255; j += 4) {
+    const __m128i v = _mm_shuffle_epi8(
+      _mm_loadu_si128((const __m128i*) &padded[4 + (j * 4)]),
+      order);
+    const uint32_t c0 = _mm_extract_epi32(v, 0);
+    const uint32_t c1 = _mm_extract_epi32(v, 1);
+    const uint32_t c2 = _mm_extract_epi32(v, 2);
+    const uint32_t c3 = _mm_extract_epi32(v, 3);
+    memcpy(&out[0][j], &c0, 4);
+    memcpy(&out[1][j], &c1, 4);
+    memcpy(&out[2][j], &c2, 4);
+    memcpy(&out[3][j], &c3, 4);
+  }
+  for (; j < 255; j++) {
+    for (auto i = 0; i < 4; i++) {
+      out[i][j] = padded[4 + (j * 4) + i];
+    }
+  }
+}
+
+void ReedSolomon::interleaveSSE41(const Codewords& in, uint8_t* dst) {
+  // The transpose is its own inverse
+  const __m128i order = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+  const __m128i lo = _mm_loadu_si128((const __m128i*) &convToDualNibbles_[0]);
+  const __m128i hi = _mm_loadu_si128((const __m128i*) &convToDualNibbles_[16]);
+  auto j = 0;
+  for (; j + 4 <= (255 - 32); j += 4) {
+    uint32_t c[4];
+    for (auto i = 0; i < 4; i++) {
+      memcpy(&c[i], &in[i][j], 4);
+    }
+    const __m128i v = _mm_shuffle_epi8(
+      _mm_setr_epi32(c[0], c[1], c[2], c[3]),
+      order);
+    _mm_storeu_si128((__m128i*) &dst[j * 4], lookup16(lo, hi, v));
+  }
+  for (; j < (255 - 32); j++) {
+    for (auto i = 0; i < 4; i++) {
+      dst[(j * 4) + i] = convToDual_[in[i][j]];
+    }
+  }
+}
+
+#endif
+
 } // namespace decoder
@@ -5,6 +5,9 @@ extern "C" {
 }
 
 #include <array>
+#include <cstdint>
+
+#include <util/cpu.h>
 
 namespace decoder {
 
@@ -15,11 +18,83 @@ public:
 
   int run(const uint8_t* data, size_t len, uint8_t* dst);
 
+  // Same as above, but codewords that cannot be decoded are retried
+  // with their least reliable bytes marked as erasures (up to the
+  // maximum set below). Reliability holds a value for every byte of
+  // data; lower means less reliable. If erasures is not null, it is
+  // set to the number of bytes that had to be erased (0 if none).
+  int run(
+      const uint8_t* data,
+      size_t len,
+      const int16_t* reliability,
+      uint8_t* dst,
+      int* erasures);
+
+  // Maximum number of erasures per codeword (0 disables retries).
+  // Every erasure uses one of the 32 parity bytes, so the higher
+  // this is, the higher the chance of miscorrection. At most 24, so
+  // that 8 parity bytes are left to detect miscorrections.
+  void setMaxErasures(int n);
+
+  // Inverse of run: encodes 892 bytes of data into 4 interleaved
+  // codewords of 255 bytes (1020 bytes total) in dual basis.
+  void encode(const uint8_t* data, size_t len, uint8_t* dst);
+
 protected:
+  using Codewords = std::array<std::array<uint8_t, 255>, 4>;
+
+  // Number of bytes in a block of 4 interleaved codewords, preceded
+  // by a row of zeros to make it a multiple of 16 (see check).
+  static constexpr size_t paddedBytes = 1024;
+
+  // Converts the 4 interleaved codewords from dual basis to
+  // conventional representation, after a row of 4 zero bytes.
+  void convert(const uint8_t* data, uint8_t* padded);
+
+  // Returns a bit mask of the codewords with a nonzero syndrome,
+  // that is, the codewords that need to be decoded.
+  unsigned check(const uint8_t* padded);
+
+  // Evaluates the codewords in every root of the generator polynomial
+  // with Horner's method, 4 bytes of every codeword at a time (one
+  // per lane). The result has 16 lanes per root (see check).
+  void horner(const uint8_t* padded, uint8_t* lanes);
+
+  // Deinterleaves the converted codewords.
+  void deinterleave(const uint8_t* padded, Codewords& out);
+
+  // Converts the data bytes of the codewords to dual basis
+  // and interleaves them (ignoring parity).
+  void interleave(const Codewords& in, uint8_t* dst);
+
+#ifdef HAVE_X86_DISPATCH
+  TARGET_SSE41 void convertSSE41(const uint8_t* data, uint8_t* padded);
+  TARGET_SSE41 void hornerSSE41(const uint8_t* padded, uint8_t* lanes);
+  TARGET_AVX2 void hornerAVX2(const uint8_t* padded, uint8_t* lanes);
+  TARGET_SSE41 void deinterleaveSSE41(const uint8_t* padded, Codewords& out);
+  TARGET_SSE41 void interleaveSSE41(const Codewords& in, uint8_t* dst);
+#endif
+
   std::array<uint8_t, 256> dualToConv_;
   std::array<uint8_t, 256> convToDual_;
 
+  // Basis conversion is linear, so it can be done with a lookup for
+  // the low and the high nibble of a byte (combined with XOR).
+  std::array<uint8_t, 32> dualToConvNibbles_;
+  std::array<uint8_t, 32> convToDualNibbles_;
+
+  // Arithmetic in GF(2^8), for the syndromes of the fast path
+  std::array<uint8_t, 512> exp_;
+  std::array<uint8_t, 256> log_;
+
+  // Roots of the generator polynomial (as powers of the generator)
+  std::array<int, 32> roots_;
+
+  // Multiplication by the 4th power of every root, by nibble
+  std::array<std::array<uint8_t, 32>, 32> rootNibbles_;
+
   correct_reed_solomon* rs_;
+  int maxErasures_;
 };
 
 } // namespace decoder
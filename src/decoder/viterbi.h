@@ -8,6 +8,10 @@ extern "C" {
 #endif
 }
 
+#include <algorithm>
+#include <array>
+#include <cstring>
+
 #include <util/error.h>
 
 namespace decoder {
@@ -30,6 +34,22 @@ public:
 #else
     v_ = correct_convolutional_create(2, 7, poly);
 #endif
+
+    // Initialize encoder table for compareSoft. The state is formed
+    // by the last 6 input bits (most recent bit in the LSB). For every
+    // state and every 4 bit input, the table holds the 8 output bits.
+    for (unsigned state = 0; state < 64; state++) {
+      for (unsigned nibble = 0; nibble < 16; nibble++) {
+        unsigned reg = state;
+        uint8_t out = 0;
+        for (int i = 3; i >= 0; i--) {
+          reg = ((reg << 1) | ((nibble >> i) & 0x1)) & 0x7f;
+          out = (out << 1) | (__builtin_popcount(reg & poly[0]) & 0x1);
+          out = (out << 1) | (__builtin_popcount(reg & poly[1]) & 0x1);
+        }
+        encodeTable_[(state << 4) | nibble] = out;
+      }
+    }
   }
 
   ~Viterbi() {
@@ -64,28 +84,84 @@ public:
 #endif
   }
 
+  // Returns the number of hard bits in the soft bit input that differ
+  // from the re-encoded decoder output (the number of corrected bits).
+  // Only the 16 * bytes symbols that correspond to the decoded bytes
+  // are compared, not the symbols that flush the encoder.
   ssize_t compareSoft(const uint8_t* original, const uint8_t* msg, size_t bytes) {
-    auto bits = encodeLength(bytes);
-    tmp_.resize((bits + 7) / 8);
-    auto rv = encode(msg, bytes, tmp_.data());
-    ASSERT(rv == bits);
-
-    // Compare MSB of original (soft bits) with re-coded hard bit
     ssize_t errors = 0;
-    for (ssize_t i = 0; i < bits; i++) {
-      uint8_t a = original[i];
-      uint8_t b = tmp_[i / 8] << (i & 0x7);
-      errors += ((a ^ b) & 0x80) >> 7;
+    unsigned state = 0;
+    for (size_t i = 0; i < bytes; i++) {
+      // Re-encode a byte at a time
+      const unsigned hi = msg[i] >> 4;
+      const unsigned lo = msg[i] & 0xf;
+      uint16_t b = encodeTable_[(state << 4) | hi] << 8;
+      state = ((state << 4) | hi) & 0x3f;
+      b |= encodeTable_[(state << 4) | lo];
+      state = ((state << 4) | lo) & 0x3f;
+
+      // Pack MSB of the 16 corresponding soft bits, first soft bit in
+      // the MSB, to match the order of the encoder output. The multiply
+      // gathers bit 0 of every byte; this relies on little endian loads.
+      uint16_t a = 0;
+      for (size_t j = 0; j < 2; j++) {
+        uint64_t x;
+        memcpy(&x, &original[(i * 16) + (j * 8)], sizeof(x));
+        x = (x >> 7) & 0x0101010101010101ULL;
+        a = (a << 8) | ((x * 0x8040201008040201ULL) >> 56);
+      }
+
+      errors += __builtin_popcount(a ^ b);
     }
 
     return errors;
   }
 
+  // Computes how strongly the soft bit input supports the decoder
+  // output, for every decoded byte: the confidence of the soft bits
+  // that agree with the re-encoded output minus the confidence of
+  // the ones that don't. A decoding error shows up as a stretch of
+  // symbols that barely favor the chosen path, and a byte depends on
+  // the symbols of the bytes around it, so every value covers the
+  // symbols of the byte before and the two bytes after it as well.
+  void reliability(const uint8_t* original, const uint8_t* msg, size_t bytes, int16_t* out) {
+    unsigned state = 0;
+    for (size_t i = 0; i < bytes; i++) {
+      const unsigned hi = msg[i] >> 4;
+      const unsigned lo = msg[i] & 0xf;
+      unsigned b = encodeTable_[(state << 4) | hi] << 8;
+      state = ((state << 4) | hi) & 0x3f;
+      b |= encodeTable_[(state << 4) | lo];
+      state = ((state << 4) | lo) & 0x3f;
+
+      // Soft bits are signed (see Quantize): +127 for a certain 0
+      // and -127 for a certain 1, the sign being the hard bit.
+      int sum = 0;
+      for (size_t j = 0; j < 16; j++) {
+        const int v = (int8_t) original[(i * 16) + j];
+        sum += ((b >> (15 - j)) & 0x1) ? -v : v;
+      }
+      out[i] = sum;
+    }
+
+    // Sliding window over bytes i-1 through i+2
+    int prev = 0;
+    for (size_t i = 0; i < bytes; i++) {
+      const int cur = out[i];
+      int sum = prev + cur;
+      for (size_t j = i + 1; j < std::min(i + 3, bytes); j++) {
+        sum += out[j];
+      }
+      prev = cur;
+      out[i] = sum;
+    }
+  }
+
 private:
   conv* v_;
 
-  // Temporary buffer to hold encoded version when doing comparison
-  std::vector<uint8_t> tmp_;
+  // Encoder output for every state and 4 bit input (see constructor)
+  std::array<uint8_t, 64 * 16> encodeTable_;
 };
 
 } // namespace decoder
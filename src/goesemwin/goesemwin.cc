@@ -87,6 +87,27 @@ public:
   bool next(std::vector<qbt::Fragment>& fragments) {
     fragments.clear();
 
+    assembler::SessionPDUSink sink = [&fragments] (const assembler::SessionPDU& spdu) {
+      // EMWIN packets have file type 214
+      auto ph = spdu.getHeader<lrit::PrimaryHeader>();
+      if (ph.fileType != 214) {
+        return;
+      }
+
+      // EMWIN packets have product ID 42
+      auto nlh = spdu.getHeader<lrit::NOAALRITHeader>();
+      if (nlh.productID != 42) {
+        return;
+      }
+
+      // Use 'parameter' field in NOAA LRIT header as counter
+      const auto counter = nlh.parameter;
+      const auto& payload = spdu.get();
+      const auto begin = payload.begin() + ph.totalHeaderLength;
+      const auto end = payload.end();
+      fragments.push_back(qbt::Fragment(counter, begin, end));
+    };
+
     std::array<uint8_t, 892> buf;
     while (reader_->nextPacket(buf)) {
       VCDU vcdu(buf);
@@ -96,27 +117,7 @@ public:
         continue;
       }
 
-      auto spdus = assembler_.process(buf);
-      for (auto& spdu : spdus) {
-        // EMWIN packets have file type 214
-        auto ph = spdu->getHeader<lrit::PrimaryHeader>();
-        if (ph.fileType != 214) {
-          continue;
-        }
-
-        // EMWIN packets have product ID 42
-        auto nlh = spdu->getHeader<lrit::NOAALRITHeader>();
-        if (nlh.productID != 42) {
-          continue;
-        }
-
-        // Use 'parameter' field in NOAA LRIT header as counter
-        const auto counter = nlh.parameter;
-        const auto& payload = spdu->get();
-        const auto begin = payload.begin() + ph.totalHeaderLength;
-        const auto end = payload.end();
-        fragments.push_back(qbt::Fragment(counter, begin, end));
-      }
+      assembler_.process(buf, sink);
 
       if (!fragments.empty()) {
         return true;
@@ -18,11 +18,11 @@
 
 using namespace util;
 
-bool filter(const Options& opts, std::unique_ptr<assembler::SessionPDU>& spdu) {
+bool filter(const Options& opts, const assembler::SessionPDU& spdu) {
   // Per http://www.noaasis.noaa.gov/LRIT/pdf-files/LRIT_receiver-specs.pdf,
   // Table 4, every file has a NOAA LRIT header.
-  auto ph = spdu->getHeader<lrit::PrimaryHeader>();
-  auto nlh = spdu->getHeader<lrit::NOAALRITHeader>();
+  auto ph = spdu.getHeader<lrit::PrimaryHeader>();
+  auto nlh = spdu.getHeader<lrit::NOAALRITHeader>();
   if (ph.fileType == 0) {
     return !opts.images;
   }
@@ -45,18 +45,18 @@ bool filter(const Options& opts, std::unique_ptr<assembler::SessionPDU>& spdu) {
   throw std::runtime_error(ss.str());
 }
 
-std::string filename(std::unique_ptr<assembler::SessionPDU>& spdu) {
-  auto out = spdu->getName();
-  auto ph = spdu->getHeader<lrit::PrimaryHeader>();
-  auto nlh = spdu->getHeader<lrit::NOAALRITHeader>();
+std::string filename(const assembler::SessionPDU& spdu) {
+  auto out = spdu.getName();
+  auto ph = spdu.getHeader<lrit::PrimaryHeader>();
+  auto nlh = spdu.getHeader<lrit::NOAALRITHeader>();
   auto pid = nlh.productID;
 
   // Special case GOES-R series.
   if (ph.fileType == 0 && (pid == 16 || pid == 17 || pid == 18 || pid == 19)) {
     // Some image files are segmented but have the same annotation.
     // To prevent overwriting earlier files, include the segment number.
-    if (spdu->hasHeader<lrit::SegmentIdentificationHeader>()) {
-      auto sih = spdu->getHeader<lrit::SegmentIdentificationHeader>();
+    if (spdu.hasHeader<lrit::SegmentIdentificationHeader>()) {
+      auto sih = spdu.getHeader<lrit::SegmentIdentificationHeader>();
       std::stringstream suffix;
       suffix << "_" << std::setfill('0') << std::setw(3) << sih.segmentNumber;
       out.insert(out.rfind(".lrit"), suffix.str());
@@ -85,49 +85,49 @@ int main(int argc, char** argv) {
 
   // Pass packets to packet assembler
   assembler::Assembler assembler;
-  std::array<uint8_t, 892> buf;
-  while (reader->nextPacket(buf)) {
-    VCDU vcdu(buf);
-
-    // Don't process VCDU if VCID was not specified
-    if (!opts.vcids.empty() && opts.vcids.count(vcdu.getVCID()) == 0) {
-      continue;
+  assembler::SessionPDUSink sink = [&opts] (const assembler::SessionPDU& spdu) {
+    // Skip stuff without filename
+    if (!spdu.hasHeader<lrit::AnnotationHeader>()) {
+      return;
     }
 
-    auto spdus = assembler.process(buf);
-    for (auto& spdu : spdus) {
+    // Check if we should include this file
+    if (filter(opts, spdu)) {
+      return;
+    }
 
-      // Skip stuff without filename
-      if (!spdu->hasHeader<lrit::AnnotationHeader>()) {
-        continue;
-      }
+    if (opts.dryrun) {
+      std::cout << "Writing (dry run): ";
+    } else {
+      std::cout << "Writing: ";
+    }
 
-      // Check if we should include this file
-      if (filter(opts, spdu)) {
-        continue;
+    const auto name = opts.out + "/" + filename(spdu);
+    std::cout << name << " ";
+
+    if (!opts.dryrun) {
+      std::ofstream fout(name, std::ofstream::binary);
+      const auto& buf = spdu.get();
+      fout.write((const char*)buf.data(), buf.size());
+      fout.close();
+      if (fout.fail()) {
+        std::cout << "(" << strerror(errno) << ")" << std::endl;
+        return;
       }
+    }
 
-      if (opts.dryrun) {
-        std::cout << "Writing (dry run): ";
-      } else {
-        std::cout << "Writing: ";
-      }
+    std::cout << "(" << spdu.size() << " bytes)" << std::endl;
+  };
 
-      const auto name = opts.out + "/" + filename(spdu);
-      std::cout << name << " ";
-
-      if (!opts.dryrun) {
-        std::ofstream fout(name, std::ofstream::binary);
-        const auto& buf = spdu->get();
-        fout.write((const char*)buf.data(), buf.size());
-        fout.close();
-        if (fout.fail()) {
-          std::cout << "(" << strerror(errno) << ")" << std::endl;
-          continue;
-        }
-      }
+  std::array<uint8_t, 892> buf;
+  while (reader->nextPacket(buf)) {
+    VCDU vcdu(buf);
 
-      std::cout << "(" << spdu->size() << " bytes)" << std::endl;
+    // Don't process VCDU if VCID was not specified
+    if (!opts.vcids.empty() && opts.vcids.count(vcdu.getVCID()) == 0) {
+      continue;
     }
+
+    assembler.process(buf, sink);
   }
 }
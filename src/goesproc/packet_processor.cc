@@ -20,6 +20,13 @@ void PacketProcessor::run(std::unique_ptr<PacketReader>& reader, bool verbose) {
       << "\033[K";
   }
 
+  assembler::SessionPDUSink sink = [this] (const assembler::SessionPDU& spdu) {
+    auto file = std::make_shared<lrit::File>(spdu.get());
+    for (auto& handler : handlers_) {
+      handler->handle(file);
+    }
+  };
+
   std::array<uint8_t, 892> buf;
   while (reader->nextPacket(buf)) {
     if (verbose) {
@@ -40,12 +47,6 @@ void PacketProcessor::run(std::unique_ptr<PacketReader>& reader, bool verbose) {
         << "\033[K";
     }
 
-    auto spdus = assembler_.process(buf);
-    for (auto& spdu : spdus) {
-      auto file = std::make_shared<lrit::File>(spdu->get());
-      for (auto& handler : handlers_) {
-        handler->handle(file);
-      }
-    }
+    assembler_.process(buf, sink);
   }
 }
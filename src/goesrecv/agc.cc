@@ -1,11 +1,18 @@
 #include "agc.h"
 
+#include <algorithm>
 #include <cmath>
 
+#include "convert.h"
+
 #ifdef __ARM_NEON
 #include <arm_neon.h>
 #endif
 
+#ifdef HAVE_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
 AGC::AGC() {
   min_ = 1e-6f;
   max_ = 1e+6f;
@@ -59,6 +66,17 @@ void AGC::work(
     size_t nsamples,
     std::complex<float>* ci,
     std::complex<float>* co) {
+#ifdef HAVE_X86_DISPATCH
+  if (util::cpu::level() >= util::cpu::AVX2) {
+    workAVX2(nsamples, ci, co);
+    return;
+  }
+  if (util::cpu::level() >= util::cpu::SSE41) {
+    workSSE41(nsamples, ci, co);
+    return;
+  }
+#endif
+
   // Process 4 samples at a time.
   for (size_t i = 0; i < nsamples; i += 4) {
     // Apply gain
@@ -75,10 +93,67 @@ void AGC::work(
   }
 }
 
+#ifdef HAVE_X86_DISPATCH
+
+void AGC::workSSE41(
+    size_t nsamples,
+    std::complex<float>* ci,
+    std::complex<float>* co) {
+  float* fi = (float*) ci;
+  float* fo = (float*) co;
+
+  // Process 4 samples at a time (2 samples per register).
+  for (size_t i = 0; i < nsamples; i += 4) {
+    __m128 gain = _mm_set1_ps(gain_);
+
+    // Apply gain
+    __m128 f01 = _mm_mul_ps(_mm_loadu_ps(&fi[2*i+0]), gain);
+    __m128 f23 = _mm_mul_ps(_mm_loadu_ps(&fi[2*i+4]), gain);
+    _mm_storeu_ps(&fo[2*i+0], f01);
+    _mm_storeu_ps(&fo[2*i+4], f23);
+
+    // Update gain.
+    // Use only the first sample and ignore the others.
+    __m128 x2 = _mm_mul_ps(f01, f01);
+    x2 = _mm_add_ss(x2, _mm_movehdup_ps(x2));
+    gain_ += alpha_ * (0.5f - _mm_cvtss_f32(_mm_sqrt_ss(x2)));
+    gain_ = std::max(gain_, min_);
+    gain_ = std::min(gain_, max_);
+  }
+}
+
+void AGC::workAVX2(
+    size_t nsamples,
+    std::complex<float>* ci,
+    std::complex<float>* co) {
+  float* fi = (float*) ci;
+  float* fo = (float*) co;
+
+  // Process 4 samples at a time (4 samples per register).
+  for (size_t i = 0; i < nsamples; i += 4) {
+    __m256 gain = _mm256_set1_ps(gain_);
+
+    // Apply gain
+    __m256 f = _mm256_mul_ps(_mm256_loadu_ps(&fi[2*i]), gain);
+    _mm256_storeu_ps(&fo[2*i], f);
+
+    // Update gain.
+    // Use only the first sample and ignore the others.
+    __m128 f01 = _mm256_castps256_ps128(f);
+    __m128 x2 = _mm_mul_ps(f01, f01);
+    x2 = _mm_add_ss(x2, _mm_movehdup_ps(x2));
+    gain_ += alpha_ * (0.5f - _mm_cvtss_f32(_mm_sqrt_ss(x2)));
+    gain_ = std::max(gain_, min_);
+    gain_ = std::min(gain_, max_);
+  }
+}
+
+#endif
+
 #endif
 
 void AGC::work(
-    const std::shared_ptr<Queue<Samples> >& qin,
+    const std::shared_ptr<Queue<RawSamples> >& qin,
     const std::shared_ptr<Queue<Samples> >& qout) {
   auto input = qin->popForRead();
   if (!input) {
@@ -87,13 +162,25 @@ void AGC::work(
   }
 
   auto output = qout->popForWrite();
+  output->timestamp = input->timestamp;
+  timestamp_ = input->timestamp;
   auto nsamples = input->size();
   output->resize(nsamples);
 
   // Do actual work
-  auto ci = input->data();
   auto co = output->data();
-  work(nsamples, ci, co);
+  if (input->format == RawSamples::CF32) {
+    work(nsamples, input->as<std::complex<float> >(), co);
+  } else {
+    // Chunk size is a multiple of 4 (see work function)
+    constexpr size_t chunk = 1024;
+    tmp_.resize(chunk);
+    for (size_t i = 0; i < nsamples; i += chunk) {
+      auto n = std::min(chunk, nsamples - i);
+      toFloat(*input, i, n, tmp_.data());
+      work(n, tmp_.data(), co + i);
+    }
+  }
 
   // Return input buffer
   qin->pushRead(std::move(input));
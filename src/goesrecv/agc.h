@@ -2,6 +2,8 @@
 
 #include <memory>
 
+#include <util/cpu.h>
+
 #include "sample_publisher.h"
 #include "types.h"
 
@@ -25,8 +27,12 @@ public:
     return gain_;
   }
 
+  const Timestamp& getTimestamp() const {
+    return timestamp_;
+  }
+
   void work(
-      const std::shared_ptr<Queue<Samples> >& qin,
+      const std::shared_ptr<Queue<RawSamples> >& qin,
       const std::shared_ptr<Queue<Samples> >& qout);
 
 protected:
@@ -35,10 +41,28 @@ protected:
       std::complex<float>* fi,
       std::complex<float>* fo);
 
+#ifdef HAVE_X86_DISPATCH
+  TARGET_SSE41 void workSSE41(
+      size_t nsamples,
+      std::complex<float>* fi,
+      std::complex<float>* fo);
+
+  TARGET_AVX2 void workAVX2(
+      size_t nsamples,
+      std::complex<float>* fi,
+      std::complex<float>* fo);
+#endif
+
   float min_;
   float max_;
   float gain_;
   float alpha_;
 
+  // Fixed point input is converted to float in chunks that fit in L1
+  Samples tmp_;
+
   std::unique_ptr<SamplePublisher> samplePublisher_;
+
+  // Of the most recent input block
+  Timestamp timestamp_;
 };
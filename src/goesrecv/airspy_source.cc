@@ -1,12 +1,13 @@
 #include "airspy_source.h"
 
-#include <pthread.h>
-
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 
 #include <util/error.h>
 
+#include "threads.h"
+
 std::unique_ptr<Airspy> Airspy::open(uint32_t index) {
   struct airspy_device* dev = nullptr;
   auto rv = airspy_open(&dev);
@@ -25,8 +26,9 @@ Airspy::Airspy(struct airspy_device* dev) : dev_(dev) {
   // Load list of supported sample rates
   sampleRates_ = loadSampleRates();
 
-  // We produce floats so let the airspy library take care of it
-  auto rv = airspy_set_sample_type(dev_, AIRSPY_SAMPLE_FLOAT32_IQ);
+  // Pass on 16 bit samples; the first stage converts them to float.
+  // This halves the memory bandwidth compared to float samples.
+  auto rv = airspy_set_sample_type(dev_, AIRSPY_SAMPLE_INT16_IQ);
   ASSERT(rv == 0);
 }
 
@@ -85,18 +87,29 @@ static int airspy_callback(airspy_transfer* transfer) {
   return 0;
 }
 
-void Airspy::start(const std::shared_ptr<Queue<Samples> >& queue) {
+// Number of I/Q samples libairspy passes to a callback. Its USB
+// transfers are 256 KiB of 16 bit real samples, which it converts to
+// half as many I/Q samples.
+static constexpr uint32_t transferSamples = 65536;
+
+void Airspy::start(const std::shared_ptr<Queue<RawSamples> >& queue) {
   ASSERT(dev_ != nullptr);
   queue_ = queue;
+
+  // The callback thread is configured on the first transfer. Check
+  // that the settings can be applied now, so that invalid settings or
+  // missing privileges are reported here, not on that thread.
+  checkThreadConfig("airspy", threadConfig_);
+  configured_ = false;
+
+  // Every callback fills a block of transferSamples samples
+  prefault(*queue_, RawSamples::CS16, transferSamples);
+
   thread_ = std::thread([&] {
       auto rv = airspy_start_rx(dev_, &airspy_callback, this);
       ASSERT(rv == 0);
     });
-#ifdef __APPLE__
-  pthread_setname_np("airspy");
-#else
-  pthread_setname_np(thread_.native_handle(), "airspy");
-#endif
+  setThreadName(thread_, "airspy");
 }
 
 void Airspy::stop() {
@@ -115,10 +128,23 @@ void Airspy::stop() {
 }
 
 void Airspy::handle(const airspy_transfer* transfer) {
+  // Callbacks run on a thread owned by libairspy
+  if (!configured_) {
+    try {
+      configureCurrentThread("airspy", threadConfig_);
+    } catch (const std::exception& e) {
+      // Don't exit from a libairspy callback; keep receiving
+      // with the default settings instead.
+      std::cerr << e.what() << std::endl;
+    }
+    configured_ = true;
+  }
+
   auto nsamples = transfer->sample_count;
   auto out = queue_->popForWrite();
-  out->resize(nsamples);
-  memcpy(out->data(), transfer->samples, nsamples * sizeof(std::complex<float>));
+  out->resize(RawSamples::CS16, nsamples);
+  memcpy(out->data.data(), transfer->samples, out->data.size());
+  stamp(*out);
 
   // Publish output if applicable
   if (samplePublisher_) {
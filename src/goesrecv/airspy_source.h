@@ -35,7 +35,7 @@ public:
     samplePublisher_ = std::move(samplePublisher);
   }
 
-  virtual void start(const std::shared_ptr<Queue<Samples> >& queue) override;
+  virtual void start(const std::shared_ptr<Queue<RawSamples> >& queue) override;
 
   virtual void stop() override;
 
@@ -51,8 +51,11 @@ protected:
   // Background RX thread
   std::thread thread_;
 
+  // Set when the callback thread has been configured
+  bool configured_ = false;
+
   // Set on start; cleared on stop
-  std::shared_ptr<Queue<Samples> > queue_;
+  std::shared_ptr<Queue<RawSamples> > queue_;
 
   // Optional publisher for samples
   std::unique_ptr<SamplePublisher> samplePublisher_;
@@ -1,10 +1,16 @@
 #include <chrono>
+#include <cmath>
 #include <iostream>
 #include <numeric>
+#include <random>
+
+#include <util/cpu.h>
 
 #include "agc.h"
 #include "clock_recovery.h"
 #include "costas.h"
+#include "mmse_taps.h"
+#include "nco.h"
 #include "quantize.h"
 #include "rrc.h"
 #include "types.h"
@@ -28,13 +34,19 @@ protected:
   std::chrono::time_point<std::chrono::high_resolution_clock> start_;
 };
 
-template <typename T>
+// Input type is RawSamples for the first stage of the
+// demodulator, and Samples for the stages after that.
+template <typename T, typename In = Samples>
 class Benchmark {
 public:
-  explicit Benchmark(T& t, int blockSize)
+  explicit Benchmark(
+      T& t,
+      int blockSize,
+      RawSamples::Format format = RawSamples::CF32)
     : t_(t),
-      blockSize_(blockSize) {
-    inQueue_ = std::make_shared<Queue<Samples> >(4);
+      blockSize_(blockSize),
+      format_(format) {
+    inQueue_ = std::make_shared<Queue<In> >(4);
     outQueue_ = std::make_shared<Queue<Samples> >(4);
   }
 
@@ -73,7 +85,7 @@ public:
 
   void fillQueue() {
     auto input = inQueue_->popForWrite();
-    input->resize(blockSize_);
+    resize(*input);
     inQueue_->pushWrite(std::move(input));
   }
 
@@ -83,12 +95,312 @@ public:
   }
 
 protected:
+  void resize(Samples& samples) {
+    samples.resize(blockSize_);
+  }
+
+  void resize(RawSamples& samples) {
+    samples.resize(format_, blockSize_);
+  }
+
   T& t_;
   int blockSize_;
-  std::shared_ptr<Queue<Samples> > inQueue_;
+  RawSamples::Format format_;
+  std::shared_ptr<Queue<In> > inQueue_;
   std::shared_ptr<Queue<Samples> > outQueue_;
 };
 
+// Previous clock recovery implementation, kept to compare against.
+// It copies every input block into a vector, erases the consumed
+// samples afterwards, and uses a scalar interpolator.
+class ReferenceClockRecovery {
+public:
+  explicit ReferenceClockRecovery(uint32_t sampleRate, uint32_t symbolRate) {
+    const auto bw = 1e-3f;
+    const auto damp = sqrtf(2.0f) / 2.0f;
+    mu_ = 0.0f;
+    omega_ = ((float) sampleRate / (float) symbolRate);
+    muGain_ = (4 * damp * bw) / (1.0 + 2.0 * damp * bw + bw * bw);
+    omegaGain_ = (4 * bw * bw) / (1.0 + 2.0 * damp * bw + bw * bw);
+    omegaMin_ = omega_ - 0.002f * omega_;
+    omegaMax_ = omega_ + 0.002f * omega_;
+    p0t_ = p1t_ = p2t_ = 0.0f;
+    c0t_ = c1t_ = c2t_ = 0.0f;
+  }
+
+  void work(
+      const std::shared_ptr<Queue<Samples> >& qin,
+      const std::shared_ptr<Queue<Samples> >& qout) {
+    auto input = qin->popForRead();
+    if (!input) {
+      qout->close();
+      return;
+    }
+
+    auto output = qout->popForWrite();
+    tmp_.insert(tmp_.end(), input->begin(), input->end());
+    qin->pushRead(std::move(input));
+
+    auto nsamples = tmp_.size();
+    output->clear();
+    output->reserve(nsamples / omega_);
+
+    size_t i = 0;
+    while (i < nsamples) {
+      float muf = (float) mu_;
+      int mui = (int) mu_;
+      const std::complex<float>* s = &tmp_[i + mui];
+      if ((i + mui + 7) >= nsamples) {
+        break;
+      }
+
+      i += mui;
+      mu_ -= mui;
+      muf = muf - (float) mui;
+
+      std::complex<float> acc = 0.0f;
+      const auto taps = mmseTaps[(int) (muf * 128.0f)];
+      for (auto k = 0; k < NUM_TAPS; k++) {
+        acc += taps[k] * s[k];
+      }
+
+      p2t_ = p1t_;
+      p1t_ = p0t_;
+      p0t_ = acc;
+      c2t_ = c1t_;
+      c1t_ = c0t_;
+      c0t_.real((p0t_.real() > 0.0f ? 1.0f : 0.0f));
+      c0t_.imag((p0t_.imag() > 0.0f ? 1.0f : 0.0f));
+      output->push_back(p0t_);
+
+      std::complex<float> x = (c0t_ - c2t_) * std::conj(p1t_);
+      std::complex<float> y = (p0t_ - p2t_) * std::conj(c1t_);
+      std::complex<float> u = y - x;
+      float mm = u.real();
+      mm = 0.5f * (fabsf(mm + 1.0f) - fabsf(mm - 1.0f));
+      omega_ += omegaGain_ * mm;
+      if (omega_ < omegaMin_) {
+        omega_ = omegaMax_;
+      }
+      if (omega_ > omegaMax_) {
+        omega_ = omegaMin_;
+      }
+      mu_ += omega_ + muGain_ * mm;
+    }
+
+    tmp_.erase(tmp_.begin(), tmp_.begin() + i);
+    qout->pushWrite(std::move(output));
+  }
+
+protected:
+  float omega_;
+  float omegaMin_;
+  float omegaMax_;
+  float omegaGain_;
+  float mu_;
+  float muGain_;
+  std::complex<float> p0t_;
+  std::complex<float> p1t_;
+  std::complex<float> p2t_;
+  std::complex<float> c0t_;
+  std::complex<float> c1t_;
+  std::complex<float> c2t_;
+  Samples tmp_;
+};
+
+// Run both clock recovery implementations on the same BPSK signal
+// (with varying block sizes) and report how much their output differs.
+void compareClockRecovery(uint32_t sampleRate, uint32_t symbolRate) {
+  ClockRecovery clock(sampleRate, symbolRate);
+  ReferenceClockRecovery reference(sampleRate, symbolRate);
+  auto qin = std::make_shared<Queue<Samples> >(1);
+  auto qout = std::make_shared<Queue<Samples> >(1);
+
+  std::mt19937 gen(0);
+  std::normal_distribution<float> noise(0.0f, 0.1f);
+  const float sps = (float) sampleRate / (float) symbolRate;
+  Samples signal(1024 * 1024);
+  float symbol = 1.0f;
+  for (size_t i = 0; i < signal.size(); i++) {
+    if (fmodf(i, sps) < 1.0f) {
+      symbol = (gen() & 1) ? 1.0f : -1.0f;
+    }
+    signal[i] = std::complex<float>(symbol + noise(gen), noise(gen));
+  }
+
+  auto run = [&](auto& t, Samples& out) {
+    size_t pos = 0;
+    while (pos < signal.size()) {
+      const size_t n = std::min<size_t>(signal.size() - pos, 4 * (1 + gen() % 4096));
+      auto input = qin->popForWrite();
+      input->assign(signal.begin() + pos, signal.begin() + pos + n);
+      qin->pushWrite(std::move(input));
+      t.work(qin, qout);
+      auto output = qout->popForRead();
+      out.insert(out.end(), output->begin(), output->end());
+      qout->pushRead(std::move(output));
+      pos += n;
+    }
+  };
+
+  Samples out0;
+  Samples out1;
+  run(reference, out0);
+  run(clock, out1);
+
+  float maxError = 0.0f;
+  for (size_t i = 0; i < std::min(out0.size(), out1.size()); i++) {
+    maxError = std::max(maxError, std::abs(out0[i] - out1[i]));
+  }
+
+  std::cerr << "  Symbols (reference):  " << out0.size() << std::endl;
+  std::cerr << "  Symbols:              " << out1.size() << std::endl;
+  std::cerr << "  Max. difference:      " << maxError << std::endl;
+}
+
+// Previous Costas loop implementation, kept to compare against.
+// It computes sin/cos with cosf/sinf for every sample.
+class ReferenceCostas {
+public:
+  explicit ReferenceCostas() {
+    float damp = sqrtf(2.0f)/2.0f;
+    float bw = 0.005f;
+    phase_ = 0.0f;
+    freq_ = 0.0f;
+    alpha_ = (4 * damp * bw) / (1.0 + 2.0 * damp * bw + bw * bw);
+    beta_ = (4 * bw * bw) / (1.0 + 2.0 * damp * bw + bw * bw);
+    maxDeviation_ = 2 * M_PI;
+  }
+
+  void work(
+      const std::shared_ptr<Queue<Samples> >& qin,
+      const std::shared_ptr<Queue<Samples> >& qout) {
+    auto input = qin->popForRead();
+    if (!input) {
+      qout->close();
+      return;
+    }
+
+    auto output = qout->popForWrite();
+    auto nsamples = input->size();
+    output->resize(nsamples);
+    auto fi = input->data();
+    auto fo = output->data();
+    for (size_t i = 0; i < nsamples; i += 4) {
+      for (size_t j = 0; j < 4; j++) {
+        float phase = -(phase_ + j * freq_);
+        fo[i + j] = fi[i + j] * std::complex<float>(cosf(phase), sinf(phase));
+      }
+
+      float terr = 0.0f;
+      for (size_t j = 0; j < 4; j++) {
+        float err = fo[i + j].real() * fo[i + j].imag();
+        terr += (0.5f * (fabsf(err + 1.0f) - fabsf(err - 1.0f))) / 4.0f;
+      }
+
+      freq_ += beta_ * terr;
+      phase_ += alpha_ * terr + freq_;
+      freq_ = (0.5f * (fabsf(freq_ + maxDeviation_) -
+                       fabsf(freq_ - maxDeviation_)));
+      if (phase_ > 2 * M_PI || phase_ < -2 * M_PI) {
+        float frac = phase_ * (1.0 / (2 * M_PI));
+        phase_ = (frac - (float)((int)frac)) * (2 * M_PI);
+      }
+    }
+
+    qin->pushRead(std::move(input));
+    qout->pushWrite(std::move(output));
+  }
+
+protected:
+  float phase_;
+  float freq_;
+  float alpha_;
+  float beta_;
+  float maxDeviation_;
+};
+
+// Compare the NCO against double precision cos/sin over the range
+// of phases that the Costas loop uses, and against cosf/sinf for
+// throughput. Then run both Costas loop implementations on the same
+// BPSK signal with a frequency offset and report how much their
+// output differs.
+void compareCostas() {
+  NCO nco;
+  const size_t n = 1024 * 1024;
+  std::vector<float> phase(n);
+  for (size_t i = 0; i < n; i++) {
+    phase[i] = -2 * M_PI + (4 * M_PI * i) / n;
+  }
+
+  std::vector<float> cos(n);
+  std::vector<float> sin(n);
+  float maxError = 0.0f;
+  for (size_t i = 0; i < n; i++) {
+    const double p = phase[i];
+    nco.sincos(phase[i], 0.0f, 1, &cos[i], &sin[i]);
+    maxError = std::max<float>(maxError, fabs(cos[i] - std::cos(p)));
+    maxError = std::max<float>(maxError, fabs(sin[i] - std::sin(p)));
+  }
+
+  // Throughput is measured the way the Costas loop uses the NCO
+  const float freq = 0.1f;
+  Timer dt;
+  for (size_t i = 0; i < n; i += 4) {
+    nco.sincos(phase[i], freq, 4, &cos[i], &sin[i]);
+  }
+  const auto ncoNs = dt.ns();
+
+  dt.start();
+  for (size_t i = 0; i < n; i++) {
+    cos[i] = cosf(phase[i]);
+    sin[i] = sinf(phase[i]);
+  }
+  const auto libmNs = dt.ns();
+
+  std::cerr << "  NCO max. error:       " << std::scientific << maxError << std::fixed << std::endl;
+  std::cerr << "  NCO sin/cos:          " << (float) ncoNs / n << "ns" << std::endl;
+  std::cerr << "  cosf/sinf:            " << (float) libmNs / n << "ns" << std::endl;
+
+  Costas costas;
+  ReferenceCostas reference;
+  auto qin = std::make_shared<Queue<Samples> >(1);
+  auto qout = std::make_shared<Queue<Samples> >(1);
+
+  std::mt19937 gen(0);
+  std::normal_distribution<float> noise(0.0f, 0.1f);
+  Samples signal(1024 * 1024);
+  for (size_t i = 0; i < signal.size(); i++) {
+    const float symbol = (gen() & 1) ? 1.0f : -1.0f;
+    signal[i] = std::polar(symbol, 0.001f * i) +
+      std::complex<float>(noise(gen), noise(gen));
+  }
+
+  auto run = [&](auto& t, Samples& out) {
+    for (size_t pos = 0; pos < signal.size(); pos += 4096) {
+      auto input = qin->popForWrite();
+      input->assign(signal.begin() + pos, signal.begin() + pos + 4096);
+      qin->pushWrite(std::move(input));
+      t.work(qin, qout);
+      auto output = qout->popForRead();
+      out.insert(out.end(), output->begin(), output->end());
+      qout->pushRead(std::move(output));
+    }
+  };
+
+  Samples out0;
+  Samples out1;
+  run(reference, out0);
+  run(costas, out1);
+
+  maxError = 0.0f;
+  for (size_t i = 0; i < out0.size(); i++) {
+    maxError = std::max(maxError, std::abs(out0[i] - out1[i]));
+  }
+
+  std::cerr << "  Max. difference:      " << std::scientific << maxError << std::fixed << std::endl;
+}
+
 int main(int argc, char** argv) {
   std::string name;
   if (argc == 2) {
@@ -96,29 +408,73 @@ int main(int argc, char** argv) {
   }
 
   auto blockSize = 128 * 1024;
-  if (name.empty() || name == "agc") {
-    std::cerr << "AGC (block size=" << blockSize << ")" << std::endl;
-    auto agc = std::make_unique<AGC>();
-    auto benchmark = Benchmark<AGC>(*agc, blockSize);
-    benchmark.run();
+
+  // Run vectorized stages once for every instruction set
+  // level that this CPU supports, to compare implementations.
+  const auto maxLevel = util::cpu::detect();
+  for (int i = util::cpu::GENERIC; i <= maxLevel; i++) {
+    const auto level = (util::cpu::Level) i;
+    const auto suffix = std::string(", ") + util::cpu::levelToString(level);
+    util::cpu::setLevel(level);
+    if (name.empty() || name == "agc") {
+      std::cerr << "AGC (block size=" << blockSize << suffix << ")" << std::endl;
+      auto agc = std::make_unique<AGC>();
+      auto benchmark = Benchmark<AGC, RawSamples>(*agc, blockSize);
+      benchmark.run();
+    }
+    if (name.empty() || name == "agc") {
+      std::cerr << "AGC, 8 bit input (block size=" << blockSize << suffix << ")" << std::endl;
+      auto agc = std::make_unique<AGC>();
+      auto benchmark = Benchmark<AGC, RawSamples>(*agc, blockSize, RawSamples::CS8);
+      benchmark.run();
+    }
+    if (name.empty() || name == "agc") {
+      std::cerr << "AGC, 16 bit input (block size=" << blockSize << suffix << ")" << std::endl;
+      auto agc = std::make_unique<AGC>();
+      auto benchmark = Benchmark<AGC, RawSamples>(*agc, blockSize, RawSamples::CS16);
+      benchmark.run();
+    }
+    if (name.empty() || name == "costas") {
+      std::cerr << "Costas (block size=" << blockSize << suffix << ")" << std::endl;
+      auto costas = std::make_unique<Costas>();
+      auto benchmark = Benchmark<Costas>(*costas, blockSize);
+      benchmark.run();
+      compareCostas();
+    }
+    if (name.empty() || name == "rrc") {
+      std::cerr << "FIR (N=31, block size=" << blockSize << suffix << ")" << std::endl;
+      // Note: filter runs WITHOUT decimation
+      auto rrc = std::make_unique<RRC>(1, 3000000, 927000, 31, 0.5f);
+      auto benchmark = Benchmark<RRC>(*rrc, 128 * 1024);
+      benchmark.run();
+    }
+    if (name.empty() || name == "rrc") {
+      std::cerr << "FIR (N=31, decimation=2, block size=" << blockSize << suffix << ")" << std::endl;
+      auto rrc = std::make_unique<RRC>(2, 3000000, 927000, 31, 0.5f);
+      auto benchmark = Benchmark<RRC>(*rrc, 128 * 1024);
+      benchmark.run();
+    }
+    if (name.empty() || name == "clock") {
+      std::cerr << "Clock recovery (block size=" << blockSize << suffix << ")" << std::endl;
+      auto clock = std::make_unique<ClockRecovery>(3000000, 927000);
+      auto benchmark = Benchmark<ClockRecovery>(*clock, 128 * 1024);
+      benchmark.run();
+      compareClockRecovery(3000000, 927000);
+    }
   }
+  util::cpu::setLevel(maxLevel);
+
   if (name.empty() || name == "costas") {
-    std::cerr << "Costas (block size=" << blockSize << ")" << std::endl;
-    auto costas = std::make_unique<Costas>();
-    auto benchmark = Benchmark<Costas>(*costas, blockSize);
-    benchmark.run();
-  }
-  if (name.empty() || name == "rrc") {
-    std::cerr << "FIR (N=31, block size=" << blockSize << ")" << std::endl;
-    // Note: filter runs WITHOUT decimation
-    auto rrc = std::make_unique<RRC>(1, 3000000, 927000);
-    auto benchmark = Benchmark<RRC>(*rrc, 128 * 1024);
+    std::cerr << "Costas, reference implementation (block size=" << blockSize << ")" << std::endl;
+    auto costas = std::make_unique<ReferenceCostas>();
+    auto benchmark = Benchmark<ReferenceCostas>(*costas, blockSize);
     benchmark.run();
   }
+
   if (name.empty() || name == "clock") {
-    std::cerr << "Clock recovery (block size=" << blockSize << ")" << std::endl;
-    auto clock = std::make_unique<ClockRecovery>(3000000, 927000);
-    auto benchmark = Benchmark<ClockRecovery>(*clock, 128 * 1024);
+    std::cerr << "Clock recovery, reference implementation (block size=" << blockSize << ")" << std::endl;
+    auto clock = std::make_unique<ReferenceClockRecovery>(3000000, 927000);
+    auto benchmark = Benchmark<ReferenceClockRecovery>(*clock, 128 * 1024);
     benchmark.run();
   }
 }
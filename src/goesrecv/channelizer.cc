@@ -0,0 +1,126 @@
+#include "channelizer.h"
+
+#include <util/error.h>
+
+#include "threads.h"
+
+namespace {
+
+// Source for a single channel
+class Channel : public Source {
+public:
+  explicit Channel(std::shared_ptr<Channelizer> channelizer, size_t index)
+    : channelizer_(std::move(channelizer)),
+      index_(index) {
+  }
+
+  virtual uint32_t getSampleRate() const override {
+    return channelizer_->getSampleRate();
+  }
+
+  virtual void start(const std::shared_ptr<Queue<RawSamples> >& queue) override {
+    channelizer_->start(index_, queue);
+  }
+
+  virtual void stop() override {
+    channelizer_->stop();
+  }
+
+protected:
+  std::shared_ptr<Channelizer> channelizer_;
+  size_t index_;
+};
+
+} // namespace
+
+std::vector<std::unique_ptr<Source> > Channelizer::split(
+    std::unique_ptr<Source> source,
+    size_t channels,
+    int queueDepth,
+    OverflowPolicy overflow) {
+  auto channelizer = std::make_shared<Channelizer>(
+    std::move(source),
+    channels,
+    queueDepth,
+    overflow);
+  std::vector<std::unique_ptr<Source> > out;
+  for (size_t i = 0; i < channels; i++) {
+    out.push_back(std::make_unique<Channel>(channelizer, i));
+  }
+  return out;
+}
+
+Channelizer::Channelizer(
+    std::unique_ptr<Source> source,
+    size_t channels,
+    int queueDepth,
+    OverflowPolicy overflow) :
+    source_(std::move(source)),
+    outputs_(channels),
+    started_(0),
+    stopped_(false) {
+  ASSERT(channels > 0);
+  input_ = std::make_shared<Queue<RawSamples> >(queueDepth, overflow);
+}
+
+Channelizer::~Channelizer() {
+  stop();
+}
+
+void Channelizer::start(
+    size_t channel,
+    const std::shared_ptr<Queue<RawSamples> >& queue) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  ASSERT(channel < outputs_.size() && !outputs_[channel]);
+  outputs_[channel] = queue;
+  if (++started_ < outputs_.size()) {
+    return;
+  }
+
+  thread_ = std::thread(&Channelizer::loop, this);
+  setThreadName(thread_, "channelizer");
+  source_->start(input_);
+}
+
+void Channelizer::stop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (stopped_ || started_ < outputs_.size()) {
+    return;
+  }
+
+  // Source closes its queue when it stops, and the loop
+  // closes the channel queues when it has drained it.
+  stopped_ = true;
+  source_->stop();
+  thread_.join();
+}
+
+void Channelizer::loop() {
+  const auto last = outputs_.size() - 1;
+  for (;;) {
+    auto input = input_->popForRead();
+    if (!input) {
+      break;
+    }
+
+    for (size_t i = 0; i <= last; i++) {
+      auto& queue = outputs_[i];
+      auto output = queue->popForWrite();
+      output->format = input->format;
+      output->timestamp = input->timestamp;
+      if (i < last) {
+        output->data.assign(input->data.begin(), input->data.end());
+      } else {
+        // Source gets the buffer of the last channel back
+        std::swap(output->data, input->data);
+      }
+      queue->pushWrite(std::move(output));
+    }
+
+    input_->pushRead(std::move(input));
+  }
+
+  for (auto& queue : outputs_) {
+    queue->close();
+  }
+}
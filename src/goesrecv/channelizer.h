@@ -0,0 +1,58 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "source.h"
+
+// Fans out the samples of a single source to multiple demodulators.
+//
+// Every demodulator gets its own copy of every block, in the format
+// the source produced it. Selecting a channel (shifting it to 0 Hz,
+// filtering, and decimating) is done by the front end of every
+// demodulator, on its own thread(s), so the channels are processed
+// in parallel. The last channel gets the original buffer instead of
+// a copy.
+//
+// The source is started when every channel has been started, and
+// stopped when the first channel is stopped. A channel that falls
+// behind holds up all channels, as it would with a single channel.
+//
+class Channelizer {
+public:
+  // Returns a source for every channel, to pass to the demodulators
+  static std::vector<std::unique_ptr<Source> > split(
+      std::unique_ptr<Source> source,
+      size_t channels,
+      int queueDepth,
+      OverflowPolicy overflow);
+
+  explicit Channelizer(
+      std::unique_ptr<Source> source,
+      size_t channels,
+      int queueDepth,
+      OverflowPolicy overflow);
+  ~Channelizer();
+
+  uint32_t getSampleRate() const {
+    return source_->getSampleRate();
+  }
+
+  void start(size_t channel, const std::shared_ptr<Queue<RawSamples> >& queue);
+
+  void stop();
+
+protected:
+  void loop();
+
+  std::unique_ptr<Source> source_;
+  std::shared_ptr<Queue<RawSamples> > input_;
+  std::vector<std::shared_ptr<Queue<RawSamples> > > outputs_;
+
+  std::mutex mutex_;
+  size_t started_;
+  bool stopped_;
+  std::thread thread_;
+};
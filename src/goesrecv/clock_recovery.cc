@@ -1,144 +1,105 @@
 #include "clock_recovery.h"
 
+#include <algorithm>
 #include <cmath>
 
-static constexpr int NUM_TAPS = 8;
-static constexpr int NUM_STEPS = 128;
-
-// Interpolator taps from GNU Radio.
-// See ./support/generate_interpolator_taps.py for more info.
-static const float mmseTaps[NUM_STEPS+1][NUM_TAPS] = {
-  {  0.00000e+00, 0.00000e+00,  0.00000e+00, 1.00000e+00, 0.00000e+00,  0.00000e+00, 0.00000e+00,  0.00000e+00 },
-  { -1.98993e-04, 1.24642e-03, -5.41054e-03, 9.98534e-01, 7.89295e-03, -2.76968e-03, 8.53777e-04, -1.54700e-04 },
-  { -3.96391e-04, 2.47942e-03, -1.07209e-02, 9.96891e-01, 1.58840e-02, -5.55134e-03, 1.70888e-03, -3.09412e-04 },
-  { -5.92100e-04, 3.69852e-03, -1.59305e-02, 9.95074e-01, 2.39714e-02, -8.34364e-03, 2.56486e-03, -4.64053e-04 },
-  { -7.86031e-04, 4.90322e-03, -2.10389e-02, 9.93082e-01, 3.21531e-02, -1.11453e-02, 3.42130e-03, -6.18544e-04 },
-  { -9.78093e-04, 6.09305e-03, -2.60456e-02, 9.90917e-01, 4.04274e-02, -1.39548e-02, 4.27773e-03, -7.72802e-04 },
-  { -1.16820e-03, 7.26755e-03, -3.09503e-02, 9.88580e-01, 4.87921e-02, -1.67710e-02, 5.13372e-03, -9.26747e-04 },
-  { -1.35627e-03, 8.42626e-03, -3.57525e-02, 9.86071e-01, 5.72454e-02, -1.95925e-02, 5.98883e-03, -1.08030e-03 },
-  { -1.54221e-03, 9.56876e-03, -4.04519e-02, 9.83392e-01, 6.57852e-02, -2.24178e-02, 6.84261e-03, -1.23337e-03 },
-  { -1.72594e-03, 1.06946e-02, -4.50483e-02, 9.80543e-01, 7.44095e-02, -2.52457e-02, 7.69462e-03, -1.38589e-03 },
-  { -1.90738e-03, 1.18034e-02, -4.95412e-02, 9.77526e-01, 8.31162e-02, -2.80746e-02, 8.54441e-03, -1.53777e-03 },
-  { -2.08645e-03, 1.28947e-02, -5.39305e-02, 9.74342e-01, 9.19033e-02, -3.09033e-02, 9.39154e-03, -1.68894e-03 },
-  { -2.26307e-03, 1.39681e-02, -5.82159e-02, 9.70992e-01, 1.00769e-01, -3.37303e-02, 1.02356e-02, -1.83931e-03 },
-  { -2.43718e-03, 1.50233e-02, -6.23972e-02, 9.67477e-01, 1.09710e-01, -3.65541e-02, 1.10760e-02, -1.98880e-03 },
-  { -2.60868e-03, 1.60599e-02, -6.64743e-02, 9.63798e-01, 1.18725e-01, -3.93735e-02, 1.19125e-02, -2.13733e-03 },
-  { -2.77751e-03, 1.70776e-02, -7.04471e-02, 9.59958e-01, 1.27812e-01, -4.21869e-02, 1.27445e-02, -2.28483e-03 },
-  { -2.94361e-03, 1.80759e-02, -7.43154e-02, 9.55956e-01, 1.36968e-01, -4.49929e-02, 1.35716e-02, -2.43121e-03 },
-  { -3.10689e-03, 1.90545e-02, -7.80792e-02, 9.51795e-01, 1.46192e-01, -4.77900e-02, 1.43934e-02, -2.57640e-03 },
-  { -3.26730e-03, 2.00132e-02, -8.17385e-02, 9.47477e-01, 1.55480e-01, -5.05770e-02, 1.52095e-02, -2.72032e-03 },
-  { -3.42477e-03, 2.09516e-02, -8.52933e-02, 9.43001e-01, 1.64831e-01, -5.33522e-02, 1.60193e-02, -2.86289e-03 },
-  { -3.57923e-03, 2.18695e-02, -8.87435e-02, 9.38371e-01, 1.74242e-01, -5.61142e-02, 1.68225e-02, -3.00403e-03 },
-  { -3.73062e-03, 2.27664e-02, -9.20893e-02, 9.33586e-01, 1.83711e-01, -5.88617e-02, 1.76185e-02, -3.14367e-03 },
-  { -3.87888e-03, 2.36423e-02, -9.53307e-02, 9.28650e-01, 1.93236e-01, -6.15931e-02, 1.84071e-02, -3.28174e-03 },
-  { -4.02397e-03, 2.44967e-02, -9.84679e-02, 9.23564e-01, 2.02814e-01, -6.43069e-02, 1.91877e-02, -3.41815e-03 },
-  { -4.16581e-03, 2.53295e-02, -1.01501e-01, 9.18329e-01, 2.12443e-01, -6.70018e-02, 1.99599e-02, -3.55283e-03 },
-  { -4.30435e-03, 2.61404e-02, -1.04430e-01, 9.12947e-01, 2.22120e-01, -6.96762e-02, 2.07233e-02, -3.68570e-03 },
-  { -4.43955e-03, 2.69293e-02, -1.07256e-01, 9.07420e-01, 2.31843e-01, -7.23286e-02, 2.14774e-02, -3.81671e-03 },
-  { -4.57135e-03, 2.76957e-02, -1.09978e-01, 9.01749e-01, 2.41609e-01, -7.49577e-02, 2.22218e-02, -3.94576e-03 },
-  { -4.69970e-03, 2.84397e-02, -1.12597e-01, 8.95936e-01, 2.51417e-01, -7.75620e-02, 2.29562e-02, -4.07279e-03 },
-  { -4.82456e-03, 2.91609e-02, -1.15113e-01, 8.89984e-01, 2.61263e-01, -8.01399e-02, 2.36801e-02, -4.19774e-03 },
-  { -4.94589e-03, 2.98593e-02, -1.17526e-01, 8.83893e-01, 2.71144e-01, -8.26900e-02, 2.43930e-02, -4.32052e-03 },
-  { -5.06363e-03, 3.05345e-02, -1.19837e-01, 8.77666e-01, 2.81060e-01, -8.52109e-02, 2.50946e-02, -4.44107e-03 },
-  { -5.17776e-03, 3.11866e-02, -1.22047e-01, 8.71305e-01, 2.91006e-01, -8.77011e-02, 2.57844e-02, -4.55932e-03 },
-  { -5.28823e-03, 3.18153e-02, -1.24154e-01, 8.64812e-01, 3.00980e-01, -9.01591e-02, 2.64621e-02, -4.67520e-03 },
-  { -5.39500e-03, 3.24205e-02, -1.26161e-01, 8.58189e-01, 3.10980e-01, -9.25834e-02, 2.71272e-02, -4.78866e-03 },
-  { -5.49804e-03, 3.30021e-02, -1.28068e-01, 8.51437e-01, 3.21004e-01, -9.49727e-02, 2.77794e-02, -4.89961e-03 },
-  { -5.59731e-03, 3.35600e-02, -1.29874e-01, 8.44559e-01, 3.31048e-01, -9.73254e-02, 2.84182e-02, -5.00800e-03 },
-  { -5.69280e-03, 3.40940e-02, -1.31581e-01, 8.37557e-01, 3.41109e-01, -9.96402e-02, 2.90433e-02, -5.11376e-03 },
-  { -5.78446e-03, 3.46042e-02, -1.33189e-01, 8.30432e-01, 3.51186e-01, -1.01915e-01, 2.96543e-02, -5.21683e-03 },
-  { -5.87227e-03, 3.50903e-02, -1.34699e-01, 8.23188e-01, 3.61276e-01, -1.04150e-01, 3.02507e-02, -5.31716e-03 },
-  { -5.95620e-03, 3.55525e-02, -1.36111e-01, 8.15826e-01, 3.71376e-01, -1.06342e-01, 3.08323e-02, -5.41467e-03 },
-  { -6.03624e-03, 3.59905e-02, -1.37426e-01, 8.08348e-01, 3.81484e-01, -1.08490e-01, 3.13987e-02, -5.50931e-03 },
-  { -6.11236e-03, 3.64044e-02, -1.38644e-01, 8.00757e-01, 3.91596e-01, -1.10593e-01, 3.19495e-02, -5.60103e-03 },
-  { -6.18454e-03, 3.67941e-02, -1.39767e-01, 7.93055e-01, 4.01710e-01, -1.12650e-01, 3.24843e-02, -5.68976e-03 },
-  { -6.25277e-03, 3.71596e-02, -1.40794e-01, 7.85244e-01, 4.11823e-01, -1.14659e-01, 3.30027e-02, -5.77544e-03 },
-  { -6.31703e-03, 3.75010e-02, -1.41727e-01, 7.77327e-01, 4.21934e-01, -1.16618e-01, 3.35046e-02, -5.85804e-03 },
-  { -6.37730e-03, 3.78182e-02, -1.42566e-01, 7.69305e-01, 4.32038e-01, -1.18526e-01, 3.39894e-02, -5.93749e-03 },
-  { -6.43358e-03, 3.81111e-02, -1.43313e-01, 7.61181e-01, 4.42134e-01, -1.20382e-01, 3.44568e-02, -6.01374e-03 },
-  { -6.48585e-03, 3.83800e-02, -1.43968e-01, 7.52958e-01, 4.52218e-01, -1.22185e-01, 3.49066e-02, -6.08674e-03 },
-  { -6.53412e-03, 3.86247e-02, -1.44531e-01, 7.44637e-01, 4.62289e-01, -1.23933e-01, 3.53384e-02, -6.15644e-03 },
-  { -6.57836e-03, 3.88454e-02, -1.45004e-01, 7.36222e-01, 4.72342e-01, -1.25624e-01, 3.57519e-02, -6.22280e-03 },
-  { -6.61859e-03, 3.90420e-02, -1.45387e-01, 7.27714e-01, 4.82377e-01, -1.27258e-01, 3.61468e-02, -6.28577e-03 },
-  { -6.65479e-03, 3.92147e-02, -1.45682e-01, 7.19116e-01, 4.92389e-01, -1.28832e-01, 3.65227e-02, -6.34530e-03 },
-  { -6.68698e-03, 3.93636e-02, -1.45889e-01, 7.10431e-01, 5.02377e-01, -1.30347e-01, 3.68795e-02, -6.40135e-03 },
-  { -6.71514e-03, 3.94886e-02, -1.46009e-01, 7.01661e-01, 5.12337e-01, -1.31800e-01, 3.72167e-02, -6.45388e-03 },
-  { -6.73929e-03, 3.95900e-02, -1.46043e-01, 6.92808e-01, 5.22267e-01, -1.33190e-01, 3.75341e-02, -6.50285e-03 },
-  { -6.75943e-03, 3.96678e-02, -1.45993e-01, 6.83875e-01, 5.32164e-01, -1.34515e-01, 3.78315e-02, -6.54823e-03 },
-  { -6.77557e-03, 3.97222e-02, -1.45859e-01, 6.74865e-01, 5.42025e-01, -1.35775e-01, 3.81085e-02, -6.58996e-03 },
-  { -6.78771e-03, 3.97532e-02, -1.45641e-01, 6.65779e-01, 5.51849e-01, -1.36969e-01, 3.83650e-02, -6.62802e-03 },
-  { -6.79588e-03, 3.97610e-02, -1.45343e-01, 6.56621e-01, 5.61631e-01, -1.38094e-01, 3.86006e-02, -6.66238e-03 },
-  { -6.80007e-03, 3.97458e-02, -1.44963e-01, 6.47394e-01, 5.71370e-01, -1.39150e-01, 3.88151e-02, -6.69300e-03 },
-  { -6.80032e-03, 3.97077e-02, -1.44503e-01, 6.38099e-01, 5.81063e-01, -1.40136e-01, 3.90083e-02, -6.71985e-03 },
-  { -6.79662e-03, 3.96469e-02, -1.43965e-01, 6.28739e-01, 5.90706e-01, -1.41050e-01, 3.91800e-02, -6.74291e-03 },
-  { -6.78902e-03, 3.95635e-02, -1.43350e-01, 6.19318e-01, 6.00298e-01, -1.41891e-01, 3.93299e-02, -6.76214e-03 },
-  { -6.77751e-03, 3.94578e-02, -1.42658e-01, 6.09836e-01, 6.09836e-01, -1.42658e-01, 3.94578e-02, -6.77751e-03 },
-  { -6.76214e-03, 3.93299e-02, -1.41891e-01, 6.00298e-01, 6.19318e-01, -1.43350e-01, 3.95635e-02, -6.78902e-03 },
-  { -6.74291e-03, 3.91800e-02, -1.41050e-01, 5.90706e-01, 6.28739e-01, -1.43965e-01, 3.96469e-02, -6.79662e-03 },
-  { -6.71985e-03, 3.90083e-02, -1.40136e-01, 5.81063e-01, 6.38099e-01, -1.44503e-01, 3.97077e-02, -6.80032e-03 },
-  { -6.69300e-03, 3.88151e-02, -1.39150e-01, 5.71370e-01, 6.47394e-01, -1.44963e-01, 3.97458e-02, -6.80007e-03 },
-  { -6.66238e-03, 3.86006e-02, -1.38094e-01, 5.61631e-01, 6.56621e-01, -1.45343e-01, 3.97610e-02, -6.79588e-03 },
-  { -6.62802e-03, 3.83650e-02, -1.36969e-01, 5.51849e-01, 6.65779e-01, -1.45641e-01, 3.97532e-02, -6.78771e-03 },
-  { -6.58996e-03, 3.81085e-02, -1.35775e-01, 5.42025e-01, 6.74865e-01, -1.45859e-01, 3.97222e-02, -6.77557e-03 },
-  { -6.54823e-03, 3.78315e-02, -1.34515e-01, 5.32164e-01, 6.83875e-01, -1.45993e-01, 3.96678e-02, -6.75943e-03 },
-  { -6.50285e-03, 3.75341e-02, -1.33190e-01, 5.22267e-01, 6.92808e-01, -1.46043e-01, 3.95900e-02, -6.73929e-03 },
-  { -6.45388e-03, 3.72167e-02, -1.31800e-01, 5.12337e-01, 7.01661e-01, -1.46009e-01, 3.94886e-02, -6.71514e-03 },
-  { -6.40135e-03, 3.68795e-02, -1.30347e-01, 5.02377e-01, 7.10431e-01, -1.45889e-01, 3.93636e-02, -6.68698e-03 },
-  { -6.34530e-03, 3.65227e-02, -1.28832e-01, 4.92389e-01, 7.19116e-01, -1.45682e-01, 3.92147e-02, -6.65479e-03 },
-  { -6.28577e-03, 3.61468e-02, -1.27258e-01, 4.82377e-01, 7.27714e-01, -1.45387e-01, 3.90420e-02, -6.61859e-03 },
-  { -6.22280e-03, 3.57519e-02, -1.25624e-01, 4.72342e-01, 7.36222e-01, -1.45004e-01, 3.88454e-02, -6.57836e-03 },
-  { -6.15644e-03, 3.53384e-02, -1.23933e-01, 4.62289e-01, 7.44637e-01, -1.44531e-01, 3.86247e-02, -6.53412e-03 },
-  { -6.08674e-03, 3.49066e-02, -1.22185e-01, 4.52218e-01, 7.52958e-01, -1.43968e-01, 3.83800e-02, -6.48585e-03 },
-  { -6.01374e-03, 3.44568e-02, -1.20382e-01, 4.42134e-01, 7.61181e-01, -1.43313e-01, 3.81111e-02, -6.43358e-03 },
-  { -5.93749e-03, 3.39894e-02, -1.18526e-01, 4.32038e-01, 7.69305e-01, -1.42566e-01, 3.78182e-02, -6.37730e-03 },
-  { -5.85804e-03, 3.35046e-02, -1.16618e-01, 4.21934e-01, 7.77327e-01, -1.41727e-01, 3.75010e-02, -6.31703e-03 },
-  { -5.77544e-03, 3.30027e-02, -1.14659e-01, 4.11823e-01, 7.85244e-01, -1.40794e-01, 3.71596e-02, -6.25277e-03 },
-  { -5.68976e-03, 3.24843e-02, -1.12650e-01, 4.01710e-01, 7.93055e-01, -1.39767e-01, 3.67941e-02, -6.18454e-03 },
-  { -5.60103e-03, 3.19495e-02, -1.10593e-01, 3.91596e-01, 8.00757e-01, -1.38644e-01, 3.64044e-02, -6.11236e-03 },
-  { -5.50931e-03, 3.13987e-02, -1.08490e-01, 3.81484e-01, 8.08348e-01, -1.37426e-01, 3.59905e-02, -6.03624e-03 },
-  { -5.41467e-03, 3.08323e-02, -1.06342e-01, 3.71376e-01, 8.15826e-01, -1.36111e-01, 3.55525e-02, -5.95620e-03 },
-  { -5.31716e-03, 3.02507e-02, -1.04150e-01, 3.61276e-01, 8.23188e-01, -1.34699e-01, 3.50903e-02, -5.87227e-03 },
-  { -5.21683e-03, 2.96543e-02, -1.01915e-01, 3.51186e-01, 8.30432e-01, -1.33189e-01, 3.46042e-02, -5.78446e-03 },
-  { -5.11376e-03, 2.90433e-02, -9.96402e-02, 3.41109e-01, 8.37557e-01, -1.31581e-01, 3.40940e-02, -5.69280e-03 },
-  { -5.00800e-03, 2.84182e-02, -9.73254e-02, 3.31048e-01, 8.44559e-01, -1.29874e-01, 3.35600e-02, -5.59731e-03 },
-  { -4.89961e-03, 2.77794e-02, -9.49727e-02, 3.21004e-01, 8.51437e-01, -1.28068e-01, 3.30021e-02, -5.49804e-03 },
-  { -4.78866e-03, 2.71272e-02, -9.25834e-02, 3.10980e-01, 8.58189e-01, -1.26161e-01, 3.24205e-02, -5.39500e-03 },
-  { -4.67520e-03, 2.64621e-02, -9.01591e-02, 3.00980e-01, 8.64812e-01, -1.24154e-01, 3.18153e-02, -5.28823e-03 },
-  { -4.55932e-03, 2.57844e-02, -8.77011e-02, 2.91006e-01, 8.71305e-01, -1.22047e-01, 3.11866e-02, -5.17776e-03 },
-  { -4.44107e-03, 2.50946e-02, -8.52109e-02, 2.81060e-01, 8.77666e-01, -1.19837e-01, 3.05345e-02, -5.06363e-03 },
-  { -4.32052e-03, 2.43930e-02, -8.26900e-02, 2.71144e-01, 8.83893e-01, -1.17526e-01, 2.98593e-02, -4.94589e-03 },
-  { -4.19774e-03, 2.36801e-02, -8.01399e-02, 2.61263e-01, 8.89984e-01, -1.15113e-01, 2.91609e-02, -4.82456e-03 },
-  { -4.07279e-03, 2.29562e-02, -7.75620e-02, 2.51417e-01, 8.95936e-01, -1.12597e-01, 2.84397e-02, -4.69970e-03 },
-  { -3.94576e-03, 2.22218e-02, -7.49577e-02, 2.41609e-01, 9.01749e-01, -1.09978e-01, 2.76957e-02, -4.57135e-03 },
-  { -3.81671e-03, 2.14774e-02, -7.23286e-02, 2.31843e-01, 9.07420e-01, -1.07256e-01, 2.69293e-02, -4.43955e-03 },
-  { -3.68570e-03, 2.07233e-02, -6.96762e-02, 2.22120e-01, 9.12947e-01, -1.04430e-01, 2.61404e-02, -4.30435e-03 },
-  { -3.55283e-03, 1.99599e-02, -6.70018e-02, 2.12443e-01, 9.18329e-01, -1.01501e-01, 2.53295e-02, -4.16581e-03 },
-  { -3.41815e-03, 1.91877e-02, -6.43069e-02, 2.02814e-01, 9.23564e-01, -9.84679e-02, 2.44967e-02, -4.02397e-03 },
-  { -3.28174e-03, 1.84071e-02, -6.15931e-02, 1.93236e-01, 9.28650e-01, -9.53307e-02, 2.36423e-02, -3.87888e-03 },
-  { -3.14367e-03, 1.76185e-02, -5.88617e-02, 1.83711e-01, 9.33586e-01, -9.20893e-02, 2.27664e-02, -3.73062e-03 },
-  { -3.00403e-03, 1.68225e-02, -5.61142e-02, 1.74242e-01, 9.38371e-01, -8.87435e-02, 2.18695e-02, -3.57923e-03 },
-  { -2.86289e-03, 1.60193e-02, -5.33522e-02, 1.64831e-01, 9.43001e-01, -8.52933e-02, 2.09516e-02, -3.42477e-03 },
-  { -2.72032e-03, 1.52095e-02, -5.05770e-02, 1.55480e-01, 9.47477e-01, -8.17385e-02, 2.00132e-02, -3.26730e-03 },
-  { -2.57640e-03, 1.43934e-02, -4.77900e-02, 1.46192e-01, 9.51795e-01, -7.80792e-02, 1.90545e-02, -3.10689e-03 },
-  { -2.43121e-03, 1.35716e-02, -4.49929e-02, 1.36968e-01, 9.55956e-01, -7.43154e-02, 1.80759e-02, -2.94361e-03 },
-  { -2.28483e-03, 1.27445e-02, -4.21869e-02, 1.27812e-01, 9.59958e-01, -7.04471e-02, 1.70776e-02, -2.77751e-03 },
-  { -2.13733e-03, 1.19125e-02, -3.93735e-02, 1.18725e-01, 9.63798e-01, -6.64743e-02, 1.60599e-02, -2.60868e-03 },
-  { -1.98880e-03, 1.10760e-02, -3.65541e-02, 1.09710e-01, 9.67477e-01, -6.23972e-02, 1.50233e-02, -2.43718e-03 },
-  { -1.83931e-03, 1.02356e-02, -3.37303e-02, 1.00769e-01, 9.70992e-01, -5.82159e-02, 1.39681e-02, -2.26307e-03 },
-  { -1.68894e-03, 9.39154e-03, -3.09033e-02, 9.19033e-02, 9.74342e-01, -5.39305e-02, 1.28947e-02, -2.08645e-03 },
-  { -1.53777e-03, 8.54441e-03, -2.80746e-02, 8.31162e-02, 9.77526e-01, -4.95412e-02, 1.18034e-02, -1.90738e-03 },
-  { -1.38589e-03, 7.69462e-03, -2.52457e-02, 7.44095e-02, 9.80543e-01, -4.50483e-02, 1.06946e-02, -1.72594e-03 },
-  { -1.23337e-03, 6.84261e-03, -2.24178e-02, 6.57852e-02, 9.83392e-01, -4.04519e-02, 9.56876e-03, -1.54221e-03 },
-  { -1.08030e-03, 5.98883e-03, -1.95925e-02, 5.72454e-02, 9.86071e-01, -3.57525e-02, 8.42626e-03, -1.35627e-03 },
-  { -9.26747e-04, 5.13372e-03, -1.67710e-02, 4.87921e-02, 9.88580e-01, -3.09503e-02, 7.26755e-03, -1.16820e-03 },
-  { -7.72802e-04, 4.27773e-03, -1.39548e-02, 4.04274e-02, 9.90917e-01, -2.60456e-02, 6.09305e-03, -9.78093e-04 },
-  { -6.18544e-04, 3.42130e-03, -1.11453e-02, 3.21531e-02, 9.93082e-01, -2.10389e-02, 4.90322e-03, -7.86031e-04 },
-  { -4.64053e-04, 2.56486e-03, -8.34364e-03, 2.39714e-02, 9.95074e-01, -1.59305e-02, 3.69852e-03, -5.92100e-04 },
-  { -3.09412e-04, 1.70888e-03, -5.55134e-03, 1.58840e-02, 9.96891e-01, -1.07209e-02, 2.47942e-03, -3.96391e-04 },
-  { -1.54700e-04, 8.53777e-04, -2.76968e-03, 7.89295e-03, 9.98534e-01, -5.41054e-03, 1.24642e-03, -1.98993e-04 },
-  {  0.00000e+00, 0.00000e+00,  0.00000e+00, 0.00000e+00, 1.00000e+00,  0.00000e+00, 0.00000e+00,  0.00000e+00 },
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+#ifdef HAVE_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+#include <util/error.h>
+
+#include "mmse_taps.h"
+
+namespace {
+
+#ifdef __ARM_NEON
+
+struct Interpolator {
+  std::complex<float> operator()(
+      const std::complex<float>* s,
+      int step) const {
+    const float* taps = mmseTaps[step];
+    float32x4x2_t s0 = vld2q_f32((const float32_t*) &s[0]);
+    float32x4x2_t s1 = vld2q_f32((const float32_t*) &s[4]);
+    float32x4_t t0 = vld1q_f32(&taps[0]);
+    float32x4_t t1 = vld1q_f32(&taps[4]);
+    float32x4_t acci = vmlaq_f32(vmulq_f32(s0.val[0], t0), s1.val[0], t1);
+    float32x4_t accq = vmlaq_f32(vmulq_f32(s0.val[1], t0), s1.val[1], t1);
+
+    // Sum accumulators; lane 0 holds I, lane 1 holds Q
+    auto i = vpadd_f32(vget_low_f32(acci), vget_high_f32(acci));
+    auto q = vpadd_f32(vget_low_f32(accq), vget_high_f32(accq));
+    auto iq = vpadd_f32(i, q);
+    return std::complex<float>(vget_lane_f32(iq, 0), vget_lane_f32(iq, 1));
+  }
 };
 
+#else
+
+struct Interpolator {
+  std::complex<float> operator()(
+      const std::complex<float>* s,
+      int step) const {
+    std::complex<float> acc = 0.0f;
+    const auto taps = mmseTaps[step];
+    for (auto k = 0; k < NUM_TAPS; k++) {
+      acc += taps[k] * s[k];
+    }
+    return acc;
+  }
+};
+
+#endif
+
+#ifdef HAVE_X86_DISPATCH
+
+// Every interpolator tap twice, to line up with interleaved I/Q
+struct DuplicatedTaps {
+  DuplicatedTaps() {
+    for (auto i = 0; i <= NUM_STEPS; i++) {
+      for (auto k = 0; k < NUM_TAPS; k++) {
+        taps[i][2 * k + 0] = mmseTaps[i][k];
+        taps[i][2 * k + 1] = mmseTaps[i][k];
+      }
+    }
+  }
+
+  alignas(16) float taps[NUM_STEPS+1][2*NUM_TAPS];
+};
+
+const DuplicatedTaps dupTaps;
+
+struct InterpolatorSSE41 {
+  TARGET_SSE41 std::complex<float> operator()(
+      const std::complex<float>* s,
+      int step) const {
+    const float* f = (const float*) s;
+    const float* taps = dupTaps.taps[step];
+
+    // Every register holds 2 interleaved I/Q samples
+    __m128 acc0 = _mm_mul_ps(_mm_loadu_ps(&f[0]), _mm_load_ps(&taps[0]));
+    __m128 acc1 = _mm_mul_ps(_mm_loadu_ps(&f[4]), _mm_load_ps(&taps[4]));
+    acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(&f[8]), _mm_load_ps(&taps[8])));
+    acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(&f[12]), _mm_load_ps(&taps[12])));
+
+    // Sum accumulators; I ends up in lane 0, Q in lane 1
+    __m128 acc = _mm_add_ps(acc0, acc1);
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    std::complex<float> out;
+    _mm_storel_pi((__m64*) &out, acc);
+    return out;
+  }
+};
+
+#endif
+
+} // namespace
+
 ClockRecovery::ClockRecovery(uint32_t sampleRate, uint32_t symbolRate) {
   mu_ = 0.0f;
   omega_ = ((float) sampleRate / (float) symbolRate);
@@ -163,33 +124,18 @@ void ClockRecovery::setLoopBandwidth(float bw) {
   omegaGain_ = (4 * bw * bw) / (1.0 + 2.0 * damp * bw + bw * bw);
 }
 
-void ClockRecovery::work(
-    const std::shared_ptr<Queue<Samples> >& qin,
-    const std::shared_ptr<Queue<Samples> >& qout) {
-  auto input = qin->popForRead();
-  if (!input) {
-    qout->close();
-    return;
-  }
-
-  auto output = qout->popForWrite();
-  tmp_.insert(tmp_.end(), input->begin(), input->end());
-
-  // Return read buffer (it has been copied into tmp_)
-  qin->pushRead(std::move(input));
-
-  // Omega is number of samples per symbol, so this
-  // estimates the number of symbols we should find in this call.
-  auto nsamples = tmp_.size();
-  output->clear();
-  output->reserve(nsamples / omega_);
-
-  // Process 1 sample per iteration.
-  // This does not allow vectorization but is more stable than the
-  // vectorized implementation (see git history of this file).
-  // It is roughly 15% slower than previous implementation.
-  size_t i = 0;
-  while (i < nsamples) {
+template <class Interpolator>
+inline __attribute__((always_inline)) size_t ClockRecovery::loop(
+    const Interpolator& interpolate,
+    size_t i,
+    size_t limit,
+    size_t nsamples,
+    const std::complex<float>* fi,
+    std::complex<float>*& fo) {
+  // Process 1 symbol per iteration.
+  // The loop itself is inherently sequential (every symbol depends on
+  // the error of the previous one), but the interpolator is vectorized.
+  while (i < limit) {
     float muf;
     int mui;
     const std::complex<float>* s;
@@ -197,7 +143,7 @@ void ClockRecovery::work(
     // Populate phase and sample pointer
     muf = (float) mu_;
     mui = (int) mu_;
-    s = &tmp_[i + mui];
+    s = &fi[i + mui];
 
     // Check that we don't go out of range
     if ((i + mui + 7) >= nsamples) {
@@ -213,11 +159,7 @@ void ClockRecovery::work(
     muf = muf - (float) mui;
 
     // Run interpolator to get interpolated samples at offset mu
-    std::complex<float> acc = 0.0f;
-    const auto taps = mmseTaps[(int) (muf * 128.0f)];
-    for (auto k = 0; k < NUM_TAPS; k++) {
-      acc += taps[k] * s[k];
-    }
+    std::complex<float> acc = interpolate(s, (int) (muf * 128.0f));
 
     // Push down sample
     p2t_ = p1t_;
@@ -232,7 +174,7 @@ void ClockRecovery::work(
 
     // Use interpolated sample as output
     // Then use the estimated error to update omega_ and mu_
-    output->push_back(p0t_);
+    *fo++ = p0t_;
 
     // Compute error
     std::complex<float> x = (c0t_ - c2t_) * std::conj(p1t_);
@@ -263,9 +205,98 @@ void ClockRecovery::work(
     mu_ += omega_ + muGain_ * mm;
   }
 
-  // Index i was not used yet. Copy the sample at index i and
-  // everything after it to the beginning of the sample buffer.
-  tmp_.erase(tmp_.begin(), tmp_.begin() + i);
+  return i;
+}
+
+size_t ClockRecovery::loop(
+    size_t i,
+    size_t limit,
+    size_t nsamples,
+    const std::complex<float>* fi,
+    std::complex<float>*& fo) {
+#ifdef HAVE_X86_DISPATCH
+  // The interpolator has 8 taps, so wider vectors don't help
+  if (util::cpu::level() >= util::cpu::SSE41) {
+    return loopSSE41(i, limit, nsamples, fi, fo);
+  }
+#endif
+
+  return loop(Interpolator(), i, limit, nsamples, fi, fo);
+}
+
+#ifdef HAVE_X86_DISPATCH
+
+size_t ClockRecovery::loopSSE41(
+    size_t i,
+    size_t limit,
+    size_t nsamples,
+    const std::complex<float>* fi,
+    std::complex<float>*& fo) {
+  return loop(InterpolatorSSE41(), i, limit, nsamples, fi, fo);
+}
+
+#endif
+
+void ClockRecovery::work(
+    const std::shared_ptr<Queue<Samples> >& qin,
+    const std::shared_ptr<Queue<Samples> >& qout) {
+  auto input = qin->popForRead();
+  if (!input) {
+    qout->close();
+    return;
+  }
+
+  auto output = qout->popForWrite();
+  output->timestamp = input->timestamp;
+  timestamp_ = input->timestamp;
+  const auto nsamples = input->size();
+  const auto fi = input->data();
+
+  // Every symbol advances the sample index by at least the minimum
+  // value of mu, so this is an upper bound on the number of symbols
+  // we can find in this call.
+  const auto muMin = omegaMin_ - muGain_;
+  ASSERT(muMin > 0.0f);
+  output->resize((size_t) ((carry_.size() + nsamples + 1) / muMin) + 1);
+  auto fo = output->data();
+
+  // Samples that were not used in the previous call are combined
+  // with the head of the input in a small staging buffer. This runs
+  // the loop until it advances into the input, after which it can
+  // continue on the input directly. Mu never exceeds omega + 1 +
+  // muGain, so the head only needs to cover the interpolator window
+  // at that offset.
+  size_t i = 0;
+  bool done = false;
+  if (!carry_.empty()) {
+    const auto ncarry = carry_.size();
+    const auto nhead = std::min(nsamples, (size_t) (omegaMax_ + muGain_) + 10);
+    staging_.assign(carry_.begin(), carry_.end());
+    staging_.insert(staging_.end(), fi, fi + nhead);
+    i = loop(0, ncarry, staging_.size(), staging_.data(), fo);
+    if (i < ncarry) {
+      // Ran out of samples before reaching the input
+      ASSERT(nhead == nsamples);
+      carry_.assign(staging_.begin() + i, staging_.end());
+      done = true;
+    } else {
+      i -= ncarry;
+    }
+  }
+
+  if (!done) {
+    i = loop(i, nsamples, nsamples, fi, fo);
+
+    // Index i was not used yet. Keep the sample at index i and
+    // everything after it around for the next call.
+    carry_.assign(fi + i, fi + nsamples);
+  }
+
+  // Return read buffer
+  qin->pushRead(std::move(input));
+
+  // Trim output to the number of symbols found
+  output->resize(fo - output->data());
 
   // Publish output if applicable
   if (samplePublisher_) {
@@ -2,6 +2,8 @@
 
 #include <memory>
 
+#include <util/cpu.h>
+
 #include "sample_publisher.h"
 #include "types.h"
 
@@ -21,11 +23,43 @@ public:
     return omega_;
   }
 
+  const Timestamp& getTimestamp() const {
+    return timestamp_;
+  }
+
   void work(
       const std::shared_ptr<Queue<Samples> >& qin,
       const std::shared_ptr<Queue<Samples> >& qout);
 
 protected:
+  // Runs the loop over samples [i, nsamples) of fi, for as long as
+  // the interpolator window fits and i < limit. Writes symbols to fo
+  // and advances it. Returns the index of the first unused sample.
+  size_t loop(
+      size_t i,
+      size_t limit,
+      size_t nsamples,
+      const std::complex<float>* fi,
+      std::complex<float>*& fo);
+
+  template <class Interpolator>
+  size_t loop(
+      const Interpolator& interpolate,
+      size_t i,
+      size_t limit,
+      size_t nsamples,
+      const std::complex<float>* fi,
+      std::complex<float>*& fo);
+
+#ifdef HAVE_X86_DISPATCH
+  TARGET_SSE41 size_t loopSSE41(
+      size_t i,
+      size_t limit,
+      size_t nsamples,
+      const std::complex<float>* fi,
+      std::complex<float>*& fo);
+#endif
+
   float omega_;
   float omegaMin_;
   float omegaMax_;
@@ -43,7 +77,14 @@ protected:
   std::complex<float> c1t_;
   std::complex<float> c2t_;
 
-  Samples tmp_;
+  // Samples of the previous call that were not used yet
+  Samples carry_;
+
+  // Carried samples followed by head of the current input
+  Samples staging_;
 
   std::unique_ptr<SamplePublisher> samplePublisher_;
+
+  // Of the most recent input block
+  Timestamp timestamp_;
 };
@@ -1,5 +1,6 @@
 #include "config.h"
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
@@ -21,6 +22,28 @@ void setIfZero(T& out, T value) {
   }
 }
 
+OverflowPolicy parseOverflowPolicy(const std::string& key, const toml::Value& v) {
+  const auto& policy = v.as<std::string>();
+  if (policy == "block") {
+    return OverflowPolicy::BLOCK;
+  }
+  if (policy == "drop_oldest") {
+#ifdef USE_LOCK_FREE_QUEUE
+    // See LockFreeQueue
+    throw std::invalid_argument(
+      "'" + key + "' can't be \"drop_oldest\" when goesrecv is built "
+      "with lock-free queues; use \"drop_newest\" instead");
+#else
+    return OverflowPolicy::DROP_OLDEST;
+#endif
+  }
+  if (policy == "drop_newest") {
+    return OverflowPolicy::DROP_NEWEST;
+  }
+  throw std::invalid_argument(
+    "Expected '" + key + "' to be \"block\", \"drop_oldest\", or \"drop_newest\"");
+}
+
 std::unique_ptr<SamplePublisher> createSamplePublisher(const toml::Value& v) {
   auto bind = v.find("bind");
   if (!bind) {
@@ -36,6 +59,22 @@ std::unique_ptr<SamplePublisher> createSamplePublisher(const toml::Value& v) {
     p->setSendBuffer(sendBuffer->as<int>());
   }
 
+  // Optional rate limits
+  auto decimation = v.find("decimation");
+  if (decimation) {
+    if (decimation->as<int>() < 1) {
+      throw std::invalid_argument("Expected 'decimation' to be positive");
+    }
+    p->setDecimation(decimation->as<int>());
+  }
+  auto interval = v.find("interval_ms");
+  if (interval) {
+    if (interval->as<int>() < 0) {
+      throw std::invalid_argument("Expected 'interval_ms' to be non-negative");
+    }
+    p->setInterval(std::chrono::milliseconds(interval->as<int>()));
+  }
+
   return p;
 }
 
@@ -119,6 +158,37 @@ void loadDemodulator(Config::Demodulator& out, const toml::Value& v) {
       continue;
     }
 
+    if (key == "pipeline") {
+      out.pipeline = value.as<bool>();
+      continue;
+    }
+
+    if (key == "source_queue_depth") {
+      out.sourceQueueDepth = value.as<int>();
+      if (out.sourceQueueDepth <= 0) {
+        throw std::invalid_argument("Expected 'source_queue_depth' to be positive");
+      }
+      continue;
+    }
+
+    if (key == "queue_depth") {
+      out.queueDepth = value.as<int>();
+      if (out.queueDepth <= 0) {
+        throw std::invalid_argument("Expected 'queue_depth' to be positive");
+      }
+      continue;
+    }
+
+    if (key == "source_queue_overflow") {
+      out.sourceQueueOverflow = parseOverflowPolicy(key, value);
+      continue;
+    }
+
+    if (key == "queue_overflow") {
+      out.queueOverflow = parseOverflowPolicy(key, value);
+      continue;
+    }
+
     throwInvalidKey(key);
   }
 }
@@ -234,6 +304,94 @@ void loadNanomsgSource(Config::Nanomsg& out, const toml::Value& v) {
   }
 }
 
+void loadFileSource(Config::File& out, const toml::Value& v) {
+  const auto& table = v.as<toml::Table>();
+  for (const auto& it : table) {
+    const auto& key = it.first;
+    const auto& value = it.second;
+
+    if (key == "path") {
+      out.path = value.as<std::string>();
+      continue;
+    }
+
+    if (key == "format") {
+      out.format = value.as<std::string>();
+      continue;
+    }
+
+    if (key == "sample_rate") {
+      out.sampleRate = value.as<int>();
+      continue;
+    }
+
+    if (key == "speed") {
+      out.speed = (float) value.as<double>();
+      if (out.speed < 0.0f) {
+        throw std::invalid_argument("Expected 'speed' to be non-negative");
+      }
+      continue;
+    }
+
+    if (key == "block_size") {
+      out.blockSize = value.as<int>();
+      if (out.blockSize < 4) {
+        throw std::invalid_argument("Expected 'block_size' to be at least 4");
+      }
+      continue;
+    }
+
+    if (key == "sample_publisher") {
+      out.samplePublisher = createSamplePublisher(value);
+      continue;
+    }
+
+    throwInvalidKey(key);
+  }
+
+  if (out.path.empty()) {
+    std::stringstream ss;
+    ss << "Key not set: path";
+    throw std::invalid_argument(ss.str());
+  }
+}
+
+void loadFrontEnd(Config::FrontEnd& out, const toml::Value& v) {
+  const auto& table = v.as<toml::Table>();
+  for (const auto& it : table) {
+    const auto& key = it.first;
+    const auto& value = it.second;
+
+    if (key == "decimation") {
+      out.decimation = value.as<int>();
+      if (out.decimation <= 0) {
+        throw std::invalid_argument("Expected 'decimation' to be positive");
+      }
+      continue;
+    }
+
+    if (key == "frequency_offset") {
+      out.frequencyOffset = (float) value.as<double>();
+      continue;
+    }
+
+    if (key == "taps") {
+      out.taps = value.as<int>();
+      if (out.taps < 0) {
+        throw std::invalid_argument("Expected 'taps' to be non-negative");
+      }
+      continue;
+    }
+
+    if (key == "sample_publisher") {
+      out.samplePublisher = createSamplePublisher(value);
+      continue;
+    }
+
+    throwInvalidKey(key);
+  }
+}
+
 void loadAGC(Config::AGC& out, const toml::Value& v) {
   const auto& table = v.as<toml::Table>();
   for (const auto& it : table) {
@@ -288,6 +446,22 @@ void loadRRC(Config::RRC& out, const toml::Value& v) {
     const auto& key = it.first;
     const auto& value = it.second;
 
+    if (key == "taps") {
+      out.taps = value.as<int>();
+      if (out.taps <= 0) {
+        throw std::invalid_argument("Expected 'taps' to be positive");
+      }
+      continue;
+    }
+
+    if (key == "roll_off") {
+      out.rollOff = (float) value.as<double>();
+      if (out.rollOff <= 0.0f || out.rollOff > 1.0f) {
+        throw std::invalid_argument("Expected 'roll_off' to be in (0, 1]");
+      }
+      continue;
+    }
+
     if (key == "sample_publisher") {
       out.samplePublisher = createSamplePublisher(value);
       continue;
@@ -333,6 +507,30 @@ void loadDecoder(Config::Decoder& out, const toml::Value& v) {
     const auto& key = it.first;
     const auto& value = it.second;
 
+    if (key == "workers") {
+      out.workers = value.as<int>();
+      if (out.workers < 0) {
+        throw std::invalid_argument("Expected 'workers' to be non-negative");
+      }
+      continue;
+    }
+
+    if (key == "viterbi_error_interval") {
+      out.viterbiErrorInterval = value.as<int>();
+      if (out.viterbiErrorInterval < 0) {
+        throw std::invalid_argument("Expected 'viterbi_error_interval' to be non-negative");
+      }
+      continue;
+    }
+
+    if (key == "reed_solomon_erasures") {
+      out.reedSolomonErasures = value.as<int>();
+      if (out.reedSolomonErasures < 0 || out.reedSolomonErasures > 24) {
+        throw std::invalid_argument("Expected 'reed_solomon_erasures' to be between 0 and 24");
+      }
+      continue;
+    }
+
     if (key == "packet_publisher") {
       out.packetPublisher = createPacketPublisher(value);
       continue;
@@ -358,10 +556,167 @@ void loadMonitor(Config::Monitor& out, const toml::Value& v) {
       continue;
     }
 
+    if (key == "metrics_address") {
+      out.metricsAddress = value.as<std::string>();
+      continue;
+    }
+
+    throwInvalidKey(key);
+  }
+}
+
+void loadThread(Config::Thread& out, const toml::Value& v) {
+  const auto& table = v.as<toml::Table>();
+  for (const auto& it : table) {
+    const auto& key = it.first;
+    const auto& value = it.second;
+
+    // Either a single CPU or an array of CPUs
+    if (key == "cpu") {
+      out.cpus.clear();
+      if (value.is<toml::Array>()) {
+        for (const auto& cpu : value.as<toml::Array>()) {
+          out.cpus.push_back(cpu.as<int>());
+        }
+      } else {
+        out.cpus.push_back(value.as<int>());
+      }
+      for (const auto cpu : out.cpus) {
+        if (cpu < 0) {
+          throw std::invalid_argument("Expected 'cpu' to be non-negative");
+        }
+      }
+      continue;
+    }
+
+    if (key == "priority") {
+      out.priority = value.as<int>();
+      if (out.priority < 0 || out.priority > 99) {
+        throw std::invalid_argument("Expected 'priority' to be between 0 and 99");
+      }
+      continue;
+    }
+
+    throwInvalidKey(key);
+  }
+}
+
+void loadThreads(std::map<std::string, Config::Thread>& out, const toml::Value& v) {
+  const std::vector<std::string> names = {
+    "demodulator",
+    "agc",
+    "costas",
+    "rrc",
+    "clock_recovery",
+    "quantization",
+    "front_end",
+    "decoder",
+    "decoder_publish",
+    "airspy",
+    "rtlsdr",
+    "nanomsg",
+    "file",
+  };
+
+  const auto& table = v.as<toml::Table>();
+  for (const auto& it : table) {
+    const auto& key = it.first;
+    const auto& value = it.second;
+
+    // Decoder workers are named "decoder_0", "decoder_1", etc.
+    const auto worker =
+      key.compare(0, 8, "decoder_") == 0 &&
+      key.size() > 8 &&
+      key.find_first_not_of("0123456789", 8) == std::string::npos;
+    if (!worker && std::find(names.begin(), names.end(), key) == names.end()) {
+      throwInvalidKey("threads." + key);
+    }
+
+    loadThread(out[key], value);
+  }
+}
+
+void loadMemory(Config::Memory& out, const toml::Value& v) {
+  const auto& table = v.as<toml::Table>();
+  for (const auto& it : table) {
+    const auto& key = it.first;
+    const auto& value = it.second;
+
+    if (key == "lock") {
+      out.lock = value.as<bool>();
+      continue;
+    }
+
     throwInvalidKey(key);
   }
 }
 
+void loadChannel(Config& out, const toml::Value& v) {
+  const auto& table = v.as<toml::Table>();
+  for (const auto& it : table) {
+    const auto& key = it.first;
+    const auto& value = it.second;
+
+    if (key == "mode") {
+      out.demodulator.downlinkType = value.as<std::string>();
+      continue;
+    }
+
+    if (key == "demodulator") {
+      loadDemodulator(out.demodulator, value);
+      continue;
+    }
+
+    if (key == "front_end") {
+      loadFrontEnd(out.frontEnd, value);
+      continue;
+    }
+
+    if (key == "agc") {
+      loadAGC(out.agc, value);
+      continue;
+    }
+
+    if (key == "costas") {
+      loadCostas(out.costas, value);
+      continue;
+    }
+
+    if (key == "rrc") {
+      loadRRC(out.rrc, value);
+      continue;
+    }
+
+    if (key == "clock_recovery") {
+      loadClockRecovery(out.clockRecovery, value);
+      continue;
+    }
+
+    if (key == "quantization") {
+      loadQuantization(out.quantization, value);
+      continue;
+    }
+
+    if (key == "decoder") {
+      loadDecoder(out.decoder, value);
+      continue;
+    }
+
+    if (key == "threads") {
+      loadThreads(out.threads, value);
+      continue;
+    }
+
+    throwInvalidKey("channels." + key);
+  }
+
+  if (out.demodulator.downlinkType.empty()) {
+    std::stringstream ss;
+    ss << "Key not set: channels.mode";
+    throw std::invalid_argument(ss.str());
+  }
+}
+
 } // namespace
 
 Config Config::load(const std::string& file) {
@@ -397,6 +752,16 @@ Config Config::load(const std::string& file) {
       continue;
     }
 
+    if (key == "file") {
+      loadFileSource(out.file, value);
+      continue;
+    }
+
+    if (key == "front_end") {
+      loadFrontEnd(out.frontEnd, value);
+      continue;
+    }
+
     if (key == "agc") {
       loadAGC(out.agc, value);
       continue;
@@ -432,15 +797,26 @@ Config Config::load(const std::string& file) {
       continue;
     }
 
-    throwInvalidKey(key);
-  }
+    if (key == "threads") {
+      loadThreads(out.threads, value);
+      continue;
+    }
+
+    if (key == "memory") {
+      loadMemory(out.memory, value);
+      continue;
+    }
 
-  const auto demodulatorStatsEndpoint = "inproc://demodulator_stats";
-  const auto decoderStatsEndpoint = "inproc://decoder_stats";
+    if (key == "channels") {
+      for (const auto& channel : value.as<toml::Array>()) {
+        out.channels.push_back(std::make_unique<Config>());
+        loadChannel(*out.channels.back(), channel);
+      }
+      continue;
+    }
 
-  // Add inproc endpoints for the stats publishers
-  out.demodulator.statsPublisher.bind.push_back(demodulatorStatsEndpoint);
-  out.decoder.statsPublisher.bind.push_back(decoderStatsEndpoint);
+    throwInvalidKey(key);
+  }
 
   // If the mode field is used, we can populate sane defaults
   if (out.demodulator.downlinkType == "lrit") {
@@ -1,16 +1,17 @@
 #pragma once
 
+#include <map>
 #include <memory>
 #include <string>
 
 #include "packet_publisher.h"
+#include "queue_stats.h"
 #include "sample_publisher.h"
 #include "soft_bit_publisher.h"
 
 struct Config {
   struct StatsPublisher {
-    // Addresses to bind to. This is a vector because we always add an
-    // inproc:// endpoint for the in-process monitoring code.
+    // Addresses to bind to (none if stats are not published)
     std::vector<std::string> bind;
 
     // Optional send buffer size
@@ -29,6 +30,19 @@ struct Config {
 
     // Signal decimation (applied at FIR stage)
     int decimation = 1;
+
+    // Run every DSP stage in its own thread instead of running
+    // all of them in sequence in a single thread
+    bool pipeline = false;
+
+    // Number of sample blocks that can be buffered between the
+    // source and the first stage, and between subsequent stages
+    int sourceQueueDepth = 4;
+    int queueDepth = 2;
+
+    // What the producer of these queues does when they are full
+    OverflowPolicy sourceQueueOverflow = OverflowPolicy::BLOCK;
+    OverflowPolicy queueOverflow = OverflowPolicy::BLOCK;
   };
 
   Demodulator demodulator;
@@ -80,6 +94,44 @@ struct Config {
 
   Nanomsg nanomsg;
 
+  struct File {
+    // Path to recording
+    std::string path;
+
+    // Sample format ("cu8", "cs8", "cs16", or "cf32") and sample rate.
+    // Required for raw recordings; WAV and SigMF recordings include
+    // them, but they can be overridden here.
+    std::string format;
+    uint32_t sampleRate = 0;
+
+    // Replay speed relative to real time (if zero, samples are
+    // produced as fast as the demodulator consumes them)
+    float speed = 0.0f;
+
+    // Number of samples per block
+    int blockSize = 64 * 1024;
+
+    std::unique_ptr<SamplePublisher> samplePublisher;
+  };
+
+  File file;
+
+  struct FrontEnd {
+    // Decimation before the AGC and Costas loop.
+    // If 1, the front end stage is not used.
+    int decimation = 1;
+
+    // Frequency offset of the signal in Hz (shifted to 0 Hz)
+    float frequencyOffset = 0.0f;
+
+    // Number of filter taps (if zero, derived from the decimation)
+    int taps = 0;
+
+    std::unique_ptr<SamplePublisher> samplePublisher;
+  };
+
+  FrontEnd frontEnd;
+
   struct AGC {
     // Minimum gain
     float min = 1e-6f;
@@ -102,6 +154,12 @@ struct Config {
   Costas costas;
 
   struct RRC {
+    // Number of filter taps
+    int taps = 31;
+
+    // Roll-off factor (excess bandwidth) of the pulse shape
+    float rollOff = 0.5f;
+
     std::unique_ptr<SamplePublisher> samplePublisher;
   };
 
@@ -120,6 +178,19 @@ struct Config {
   Quantization quantization;
 
   struct Decoder {
+    // Number of threads that run Viterbi and Reed-Solomon decoding.
+    // If zero, frames are cut and decoded on a single thread.
+    int workers = 0;
+
+    // Count the number of bits corrected by the Viterbi decoder
+    // for every Nth packet only. If zero, they are never counted.
+    int viterbiErrorInterval = 1;
+
+    // Maximum number of unreliable bytes per Reed-Solomon codeword
+    // to mark as erasures when a frame cannot be corrected otherwise.
+    // If zero, frames are only corrected without erasures.
+    int reedSolomonErasures = 0;
+
     std::unique_ptr<PacketPublisher> packetPublisher;
 
     // Decoder statistics (Viterbi, Reed-Solomon, etc.)
@@ -131,9 +202,37 @@ struct Config {
   struct Monitor {
     // Address to send UDP statsd packets to (e.g. localhost:8125)
     std::string statsdAddress;
+
+    // Address to serve metrics on over HTTP (e.g. 127.0.0.1:6003)
+    std::string metricsAddress;
   };
 
   Monitor monitor;
 
+  struct Thread {
+    // CPUs to pin thread to (empty means no affinity)
+    std::vector<int> cpus;
+
+    // SCHED_FIFO priority (1-99; 0 means default scheduling)
+    int priority = 0;
+  };
+
+  // Thread settings keyed by thread name (e.g. "agc" or "decoder")
+  std::map<std::string, Thread> threads;
+
+  struct Memory {
+    // Lock all current and future memory of the process in RAM
+    // (mlockall), so that no thread waits for a page fault
+    bool lock = false;
+  };
+
+  Memory memory;
+
+  // Additional downlinks to demodulate from the same source. Every
+  // channel has its own front end, demodulator, and decoder, with
+  // their own publishers. Only the sections that configure these
+  // are used; the source and monitor are shared.
+  std::vector<std::unique_ptr<Config> > channels;
+
   static Config load(const std::string& file);
 };
@@ -0,0 +1,301 @@
+#include "convert.h"
+
+#include <cmath>
+#include <cstring>
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+#ifdef HAVE_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Number to subtract from unsigned 8 bit samples for normalization
+// See http://cgit.osmocom.org/gr-osmosdr/tree/lib/rtl/rtl_source_c.cc#n176
+constexpr float cu8Norm = 127.4f / 128.0f;
+
+// The conversion functions below take the number of floats or
+// integers (two per sample) and return the number they converted.
+// Vectorized versions leave the remainder for the generic version.
+
+size_t cu8ToFloat(size_t n, const uint8_t* in, float* out) {
+  for (size_t i = 0; i < n; i++) {
+    out[i] = (in[i] / 128.0f) - cu8Norm;
+  }
+  return n;
+}
+
+size_t cs8ToFloat(size_t n, const int8_t* in, float* out) {
+  for (size_t i = 0; i < n; i++) {
+    out[i] = (float) in[i] / 127.0f;
+  }
+  return n;
+}
+
+size_t cs16ToFloat(size_t n, const int16_t* in, float* out) {
+  for (size_t i = 0; i < n; i++) {
+    out[i] = (float) in[i] * (1.0f / 32768.0f);
+  }
+  return n;
+}
+
+size_t floatToInt8(size_t n, const float* in, int8_t* out) {
+  for (size_t i = 0; i < n; i++) {
+    auto v = in[i] * 127;
+
+    // Clamp
+    v = (0.5f * (fabsf(v + 127.0f) - fabsf(v - 127.0f)));
+
+    // Convert to int8_t
+    out[i] = (int8_t) v;
+  }
+  return n;
+}
+
+#ifdef __ARM_NEON
+
+size_t cu8ToFloatNEON(size_t n, const uint8_t* in, float* out) {
+  const float32x4_t norm = vdupq_n_f32(cu8Norm);
+  size_t i = 0;
+
+  // Iterate over 8 values at a time
+  for (; i + 8 <= n; i += 8) {
+    uint16x8_t u = vmovl_u8(vld1_u8(&in[i]));
+
+    // Convert to float32x4 and divide by 2^7 (128)
+    float32x4_t f0 = vcvtq_n_f32_u32(vmovl_u16(vget_low_u16(u)), 7);
+    float32x4_t f1 = vcvtq_n_f32_u32(vmovl_u16(vget_high_u16(u)), 7);
+
+    // Subtract to normalize to [-1.0, 1.0]
+    vst1q_f32(&out[i + 0], vsubq_f32(f0, norm));
+    vst1q_f32(&out[i + 4], vsubq_f32(f1, norm));
+  }
+
+  return i;
+}
+
+#endif
+
+#ifdef HAVE_X86_DISPATCH
+
+TARGET_SSE41 size_t cu8ToFloatSSE41(size_t n, const uint8_t* in, float* out) {
+  const __m128 scale = _mm_set1_ps(1.0f / 128.0f);
+  const __m128 norm = _mm_set1_ps(cu8Norm);
+  size_t i = 0;
+
+  // Scaling by a power of two is exact, so the result is
+  // identical to the division in the generic version.
+  for (; i + 4 <= n; i += 4) {
+    int32_t v;
+    memcpy(&v, &in[i], sizeof(v));
+    __m128i vi = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(v));
+    __m128 f = _mm_mul_ps(_mm_cvtepi32_ps(vi), scale);
+    _mm_storeu_ps(&out[i], _mm_sub_ps(f, norm));
+  }
+
+  return i;
+}
+
+TARGET_SSE41 size_t cs8ToFloatSSE41(size_t n, const int8_t* in, float* out) {
+  const __m128 norm = _mm_set1_ps(127.0f);
+  size_t i = 0;
+
+  // Use a division instead of multiplying by the reciprocal so that
+  // the result is identical to the generic version.
+  for (; i + 4 <= n; i += 4) {
+    int32_t v;
+    memcpy(&v, &in[i], sizeof(v));
+    __m128i vi = _mm_cvtepi8_epi32(_mm_cvtsi32_si128(v));
+    _mm_storeu_ps(&out[i], _mm_div_ps(_mm_cvtepi32_ps(vi), norm));
+  }
+
+  return i;
+}
+
+TARGET_SSE41 size_t cs16ToFloatSSE41(size_t n, const int16_t* in, float* out) {
+  const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+  size_t i = 0;
+
+  for (; i + 4 <= n; i += 4) {
+    __m128i v = _mm_loadl_epi64((const __m128i*) &in[i]);
+    __m128i vi = _mm_cvtepi16_epi32(v);
+    _mm_storeu_ps(&out[i], _mm_mul_ps(_mm_cvtepi32_ps(vi), scale));
+  }
+
+  return i;
+}
+
+TARGET_SSE41 size_t floatToInt8SSE41(size_t n, const float* in, int8_t* out) {
+  const __m128 scale = _mm_set1_ps(127.0f);
+  const __m128 min = _mm_set1_ps(-127.0f);
+  const __m128 max = _mm_set1_ps(+127.0f);
+  size_t i = 0;
+
+  // Clamping before the (truncating) conversion
+  // gives the same result as the generic version.
+  for (; i + 16 <= n; i += 16) {
+    __m128i v[4];
+    for (size_t j = 0; j < 4; j++) {
+      __m128 f = _mm_mul_ps(_mm_loadu_ps(&in[i + 4 * j]), scale);
+      f = _mm_min_ps(_mm_max_ps(f, min), max);
+      v[j] = _mm_cvttps_epi32(f);
+    }
+    __m128i v01 = _mm_packs_epi32(v[0], v[1]);
+    __m128i v23 = _mm_packs_epi32(v[2], v[3]);
+    _mm_storeu_si128((__m128i*) &out[i], _mm_packs_epi16(v01, v23));
+  }
+
+  return i;
+}
+
+TARGET_AVX2 size_t cu8ToFloatAVX2(size_t n, const uint8_t* in, float* out) {
+  const __m256 scale = _mm256_set1_ps(1.0f / 128.0f);
+  const __m256 norm = _mm256_set1_ps(cu8Norm);
+  size_t i = 0;
+
+  for (; i + 8 <= n; i += 8) {
+    __m128i v = _mm_loadl_epi64((const __m128i*) &in[i]);
+    __m256 f = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(v)), scale);
+    _mm256_storeu_ps(&out[i], _mm256_sub_ps(f, norm));
+  }
+
+  return i;
+}
+
+TARGET_AVX2 size_t cs8ToFloatAVX2(size_t n, const int8_t* in, float* out) {
+  const __m256 norm = _mm256_set1_ps(127.0f);
+  size_t i = 0;
+
+  for (; i + 8 <= n; i += 8) {
+    __m128i v = _mm_loadl_epi64((const __m128i*) &in[i]);
+    __m256i vi = _mm256_cvtepi8_epi32(v);
+    _mm256_storeu_ps(&out[i], _mm256_div_ps(_mm256_cvtepi32_ps(vi), norm));
+  }
+
+  return i;
+}
+
+TARGET_AVX2 size_t cs16ToFloatAVX2(size_t n, const int16_t* in, float* out) {
+  const __m256 scale = _mm256_set1_ps(1.0f / 32768.0f);
+  size_t i = 0;
+
+  for (; i + 8 <= n; i += 8) {
+    __m128i v = _mm_loadu_si128((const __m128i*) &in[i]);
+    __m256i vi = _mm256_cvtepi16_epi32(v);
+    _mm256_storeu_ps(&out[i], _mm256_mul_ps(_mm256_cvtepi32_ps(vi), scale));
+  }
+
+  return i;
+}
+
+#endif
+
+} // namespace
+
+void toFloat(
+    const RawSamples& in,
+    size_t offset,
+    size_t nsamples,
+    std::complex<float>* out) {
+  const size_t n = 2 * nsamples;
+  float* fo = (float*) out;
+  size_t i = 0;
+
+  switch (in.format) {
+  case RawSamples::CU8: {
+    const uint8_t* fi = in.as<uint8_t>() + 2 * offset;
+#ifdef __ARM_NEON
+    i = cu8ToFloatNEON(n, fi, fo);
+#endif
+#ifdef HAVE_X86_DISPATCH
+    if (util::cpu::level() >= util::cpu::AVX2) {
+      i = cu8ToFloatAVX2(n, fi, fo);
+    } else if (util::cpu::level() >= util::cpu::SSE41) {
+      i = cu8ToFloatSSE41(n, fi, fo);
+    }
+#endif
+    cu8ToFloat(n - i, fi + i, fo + i);
+    break;
+  }
+  case RawSamples::CS8: {
+    const int8_t* fi = in.as<int8_t>() + 2 * offset;
+#ifdef HAVE_X86_DISPATCH
+    if (util::cpu::level() >= util::cpu::AVX2) {
+      i = cs8ToFloatAVX2(n, fi, fo);
+    } else if (util::cpu::level() >= util::cpu::SSE41) {
+      i = cs8ToFloatSSE41(n, fi, fo);
+    }
+#endif
+    cs8ToFloat(n - i, fi + i, fo + i);
+    break;
+  }
+  case RawSamples::CS16: {
+    const int16_t* fi = in.as<int16_t>() + 2 * offset;
+#ifdef HAVE_X86_DISPATCH
+    if (util::cpu::level() >= util::cpu::AVX2) {
+      i = cs16ToFloatAVX2(n, fi, fo);
+    } else if (util::cpu::level() >= util::cpu::SSE41) {
+      i = cs16ToFloatSSE41(n, fi, fo);
+    }
+#endif
+    cs16ToFloat(n - i, fi + i, fo + i);
+    break;
+  }
+  case RawSamples::CF32: {
+    const float* fi = in.as<float>() + 2 * offset;
+    memcpy(fo, fi, n * sizeof(float));
+    break;
+  }
+  }
+}
+
+void toInt8(
+    size_t nsamples,
+    const std::complex<float>* in,
+    std::complex<int8_t>* out) {
+  const size_t n = 2 * nsamples;
+  const float* fi = (const float*) in;
+  int8_t* fo = (int8_t*) out;
+  size_t i = 0;
+
+#ifdef HAVE_X86_DISPATCH
+  if (util::cpu::level() >= util::cpu::SSE41) {
+    i = floatToInt8SSE41(n, fi, fo);
+  }
+#endif
+  floatToInt8(n - i, fi + i, fo + i);
+}
+
+void toInt8(
+    const RawSamples& in,
+    std::complex<int8_t>* out) {
+  const size_t n = 2 * in.size();
+  int8_t* fo = (int8_t*) out;
+
+  switch (in.format) {
+  case RawSamples::CU8: {
+    // Flip the sign bit to subtract 128
+    const uint8_t* fi = in.as<uint8_t>();
+    for (size_t i = 0; i < n; i++) {
+      fo[i] = (int8_t) (fi[i] ^ 0x80);
+    }
+    break;
+  }
+  case RawSamples::CS8:
+    memcpy(fo, in.as<int8_t>(), n);
+    break;
+  case RawSamples::CS16: {
+    const int16_t* fi = in.as<int16_t>();
+    for (size_t i = 0; i < n; i++) {
+      fo[i] = (int8_t) (fi[i] >> 8);
+    }
+    break;
+  }
+  case RawSamples::CF32:
+    toInt8(in.size(), in.as<std::complex<float> >(), out);
+    break;
+  }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <complex>
+#include <cstdint>
+
+#include <util/cpu.h>
+
+#include "types.h"
+
+// Conversions between the sample formats that sources produce,
+// the float samples that the DSP stages work on, and the 8 bit
+// samples that the sample publishers send.
+
+// Converts nsamples samples of a raw block, starting at sample
+// offset, to float. Fixed point samples are scaled to [-1, 1].
+void toFloat(
+    const RawSamples& in,
+    size_t offset,
+    size_t nsamples,
+    std::complex<float>* out);
+
+// Converts float samples to 8 bit. Samples are scaled by 127,
+// clamped to [-127, 127], and rounded towards zero.
+void toInt8(
+    size_t nsamples,
+    const std::complex<float>* in,
+    std::complex<int8_t>* out);
+
+// Converts a raw block to 8 bit. For fixed point samples this only
+// drops the least significant bits (and the DC offset of CU8).
+void toInt8(
+    const RawSamples& in,
+    std::complex<int8_t>* out);
@@ -5,7 +5,11 @@
 #include <util/error.h>
 
 #ifdef __ARM_NEON
-#include "./neon/neon_mathfun.h"
+#include <arm_neon.h>
+#endif
+
+#ifdef HAVE_X86_DISPATCH
+#include <immintrin.h>
 #endif
 
 #define M_2PI (2 * M_PI)
@@ -20,6 +24,22 @@ Costas::Costas() {
   maxDeviation_ = M_2PI;
 }
 
+void Costas::update(float terr) {
+  // Update frequency and phase
+  freq_ += beta_ * terr;
+  phase_ += alpha_ * terr + freq_;
+
+  // Clamp frequency
+  freq_ = (0.5f * (fabsf(freq_ + maxDeviation_) -
+                   fabsf(freq_ - maxDeviation_)));
+
+  // Wrap phase if needed
+  if (phase_ > M_2PI || phase_ < -M_2PI) {
+    float frac = phase_ * (1.0 / M_2PI);
+    phase_ = (frac - (float)((int)frac)) * M_2PI;
+  }
+}
+
 #ifdef __ARM_NEON
 
 void Costas::work(
@@ -35,17 +55,12 @@ void Costas::work(
   float32x4_t half = vld1q_dup_f32(&half_);
 
   for (size_t i = 0; i < nsamples; i += 4) {
-    float32x4_t phase = {
-      -(phase_ + 0 * freq_),
-      -(phase_ + 1 * freq_),
-      -(phase_ + 2 * freq_),
-      -(phase_ + 3 * freq_),
-    };
-
     // Compute sin/cos for phase offset
-    float32x4_t sin;
-    float32x4_t cos;
-    sincos_ps(phase, &sin, &cos);
+    float c[4];
+    float s[4];
+    nco_.sincos(-phase_, -freq_, 4, c, s);
+    float32x4_t cos = { c[0], c[1], c[2], c[3] };
+    float32x4_t sin = { s[0], s[1], s[2], s[3] };
 
     // Load 4 samples into 2 registers (in-phase and quadrature)
     float32x4x2_t f = vld2q_f32((const float32_t*) &fi[i]);
@@ -74,19 +89,7 @@ void Costas::work(
     err = vmulq_f32(half, vsubq_f32(err_pos1, err_neg1));
     float terr = (err[0] + err[1] + err[2] + err[3]) / 4.0f;
 
-    // Update frequency and phase
-    freq_ += beta_ * terr;
-    phase_ += alpha_ * terr + freq_;
-
-    // Clamp frequency
-    freq_ = (0.5f * (fabsf(freq_ + maxDeviation_) -
-                     fabsf(freq_ - maxDeviation_)));
-
-    // Wrap phase if needed
-    if (phase_ > M_2PI || phase_ < -M_2PI) {
-      float frac = phase_ * (1.0 / M_2PI);
-      phase_ = (frac - (float)((int)frac)) * M_2PI;
-    }
+    update(terr);
   }
 }
 
@@ -96,24 +99,26 @@ void Costas::work(
     size_t nsamples,
     std::complex<float>* fi,
     std::complex<float>* fo) {
-  for (size_t i = 0; i < nsamples; i += 4) {
-    float phase[4] = {
-      -(phase_ + 0 * freq_),
-      -(phase_ + 1 * freq_),
-      -(phase_ + 2 * freq_),
-      -(phase_ + 3 * freq_),
-    };
+#ifdef HAVE_X86_DISPATCH
+  if (util::cpu::level() >= util::cpu::AVX2) {
+    workAVX2(nsamples, fi, fo);
+    return;
+  }
+  if (util::cpu::level() >= util::cpu::SSE41) {
+    workSSE41(nsamples, fi, fo);
+    return;
+  }
+#endif
 
+  for (size_t i = 0; i < nsamples; i += 4) {
     // Compute sin/cos for phase offset
-    std::complex<float> sincos[4];
-    for (size_t j = 0; j < 4; j++) {
-      sincos[j].real(cosf(phase[j]));
-      sincos[j].imag(sinf(phase[j]));
-    }
+    float cos[4];
+    float sin[4];
+    nco_.sincos(-phase_, -freq_, 4, cos, sin);
 
     // Complex multiplication
     for (size_t j = 0; j < 4; j++) {
-      fo[i + j] = fi[i + j] * sincos[j];
+      fo[i + j] = fi[i + j] * std::complex<float>(cos[j], sin[j]);
     }
 
     // Phase detector is executed for all samples,
@@ -125,24 +130,152 @@ void Costas::work(
       terr += (0.5f * (fabsf(err + 1.0f) - fabsf(err - 1.0f))) / 4.0f;
     }
 
-    // Update frequency and phase
-    freq_ += beta_ * terr;
-    phase_ += alpha_ * terr + freq_;
+    update(terr);
+  }
+}
 
-    // Clamp frequency
-    freq_ = (0.5f * (fabsf(freq_ + maxDeviation_) -
-                     fabsf(freq_ - maxDeviation_)));
+#ifdef HAVE_X86_DISPATCH
 
-    // Wrap phase if needed
-    if (phase_ > M_2PI || phase_ < -M_2PI) {
-      float frac = phase_ * (1.0 / M_2PI);
-      phase_ = (frac - (float)((int)frac)) * M_2PI;
-    }
+void Costas::workSSE41(
+    size_t nsamples,
+    std::complex<float>* ci,
+    std::complex<float>* co) {
+  const float* fi = (const float*) ci;
+  float* fo = (float*) co;
+
+  // Needed for clipping in loop body
+  const __m128 pos1 = _mm_set1_ps(+1.0f);
+  const __m128 half = _mm_set1_ps(0.5f);
+  const __m128 abs = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+  for (size_t i = 0; i < nsamples; i += 4) {
+    // Compute sin/cos for phase offset.
+    // Assemble the registers from scalars instead of loading them
+    // from memory; a vector load of 4 scalar stores cannot be
+    // forwarded from the store buffer and stalls the loop.
+    float c[4];
+    float s[4];
+    nco_.sincos(-phase_, -freq_, 4, c, s);
+    __m128 cos = _mm_setr_ps(c[0], c[1], c[2], c[3]);
+    __m128 sin = _mm_setr_ps(s[0], s[1], s[2], s[3]);
+
+    // Duplicate sin/cos such that they line up with interleaved I/Q
+    __m128 cos01 = _mm_unpacklo_ps(cos, cos);
+    __m128 cos23 = _mm_unpackhi_ps(cos, cos);
+    __m128 sin01 = _mm_unpacklo_ps(sin, sin);
+    __m128 sin23 = _mm_unpackhi_ps(sin, sin);
+
+    // Load 4 samples into 2 registers (I/Q interleaved)
+    __m128 f01 = _mm_loadu_ps(&fi[2*i+0]);
+    __m128 f23 = _mm_loadu_ps(&fi[2*i+4]);
+
+    // Complex multiplication
+    // (a + ib) * (c + id) expands to:
+    // Real: (ac - bd)
+    // Imaginary: (ad + cb)i
+    // Multiply [a, b] by [c, c] and [b, a] by [d, d], then
+    // subtract the even lanes and add the odd lanes.
+    const auto swap = _MM_SHUFFLE(2, 3, 0, 1);
+    f01 = _mm_addsub_ps(
+      _mm_mul_ps(f01, cos01),
+      _mm_mul_ps(_mm_shuffle_ps(f01, f01, swap), sin01));
+    f23 = _mm_addsub_ps(
+      _mm_mul_ps(f23, cos23),
+      _mm_mul_ps(_mm_shuffle_ps(f23, f23, swap), sin23));
+
+    // Write 4 samples back to memory
+    _mm_storeu_ps(&fo[2*i+0], f01);
+    _mm_storeu_ps(&fo[2*i+4], f23);
+
+    // Phase detector is executed for all samples,
+    // Clip resulting value to [-1.0f, 1.0f]
+    // Every error appears twice, so the total error
+    // is the sum of all lanes divided by 8.
+    __m128 err01 = _mm_mul_ps(f01, _mm_shuffle_ps(f01, f01, swap));
+    __m128 err23 = _mm_mul_ps(f23, _mm_shuffle_ps(f23, f23, swap));
+    err01 = _mm_mul_ps(half, _mm_sub_ps(
+      _mm_and_ps(_mm_add_ps(err01, pos1), abs),
+      _mm_and_ps(_mm_sub_ps(err01, pos1), abs)));
+    err23 = _mm_mul_ps(half, _mm_sub_ps(
+      _mm_and_ps(_mm_add_ps(err23, pos1), abs),
+      _mm_and_ps(_mm_sub_ps(err23, pos1), abs)));
+    __m128 err = _mm_add_ps(err01, err23);
+    err = _mm_add_ps(err, _mm_movehl_ps(err, err));
+    err = _mm_add_ss(err, _mm_movehdup_ps(err));
+    float terr = _mm_cvtss_f32(err) / 8.0f;
+
+    update(terr);
+  }
+}
+
+void Costas::workAVX2(
+    size_t nsamples,
+    std::complex<float>* ci,
+    std::complex<float>* co) {
+  const float* fi = (const float*) ci;
+  float* fo = (float*) co;
+
+  // Needed for clipping in loop body
+  const __m256 pos1 = _mm256_set1_ps(+1.0f);
+  const __m256 half = _mm256_set1_ps(0.5f);
+  const __m256 abs = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+
+  for (size_t i = 0; i < nsamples; i += 4) {
+    // Compute sin/cos for phase offset (see workSSE41)
+    float c[4];
+    float s[4];
+    nco_.sincos(-phase_, -freq_, 4, c, s);
+    __m128 cos = _mm_setr_ps(c[0], c[1], c[2], c[3]);
+    __m128 sin = _mm_setr_ps(s[0], s[1], s[2], s[3]);
+
+    // Duplicate sin/cos such that they line up with interleaved I/Q
+    __m256 cosd = _mm256_insertf128_ps(
+      _mm256_castps128_ps256(_mm_unpacklo_ps(cos, cos)),
+      _mm_unpackhi_ps(cos, cos),
+      1);
+    __m256 sind = _mm256_insertf128_ps(
+      _mm256_castps128_ps256(_mm_unpacklo_ps(sin, sin)),
+      _mm_unpackhi_ps(sin, sin),
+      1);
+
+    // Load 4 samples into 1 register (I/Q interleaved)
+    __m256 f = _mm256_loadu_ps(&fi[2*i]);
+
+    // Complex multiplication (see workSSE41)
+    const auto swap = _MM_SHUFFLE(2, 3, 0, 1);
+    f = _mm256_fmaddsub_ps(
+      f,
+      cosd,
+      _mm256_mul_ps(_mm256_permute_ps(f, swap), sind));
+
+    // Write 4 samples back to memory
+    _mm256_storeu_ps(&fo[2*i], f);
+
+    // Phase detector is executed for all samples,
+    // Clip resulting value to [-1.0f, 1.0f]
+    // Every error appears twice, so the total error
+    // is the sum of all lanes divided by 8.
+    __m256 err = _mm256_mul_ps(f, _mm256_permute_ps(f, swap));
+    err = _mm256_mul_ps(half, _mm256_sub_ps(
+      _mm256_and_ps(_mm256_add_ps(err, pos1), abs),
+      _mm256_and_ps(_mm256_sub_ps(err, pos1), abs)));
+    __m128 acc = _mm_add_ps(
+      _mm256_castps256_ps128(err),
+      _mm256_extractf128_ps(err, 1));
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    acc = _mm_add_ss(acc, _mm_movehdup_ps(acc));
+    float terr = _mm_cvtss_f32(acc) / 8.0f;
+
+    // Avoid AVX to SSE transition penalty in (non-AVX) update
+    _mm256_zeroupper();
+    update(terr);
   }
 }
 
 #endif
 
+#endif
+
 void Costas::work(
     const std::shared_ptr<Queue<Samples> >& qin,
     const std::shared_ptr<Queue<Samples> >& qout) {
@@ -153,6 +286,8 @@ void Costas::work(
   }
 
   auto output = qout->popForWrite();
+  output->timestamp = input->timestamp;
+  timestamp_ = input->timestamp;
   auto nsamples = input->size();
   output->resize(nsamples);
 
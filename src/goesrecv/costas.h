@@ -2,6 +2,9 @@
 
 #include <memory>
 
+#include <util/cpu.h>
+
+#include "nco.h"
 #include "sample_publisher.h"
 #include "types.h"
 
@@ -23,6 +26,10 @@ public:
     return freq_;
   }
 
+  const Timestamp& getTimestamp() const {
+    return timestamp_;
+  }
+
   void work(
       const std::shared_ptr<Queue<Samples> >& qin,
       const std::shared_ptr<Queue<Samples> >& qout);
@@ -33,11 +40,31 @@ protected:
       std::complex<float>* fi,
       std::complex<float>* fo);
 
+#ifdef HAVE_X86_DISPATCH
+  TARGET_SSE41 void workSSE41(
+      size_t nsamples,
+      std::complex<float>* fi,
+      std::complex<float>* fo);
+
+  TARGET_AVX2 void workAVX2(
+      size_t nsamples,
+      std::complex<float>* fi,
+      std::complex<float>* fo);
+#endif
+
+  // Update frequency and phase given the average phase error
+  void update(float terr);
+
   float phase_;
   float freq_;
   float alpha_;
   float beta_;
   float maxDeviation_;
 
+  NCO nco_;
+
   std::unique_ptr<SamplePublisher> samplePublisher_;
+
+  // Of the most recent input block
+  Timestamp timestamp_;
 };
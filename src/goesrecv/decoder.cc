@@ -1,24 +1,27 @@
 #include "decoder.h"
 
-#include <pthread.h>
-
 #include <cstring>
 
 #include <util/time.h>
 
-using namespace util;
+#include "threads.h"
 
-namespace {
+using namespace util;
 
 // QueueReader bridges the queue that produces the soft bits
 // output of the demodulator to the packetizer.
 //
-// The packetizer needs an interface that quacks like read(2).
+// The packetizer peeks at a window of soft bits at a time. If that
+// window lies within a single queued buffer, it gets a pointer into
+// that buffer. Only windows that straddle two buffers are copied.
 //
 class QueueReader : public decoder::Reader {
 public:
-  explicit QueueReader(std::shared_ptr<Queue<std::vector<int8_t> > > queue)
-      : queue_(std::move(queue)) {
+  explicit QueueReader(std::shared_ptr<Queue<SoftBits> > queue)
+      : queue_(std::move(queue)),
+        pos_(0),
+        stagingBegin_(0),
+        stagingEnd_(0) {
   }
 
   virtual ~QueueReader() {
@@ -31,6 +34,15 @@ public:
   virtual size_t read(void* buf, size_t count) {
     char* ptr = (char*) buf;
     size_t nread = 0;
+
+    // Bytes staged by peek come first
+    auto staged = std::min(stagingEnd_ - stagingBegin_, count);
+    if (staged > 0) {
+      memcpy(ptr, &staging_[stagingBegin_], staged);
+      nread += staged;
+      consumeStaging(staged);
+    }
+
     while (nread < count) {
       // Acquire new read buffer if we don't already have one
       if (!tmp_) {
@@ -40,6 +52,7 @@ public:
           return 0;
         }
         pos_ = 0;
+        timestamp_ = tmp_->timestamp;
       }
 
       auto left = tmp_->size() - pos_;
@@ -60,29 +73,207 @@ public:
     return nread;
   }
 
+  virtual const uint8_t* peek(size_t count) {
+    for (;;) {
+      // Acquire new read buffer if we don't already have one
+      if (!tmp_) {
+        tmp_ = queue_->popForRead();
+        if (!tmp_) {
+          // Can't complete peek when queue has closed.
+          return nullptr;
+        }
+        pos_ = 0;
+        timestamp_ = tmp_->timestamp;
+      }
+
+      auto staged = stagingEnd_ - stagingBegin_;
+      auto left = tmp_->size() - pos_;
+
+      // Common case: window lies within current read buffer
+      if (staged == 0 && left >= count) {
+        return reinterpret_cast<const uint8_t*>(&(*tmp_)[pos_]);
+      }
+
+      // Move staged bytes to the front
+      if (stagingBegin_ > 0) {
+        memmove(&staging_[0], &staging_[stagingBegin_], staged);
+        stagingBegin_ = 0;
+        stagingEnd_ = staged;
+      }
+
+      // Complete the window with a copy of the head of the current
+      // read buffer. These bytes are not consumed from the read
+      // buffer until the caller advances past the staged bytes.
+      if (staged + left >= count) {
+        if (staging_.size() < count) {
+          staging_.resize(count);
+        }
+        memcpy(&staging_[staged], &(*tmp_)[pos_], count - staged);
+        return &staging_[0];
+      }
+
+      // Stage the remainder of the current read buffer and return it
+      if (staging_.size() < staged + left) {
+        staging_.resize(staged + left);
+      }
+      memcpy(&staging_[staged], &(*tmp_)[pos_], left);
+      stagingEnd_ += left;
+      queue_->pushRead(std::move(tmp_));
+    }
+  }
+
+  virtual void advance(size_t count) {
+    auto staged = std::min(stagingEnd_ - stagingBegin_, count);
+    consumeStaging(staged);
+    count -= staged;
+    if (count == 0) {
+      return;
+    }
+
+    ASSERT(tmp_ && pos_ + count <= tmp_->size());
+    pos_ += count;
+
+    // Return read buffer if it was exhausted
+    if (pos_ == tmp_->size()) {
+      queue_->pushRead(std::move(tmp_));
+    }
+  }
+
+  // Timestamp of the most recently acquired read buffer. When the
+  // packetizer returns a frame, its last bits came from this buffer.
+  const Timestamp& getTimestamp() const {
+    return timestamp_;
+  }
+
 protected:
-  std::shared_ptr<Queue<std::vector<int8_t> > > queue_;
-  std::unique_ptr<std::vector<int8_t> > tmp_;
+  void consumeStaging(size_t count) {
+    stagingBegin_ += count;
+    if (stagingBegin_ == stagingEnd_) {
+      stagingBegin_ = 0;
+      stagingEnd_ = 0;
+    }
+  }
+
+  std::shared_ptr<Queue<SoftBits> > queue_;
+  std::unique_ptr<SoftBits> tmp_;
   size_t pos_;
-};
 
-} // namespace
+  // Bytes from read buffers that were already returned to the queue,
+  // for windows that straddle read buffers (see peek).
+  std::vector<uint8_t> staging_;
+  size_t stagingBegin_;
+  size_t stagingEnd_;
+
+  Timestamp timestamp_;
+};
 
-Decoder::Decoder(std::shared_ptr<Queue<std::vector<int8_t> > > queue) {
-  packetizer_ = std::make_unique<decoder::Packetizer>(
-    std::make_shared<QueueReader>(std::move(queue)));
+Decoder::Decoder(std::shared_ptr<Queue<SoftBits> > queue)
+    : workers_(0),
+      viterbiErrorInterval_(1),
+      reedSolomonErasures_(0),
+      lockLostSeq_(0),
+      ns_(0),
+      done_(false) {
+  reader_ = std::make_shared<QueueReader>(std::move(queue));
+  packetizer_ = std::make_unique<decoder::Packetizer>(reader_);
+  registry_ = std::make_shared<MetricRegistry>();
 }
 
 void Decoder::initialize(Config& config) {
+  workers_ = config.decoder.workers;
+  viterbiErrorInterval_ = config.decoder.viterbiErrorInterval;
+  packetizer_->setViterbiErrorInterval(viterbiErrorInterval_);
+  reedSolomonErasures_ = config.decoder.reedSolomonErasures;
+  packetizer_->setMaxErasures(reedSolomonErasures_);
+  threadConfig_ = config.threads;
   packetPublisher_ = std::move(config.decoder.packetPublisher);
-  statsPublisher_ = StatsPublisher::create(config.decoder.statsPublisher.bind);
-  if (config.demodulator.statsPublisher.sendBuffer > 0) {
-    statsPublisher_->setSendBuffer(config.decoder.statsPublisher.sendBuffer);
+
+  // Stats are only published as JSON if an endpoint is configured
+  if (!config.decoder.statsPublisher.bind.empty()) {
+    statsPublisher_ = StatsPublisher::create(config.decoder.statsPublisher.bind);
+    if (config.decoder.statsPublisher.sendBuffer > 0) {
+      statsPublisher_->setSendBuffer(config.decoder.statsPublisher.sendBuffer);
+    }
+  }
+
+  // Metrics are written by the thread publishing packets
+  auto& registry = *registry_;
+  const auto sep = labels_.empty() ? "" : ",";
+  metrics_.ok = &registry.counter(
+    "goesrecv_packets_total",
+    "Packets cut from the soft bit stream",
+    labels_ + sep + "result=\"ok\"");
+  metrics_.dropped = &registry.counter(
+    "goesrecv_packets_total",
+    "Packets cut from the soft bit stream",
+    labels_ + sep + "result=\"dropped\"");
+  metrics_.saved = &registry.counter(
+    "goesrecv_packets_saved_total",
+    "Packets that could only be decoded with Reed-Solomon erasures",
+    labels_);
+  metrics_.skippedSymbols = &registry.counter(
+    "goesrecv_skipped_symbols_total",
+    "Symbols skipped while searching for the sync word",
+    labels_);
+  metrics_.viterbiErrors = &registry.histogram(
+    "goesrecv_viterbi_errors",
+    "Bits corrected by the Viterbi decoder per packet",
+    {0, 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000},
+    labels_);
+  metrics_.reedSolomonErrors = &registry.histogram(
+    "goesrecv_reed_solomon_errors",
+    "Bytes corrected by the Reed-Solomon decoder per packet",
+    {0, 1, 2, 4, 8, 16, 32, 64},
+    labels_);
+  metrics_.packetLatency = &registry.histogram(
+    "goesrecv_packet_latency_seconds",
+    "Time from capture of a packet's samples to its publication",
+    {0.01, 0.02, 0.05, 0.1, 0.2, 0.5, 1, 2, 5, 10},
+    labels_);
+}
+
+void Decoder::publish(
+    const std::array<uint8_t, 892>& buf,
+    const decoder::Packetizer::Details& details,
+    const Timestamp& timestamp) {
+  if (details.ok) {
+    stats_.ok++;
+    metrics_.ok->add();
+    if (details.reedSolomonErasures > 0) {
+      stats_.saved++;
+      metrics_.saved->add();
+    }
+  } else {
+    stats_.dropped++;
+    metrics_.dropped->add();
+  }
+  metrics_.skippedSymbols->add(details.skippedSymbols);
+  if (details.viterbiBits >= 0) {
+    metrics_.viterbiErrors->observe(details.viterbiBits);
+  }
+  if (details.reedSolomonBytes >= 0) {
+    metrics_.reedSolomonErrors->observe(details.reedSolomonBytes);
+  }
+  if (details.ok && packetPublisher_) {
+    packetPublisher_->publish(buf);
+  }
+
+  // Time since the source captured the last bits of this packet
+  int64_t latency = -1;
+  if (timestamp.time != 0) {
+    latency = Timestamp::now() - timestamp.time;
+    stats_.latency.record(latency);
+    metrics_.packetLatency->observe(latency / 1e9);
   }
+
+  publishStats(details, timestamp.seq, latency);
 }
 
-void Decoder::publishStats(decoder::Packetizer::Details details) {
-  if (!statsPublisher_) {
+void Decoder::publishStats(
+    decoder::Packetizer::Details details,
+    uint64_t block,
+    int64_t latency) {
+  if (!statsPublisher_ || !statsPublisher_->hasSubscribers()) {
     return;
   }
 
@@ -92,31 +283,152 @@ void Decoder::publishStats(decoder::Packetizer::Details details) {
   ss << "{";
   ss << "\"timestamp\": \"" << timestamp << "\",";
   ss << "\"skipped_symbols\": " << details.skippedSymbols << ",";
-  ss << "\"viterbi_errors\": " << details.viterbiBits << ",";
+  if (details.viterbiBits >= 0) {
+    ss << "\"viterbi_errors\": " << details.viterbiBits << ",";
+  }
   ss << "\"reed_solomon_errors\": " << details.reedSolomonBytes << ",";
+  if (details.reedSolomonErasures > 0) {
+    ss << "\"reed_solomon_erasures\": " << details.reedSolomonErasures << ",";
+  }
+  if (latency >= 0) {
+    ss << "\"block\": " << block << ",";
+    ss << "\"packet_latency\": " << latency / 1e9 << ",";
+  }
   ss << "\"ok\": " << details.ok;
   ss << "}\n";
   statsPublisher_->publish(ss.str());
 }
 
 void Decoder::start() {
-  thread_ = std::thread([&] {
+  if (workers_ > 0) {
+    startParallel();
+  } else {
+    startSequential();
+  }
+}
+
+void Decoder::startSequential() {
+  std::thread thread([&] {
       std::array<uint8_t, 892> buf;
       decoder::Packetizer::Details details;
       while (packetizer_->nextPacket(buf, &details)) {
-        if (details.ok && packetPublisher_) {
-          packetPublisher_->publish(buf);
+        publish(buf, details, reader_->getTimestamp());
+      }
+      ns_ += threadCPUTime();
+      done_ = true;
+    });
+  configureThread(thread, "decoder", threadConfig_);
+  threads_.push_back(std::move(thread));
+}
+
+void Decoder::startParallel() {
+  for (int i = 0; i < workers_; i++) {
+    workerInput_.push_back(std::make_shared<Queue<Work> >(2));
+    workerOutput_.push_back(std::make_shared<Queue<Work> >(2));
+  }
+
+  // Framing thread
+  std::thread framer([&] {
+      uint64_t seq = 0;
+      uint64_t resyncSeq = 0;
+      for (;; seq++) {
+        auto& queue = workerInput_[seq % workers_];
+        auto work = queue->popForWrite();
+
+        // Reacquire sync word position if a packet was dropped. Frames
+        // in flight were cut before this point, so their failures must
+        // not trigger another reacquire.
+        if (lockLostSeq_.load() > resyncSeq) {
+          packetizer_->setLock(false);
+          resyncSeq = seq;
+        }
+
+        if (!packetizer_->nextFrame(work->frame, &work->details)) {
+          break;
         }
-        publishStats(details);
+
+        work->seq = seq;
+        work->timestamp = reader_->getTimestamp();
+        queue->pushWrite(std::move(work));
+      }
+
+      // Workers exit when their input queue has been drained
+      for (auto& queue : workerInput_) {
+        queue->close();
       }
+      ns_ += threadCPUTime();
     });
-#ifdef __APPLE__
-  pthread_setname_np("decoder");
-#else
-  pthread_setname_np(thread_.native_handle(), "decoder");
-#endif
+  configureThread(framer, "decoder", threadConfig_);
+  threads_.push_back(std::move(framer));
+
+  // Worker threads
+  for (int i = 0; i < workers_; i++) {
+    std::thread worker([this, i] {
+        decoder::FrameDecoder frameDecoder;
+        frameDecoder.setMaxErasures(reedSolomonErasures_);
+        auto& input = workerInput_[i];
+        auto& output = workerOutput_[i];
+        for (;;) {
+          auto in = input->popForRead();
+          if (!in) {
+            break;
+          }
+
+          auto out = output->popForWrite();
+          auto& details = out->details;
+          details = in->details;
+          details.viterbiBits = -1;
+          const bool countErrors = viterbiErrorInterval_ > 0 &&
+            (in->seq % viterbiErrorInterval_) == 0;
+          details.reedSolomonBytes = frameDecoder.run(
+            in->frame,
+            out->packet,
+            countErrors ? &details.viterbiBits : nullptr,
+            &details.reedSolomonErasures);
+          details.ok = (details.reedSolomonBytes >= 0);
+          out->seq = in->seq;
+          out->timestamp = in->timestamp;
+          input->pushRead(std::move(in));
+          output->pushWrite(std::move(out));
+        }
+
+        output->close();
+        ns_ += threadCPUTime();
+      });
+    configureThread(worker, "decoder_" + std::to_string(i), threadConfig_);
+    threads_.push_back(std::move(worker));
+  }
+
+  // Publishing thread
+  std::thread publisher([&] {
+      uint64_t seq = 0;
+      for (;; seq++) {
+        auto& queue = workerOutput_[seq % workers_];
+        auto work = queue->popForRead();
+        if (!work) {
+          break;
+        }
+
+        ASSERT(work->seq == seq);
+        if (!work->details.ok) {
+          lockLostSeq_ = work->seq + 1;
+        }
+        publish(work->packet, work->details, work->timestamp);
+        queue->pushRead(std::move(work));
+      }
+      ns_ += threadCPUTime();
+      done_ = true;
+    });
+  configureThread(publisher, "decoder_publish", threadConfig_);
+  threads_.push_back(std::move(publisher));
 }
 
 void Decoder::stop() {
-  thread_.join();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+  threads_.clear();
+  workerInput_.clear();
+  workerOutput_.clear();
+  stats_.ns = ns_;
 }
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <map>
 #include <memory>
 #include <thread>
 #include <vector>
@@ -7,24 +10,140 @@
 #include "decoder/packetizer.h"
 
 #include "config.h"
+#include "latency.h"
+#include "metrics.h"
 #include "packet_publisher.h"
 #include "queue.h"
 #include "stats_publisher.h"
+#include "types.h"
+
+class QueueReader;
 
 class Decoder {
 public:
-  explicit Decoder(std::shared_ptr<Queue<std::vector<int8_t> > > queue);
+  explicit Decoder(std::shared_ptr<Queue<SoftBits> > queue);
+
+  // Register metrics in a shared registry instead of a private one,
+  // with the given labels (e.g. the channel). Call before initialize.
+  void setMetrics(std::shared_ptr<MetricRegistry> registry, const std::string& labels) {
+    registry_ = std::move(registry);
+    labels_ = labels;
+  }
 
   void initialize(Config& config);
 
   void start();
   void stop();
 
+  // Returns true when the soft bit stream has ended (e.g. because a
+  // file source reached the end of its file) and every packet has
+  // been published. Never happens for live sources.
+  bool done() const {
+    return done_;
+  }
+
+  struct Stats {
+    // Number of packets that were decoded successfully
+    int64_t ok = 0;
+
+    // Number of packets that could not be decoded
+    int64_t dropped = 0;
+
+    // Number of packets that could only be decoded with erasures
+    // (included in ok)
+    int64_t saved = 0;
+
+    // CPU time spent by the decoder thread(s)
+    int64_t ns = 0;
+
+    // Time from capture of a packet's samples to its publication
+    LatencyHistogram latency;
+  };
+
+  // Only safe to read when the decoder is stopped.
+  const Stats& getStats() const {
+    return stats_;
+  }
+
+  // Metrics written by the publishing thread. Safe to read any time.
+  struct Metrics {
+    Counter* ok = nullptr;
+    Counter* dropped = nullptr;
+    Counter* saved = nullptr;
+    Counter* skippedSymbols = nullptr;
+    Histogram* viterbiErrors = nullptr;
+    Histogram* reedSolomonErrors = nullptr;
+    Histogram* packetLatency = nullptr;
+  };
+
+  const Metrics& getMetrics() const {
+    return metrics_;
+  }
+
 protected:
-  void publishStats(decoder::Packetizer::Details details);
+  // Frame and decode packets on a single thread
+  void startSequential();
+
+  // Frame packets on one thread, decode them on a pool of worker
+  // threads, and publish them in order on yet another thread
+  void startParallel();
 
+  void publish(
+    const std::array<uint8_t, 892>& buf,
+    const decoder::Packetizer::Details& details,
+    const Timestamp& timestamp);
+
+  // Latency is negative if the source did not stamp its samples
+  void publishStats(
+    decoder::Packetizer::Details details,
+    uint64_t block,
+    int64_t latency);
+
+  // Unit of work for a worker thread (only used in parallel mode)
+  struct Work {
+    // Sequence number assigned by the framing thread
+    uint64_t seq;
+
+    decoder::EncodedFrame frame;
+    decoder::Packetizer::Details details;
+    std::array<uint8_t, 892> packet;
+    Timestamp timestamp;
+  };
+
+  int workers_;
+  int viterbiErrorInterval_;
+  int reedSolomonErasures_;
+  std::map<std::string, Config::Thread> threadConfig_;
+
+  std::shared_ptr<QueueReader> reader_;
   std::unique_ptr<decoder::Packetizer> packetizer_;
   std::unique_ptr<PacketPublisher> packetPublisher_;
   std::unique_ptr<StatsPublisher> statsPublisher_;
-  std::thread thread_;
+  std::vector<std::thread> threads_;
+
+  std::shared_ptr<MetricRegistry> registry_;
+  std::string labels_;
+  Metrics metrics_;
+
+  // Frames are distributed round robin over the workers, and
+  // collected round robin from the workers, so that every queue
+  // has a single producer and a single consumer, and packets
+  // are published in the order they were cut from the stream.
+  std::vector<std::shared_ptr<Queue<Work> > > workerInput_;
+  std::vector<std::shared_ptr<Queue<Work> > > workerOutput_;
+
+  // Set by the publishing thread when a packet could not be decoded,
+  // such that the framing thread reacquires the sync word position.
+  // Holds the sequence number of that packet plus one (0 if none), so
+  // that the framing thread can ignore failures of frames it had cut
+  // before it last reacquired (they are expected to fail as well).
+  std::atomic<uint64_t> lockLostSeq_;
+
+  // CPU time of all decoder threads
+  std::atomic<int64_t> ns_;
+
+  // Set by the thread that publishes packets when it exits
+  std::atomic<bool> done_;
+
+  Stats stats_;
 };
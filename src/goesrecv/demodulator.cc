@@ -1,12 +1,74 @@
 #include "demodulator.h"
 
-#include <pthread.h>
+#include <functional>
 
 #include <util/error.h>
 #include <util/time.h>
 
+#include "threads.h"
+
 using namespace util;
 
+namespace {
+
+// Run work function of a stage and account for its CPU time,
+// and for the latency of the block it produced (if any).
+template <typename Stage, typename Fn>
+void timed(Demodulator::StageStats& stats, const Stage& stage, Fn fn) {
+  const auto start = threadCPUTime();
+  fn();
+  stats.ns += threadCPUTime() - start;
+  stats.calls++;
+
+  const auto& timestamp = stage.getTimestamp();
+  if (timestamp.time == 0) {
+    return;
+  }
+  if (stats.latency.count() > 0 && timestamp.seq == stats.seq) {
+    return;
+  }
+  const auto latency = Timestamp::now() - timestamp.time;
+  stats.latency.record(latency);
+  stats.lastLatency.store(latency, std::memory_order_relaxed);
+  stats.latencyMetric->observe(latency / 1e9);
+  stats.seq = timestamp.seq;
+}
+
+// Upper bounds of the latency histograms (in seconds)
+const std::vector<double> latencyBounds = {
+  0.001, 0.002, 0.005, 0.01, 0.02, 0.05, 0.1, 0.2, 0.5, 1, 2, 5, 10,
+};
+
+// Exports the counters that a queue keeps itself
+template <typename T>
+void registerQueue(
+    MetricRegistry& registry,
+    const std::string& labels,
+    const std::string& name,
+    std::shared_ptr<Queue<T> > queue) {
+  const auto l = labels + (labels.empty() ? "" : ",") + "queue=\"" + name + "\"";
+  registry.callback(
+    "goesrecv_queue_dropped_total",
+    "Blocks dropped because the queue was full",
+    "counter",
+    l,
+    [queue] { return queue->getStats().dropped; });
+  registry.callback(
+    "goesrecv_queue_high_water",
+    "Maximum number of blocks queued for reading",
+    "gauge",
+    l,
+    [queue] { return queue->getStats().highWater; });
+  registry.callback(
+    "goesrecv_queue_blocked_seconds_total",
+    "Time the producer spent waiting for a free block",
+    "counter",
+    l,
+    [queue] { return queue->getStats().blockedNs / 1e9; });
+}
+
+} // namespace
+
 Demodulator::Demodulator(Demodulator::Type t) {
   switch (t) {
   case LRIT:
@@ -21,29 +83,69 @@ Demodulator::Demodulator(Demodulator::Type t) {
 
   // Sample rate depends on source
   sampleRate_ = 0;
-
-  // Initialize queues
-  // It is possible to attach publishers before starting the demodulator
-  sourceQueue_ = std::make_shared<Queue<Samples> >(4);
-  agcQueue_ = std::make_shared<Queue<Samples> >(2);
-  costasQueue_ = std::make_shared<Queue<Samples> >(2);
-  rrcQueue_ = std::make_shared<Queue<Samples> >(2);
-  clockRecoveryQueue_ = std::make_shared<Queue<Samples> >(2);
-  softBitsQueue_ = std::make_shared<Queue<std::vector<int8_t> > >(2);
+  frontEndSampleRate_ = 0;
+  frequencyOffset_ = 0.0f;
+  pipeline_ = false;
+  registry_ = std::make_shared<MetricRegistry>();
 }
 
 void Demodulator::initialize(Config& config) {
-  source_ = Source::build(config.demodulator.source, config);
+  initialize(config, Source::build(config.demodulator.source, config));
+}
+
+void Demodulator::initialize(Config& config, std::unique_ptr<Source> source) {
+  pipeline_ = config.demodulator.pipeline;
+  threadConfig_ = config.threads;
+
+  // Initialize queues
+  const auto sourceDepth = config.demodulator.sourceQueueDepth;
+  const auto sourceOverflow = config.demodulator.sourceQueueOverflow;
+  const auto depth = config.demodulator.queueDepth;
+  const auto overflow = config.demodulator.queueOverflow;
+  sourceQueue_ = std::make_shared<Queue<RawSamples> >(sourceDepth, sourceOverflow);
+  agcQueue_ = std::make_shared<Queue<Samples> >(depth, overflow);
+  costasQueue_ = std::make_shared<Queue<Samples> >(depth, overflow);
+  rrcQueue_ = std::make_shared<Queue<Samples> >(depth, overflow);
+  clockRecoveryQueue_ = std::make_shared<Queue<Samples> >(depth, overflow);
+  softBitsQueue_ = std::make_shared<Queue<SoftBits> >(depth, overflow);
+
+  source_ = std::move(source);
   sampleRate_ = source_->getSampleRate();
 
-  statsPublisher_ = StatsPublisher::create(config.demodulator.statsPublisher.bind);
-  if (config.demodulator.statsPublisher.sendBuffer > 0) {
-    statsPublisher_->setSendBuffer(config.demodulator.statsPublisher.sendBuffer);
+  // Stats are only published as JSON if an endpoint is configured
+  if (!config.demodulator.statsPublisher.bind.empty()) {
+    statsPublisher_ = StatsPublisher::create(config.demodulator.statsPublisher.bind);
+    if (config.demodulator.statsPublisher.sendBuffer > 0) {
+      statsPublisher_->setSendBuffer(config.demodulator.statsPublisher.sendBuffer);
+    }
   }
 
   const auto dc = config.demodulator.decimation;
-  const auto sr1 = sampleRate_;
-  const auto sr2 = sampleRate_ / dc;
+  const auto fdc = config.frontEnd.decimation;
+  const auto sr1 = sampleRate_ / fdc;
+  const auto sr2 = sr1 / dc;
+
+  // The front end shifts the signal by the configured frequency
+  // offset and decimates it before the AGC and Costas loop.
+  // Its output is aligned for the 4 sample wide AGC and Costas
+  // loop kernels, and for the decimation of the RRC filter.
+  frontEndQueue_ = sourceQueue_;
+  frontEndSampleRate_ = sr1;
+  frequencyOffset_ = 0.0f;
+  if (fdc > 1 || config.frontEnd.frequencyOffset != 0.0f) {
+    frontEndQueue_ = std::make_shared<Queue<RawSamples> >(depth, overflow);
+    frequencyOffset_ = config.frontEnd.frequencyOffset;
+    frontEnd_ = std::make_unique<FrontEnd>(
+      fdc,
+      sampleRate_,
+      symbolRate_,
+      config.rrc.rollOff,
+      frequencyOffset_,
+      config.frontEnd.taps,
+      4 * dc);
+    frontEnd_->setSamplePublisher(std::move(config.frontEnd.samplePublisher));
+    stageStats_["front_end"];
+  }
 
   agc_ = std::make_unique<AGC>();
   agc_->setMin(config.agc.min);
@@ -52,12 +154,13 @@ void Demodulator::initialize(Config& config) {
 
   // Maximum frequency deviation in radians per sample (given in Hz)
   const auto maxDeviation =
-    (config.costas.maxDeviation * 2 * M_PI) / sampleRate_;
+    (config.costas.maxDeviation * 2 * M_PI) / sr1;
   costas_ = std::make_unique<Costas>();
   costas_->setMaxDeviation(maxDeviation);
   costas_->setSamplePublisher(std::move(config.costas.samplePublisher));
 
-  rrc_ = std::make_unique<RRC>(dc, sr1, symbolRate_);
+  rrc_ = std::make_unique<RRC>(
+    dc, sr1, symbolRate_, config.rrc.taps, config.rrc.rollOff);
   rrc_->setSamplePublisher(std::move(config.rrc.samplePublisher));
 
   clockRecovery_ = std::make_unique<ClockRecovery>(sr2, symbolRate_);
@@ -65,17 +168,84 @@ void Demodulator::initialize(Config& config) {
 
   quantization_ = std::make_unique<Quantize>();
   quantization_->setSoftBitPublisher(std::move(config.quantization.softBitPublisher));
+
+  // Create entries up front; threads only modify their own entry
+  for (const auto& name : {"agc", "costas", "rrc", "clock_recovery", "quantization"}) {
+    stageStats_[name];
+  }
+
+  // Metrics are written by the thread running the stage they
+  // belong to, and read by the monitor and the metrics endpoint.
+  auto& registry = *registry_;
+  metrics_.gain = &registry.gauge(
+    "goesrecv_gain",
+    "Gain applied by the AGC",
+    labels_);
+  metrics_.frequency = &registry.gauge(
+    "goesrecv_frequency_hz",
+    "Carrier frequency offset tracked by the Costas loop",
+    labels_);
+  metrics_.omega = &registry.gauge(
+    "goesrecv_omega",
+    "Samples per symbol tracked by clock recovery",
+    labels_);
+  for (auto& it : stageStats_) {
+    const auto l = labels_ + (labels_.empty() ? "" : ",") + "stage=\"" + it.first + "\"";
+    auto& histogram = registry.histogram(
+      "goesrecv_stage_latency_seconds",
+      "Time from capture of a block until a stage is done with it",
+      latencyBounds,
+      l);
+    it.second.latencyMetric = &histogram;
+  }
+  registerQueue(registry, labels_, "source", sourceQueue_);
+  if (frontEnd_) {
+    registerQueue(registry, labels_, "front_end", frontEndQueue_);
+  }
+  registerQueue(registry, labels_, "agc", agcQueue_);
+  registerQueue(registry, labels_, "costas", costasQueue_);
+  registerQueue(registry, labels_, "rrc", rrcQueue_);
+  registerQueue(registry, labels_, "clock_recovery", clockRecoveryQueue_);
+  registerQueue(registry, labels_, "quantization", softBitsQueue_);
+}
+
+void Demodulator::updateAGC() {
+  metrics_.gain->set(agc_->getGain());
+}
+
+void Demodulator::updateCostas() {
+  metrics_.frequency->set(frequencyOffset_ +
+    (frontEndSampleRate_ * costas_->getFrequency()) / (2 * M_PI));
+}
+
+void Demodulator::updateClockRecovery() {
+  metrics_.omega->set(clockRecovery_->getOmega());
+}
+
+std::map<std::string, QueueStats> Demodulator::getQueueStats() {
+  std::map<std::string, QueueStats> out;
+  out["source"] = sourceQueue_->getStats();
+  if (frontEnd_) {
+    out["front_end"] = frontEndQueue_->getStats();
+  }
+  out["agc"] = agcQueue_->getStats();
+  out["costas"] = costasQueue_->getStats();
+  out["rrc"] = rrcQueue_->getStats();
+  out["clock_recovery"] = clockRecoveryQueue_->getStats();
+  out["quantization"] = softBitsQueue_->getStats();
+  return out;
 }
 
 void Demodulator::publishStats() {
-  if (!statsPublisher_) {
+  if (!statsPublisher_ || !statsPublisher_->hasSubscribers()) {
     return;
   }
 
+  // Read from the metrics; the stages may run on other threads
   const auto timestamp = stringTime();
-  const auto gain = agc_->getGain();
-  const auto frequency = (sampleRate_ * costas_->getFrequency()) / (2 * M_PI);
-  const auto omega = clockRecovery_->getOmega();
+  const auto gain = metrics_.gain->value();
+  const auto frequency = metrics_.frequency->value();
+  const auto omega = metrics_.omega->value();
 
   std::stringstream ss;
   ss.precision(10);
@@ -84,38 +254,167 @@ void Demodulator::publishStats() {
   ss << "\"timestamp\": \"" << timestamp << "\",";
   ss << "\"gain\": " << gain << ",";
   ss << "\"frequency\": " << frequency << ",";
-  ss << "\"omega\": " << omega;
+  ss << "\"omega\": " << omega << ",";
+  ss << "\"block\": " << quantization_->getTimestamp().seq << ",";
+
+  // Latency of the most recent block of every stage (in seconds)
+  ss << "\"latency\": {";
+  const char* sep = "";
+  for (const auto& it : stageStats_) {
+    const auto latency = it.second.lastLatency.load(std::memory_order_relaxed);
+    ss << sep << "\"" << it.first << "\": " << latency / 1e9;
+    sep = ",";
+  }
+  ss << "},";
+
+  // Overflow counters of every queue, keyed by the stage writing to it
+  ss << "\"queues\": {";
+  sep = "";
+  for (const auto& it : getQueueStats()) {
+    ss << sep << "\"" << it.first << "\": {";
+    ss << "\"dropped\": " << it.second.dropped << ",";
+    ss << "\"high_water\": " << it.second.highWater << ",";
+    ss << "\"blocked\": " << it.second.blockedNs / 1e9;
+    ss << "}";
+    sep = ",";
+  }
+  ss << "}";
   ss << "}\n";
   statsPublisher_->publish(ss.str());
 }
 
 void Demodulator::start() {
-  thread_ = std::thread([&] {
-      while (!sourceQueue_->closed()) {
-        agc_->work(sourceQueue_, agcQueue_);
-        costas_->work(agcQueue_, costasQueue_);
-        rrc_->work(costasQueue_, rrcQueue_);
-        clockRecovery_->work(rrcQueue_, clockRecoveryQueue_);
-        quantization_->work(clockRecoveryQueue_, softBitsQueue_);
+  if (pipeline_) {
+    startPipeline();
+  } else {
+    startSequential();
+  }
+  source_->start(sourceQueue_);
+}
+
+void Demodulator::startSequential() {
+  std::thread thread([&] {
+      auto frontEndStats = frontEnd_ ? &stageStats_["front_end"] : nullptr;
+      auto& agcStats = stageStats_["agc"];
+      auto& costasStats = stageStats_["costas"];
+      auto& rrcStats = stageStats_["rrc"];
+      auto& clockRecoveryStats = stageStats_["clock_recovery"];
+      auto& quantizationStats = stageStats_["quantization"];
+
+      // Every stage closes its output queue when its input queue has
+      // closed and has been drained, so this also processes whatever
+      // the source produced before it closed its queue.
+      while (!softBitsQueue_->closed()) {
+        if (frontEnd_) {
+          timed(*frontEndStats, *frontEnd_, [&] {
+              frontEnd_->work(sourceQueue_, frontEndQueue_);
+            });
+        }
+        timed(agcStats, *agc_, [&] {
+            agc_->work(frontEndQueue_, agcQueue_);
+            updateAGC();
+          });
+        timed(costasStats, *costas_, [&] {
+            costas_->work(agcQueue_, costasQueue_);
+            updateCostas();
+          });
+        timed(rrcStats, *rrc_, [&] {
+            rrc_->work(costasQueue_, rrcQueue_);
+          });
+        timed(clockRecoveryStats, *clockRecovery_, [&] {
+            clockRecovery_->work(rrcQueue_, clockRecoveryQueue_);
+            updateClockRecovery();
+          });
+        timed(quantizationStats, *quantization_, [&] {
+            quantization_->work(clockRecoveryQueue_, softBitsQueue_);
+          });
         publishStats();
       }
 
       // Close queues to signal downstream consumers of termination
+      if (frontEnd_) {
+        frontEndQueue_->close();
+      }
       agcQueue_->close();
       costasQueue_->close();
       rrcQueue_->close();
       clockRecoveryQueue_->close();
       softBitsQueue_->close();
     });
-#ifdef __APPLE__
-  pthread_setname_np("demodulator");
-#else
-  pthread_setname_np(thread_.native_handle(), "demodulator");
-#endif
-  source_->start(sourceQueue_);
+  configureThread(thread, "demodulator", threadConfig_);
+  threads_.push_back(std::move(thread));
+}
+
+void Demodulator::startPipeline() {
+  // Every stage closes its output queue when its input queue has
+  // closed and has been drained. This means termination propagates
+  // down the pipeline and every thread exits when its output closes.
+  auto stage = [&] (const std::string& name, std::function<void()> fn) {
+    std::thread thread(std::move(fn));
+    configureThread(thread, name, threadConfig_);
+    threads_.push_back(std::move(thread));
+  };
+
+  if (frontEnd_) {
+    stage("front_end", [&] {
+        auto& stats = stageStats_["front_end"];
+        while (!frontEndQueue_->closed()) {
+          timed(stats, *frontEnd_, [&] {
+              frontEnd_->work(sourceQueue_, frontEndQueue_);
+            });
+        }
+      });
+  }
+  stage("agc", [&] {
+      auto& stats = stageStats_["agc"];
+      while (!agcQueue_->closed()) {
+        timed(stats, *agc_, [&] {
+            agc_->work(frontEndQueue_, agcQueue_);
+            updateAGC();
+          });
+      }
+    });
+  stage("costas", [&] {
+      auto& stats = stageStats_["costas"];
+      while (!costasQueue_->closed()) {
+        timed(stats, *costas_, [&] {
+            costas_->work(agcQueue_, costasQueue_);
+            updateCostas();
+          });
+      }
+    });
+  stage("rrc", [&] {
+      auto& stats = stageStats_["rrc"];
+      while (!rrcQueue_->closed()) {
+        timed(stats, *rrc_, [&] {
+            rrc_->work(costasQueue_, rrcQueue_);
+          });
+      }
+    });
+  stage("clock_recovery", [&] {
+      auto& stats = stageStats_["clock_recovery"];
+      while (!clockRecoveryQueue_->closed()) {
+        timed(stats, *clockRecovery_, [&] {
+            clockRecovery_->work(rrcQueue_, clockRecoveryQueue_);
+            updateClockRecovery();
+          });
+      }
+    });
+  stage("quantization", [&] {
+      auto& stats = stageStats_["quantization"];
+      while (!softBitsQueue_->closed()) {
+        timed(stats, *quantization_, [&] {
+            quantization_->work(clockRecoveryQueue_, softBitsQueue_);
+          });
+        publishStats();
+      }
+    });
 }
 
 void Demodulator::stop() {
   source_->stop();
-  thread_.join();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+  threads_.clear();
 }
@@ -1,11 +1,17 @@
 #pragma once
 
+#include <atomic>
+#include <map>
 #include <thread>
+#include <vector>
 
 #include "agc.h"
 #include "clock_recovery.h"
 #include "config.h"
 #include "costas.h"
+#include "front_end.h"
+#include "latency.h"
+#include "metrics.h"
 #include "publisher.h"
 #include "quantize.h"
 #include "rrc.h"
@@ -22,9 +28,64 @@ public:
 
   explicit Demodulator(Type t);
 
+  // Register metrics in a shared registry instead of a private one,
+  // with the given labels (e.g. the channel). Call before initialize.
+  void setMetrics(std::shared_ptr<MetricRegistry> registry, const std::string& labels) {
+    registry_ = std::move(registry);
+    labels_ = labels;
+  }
+
   void initialize(Config& config);
 
-  std::shared_ptr<Queue<std::vector<int8_t> > > getSoftBitsQueue() {
+  // Initialize with a source that is constructed by the caller
+  // instead of the one in the configuration (e.g. for benchmarks).
+  void initialize(Config& config, std::unique_ptr<Source> source);
+
+  struct StageStats {
+    // CPU time spent in the work function of this stage
+    int64_t ns = 0;
+
+    // Number of times the work function was called
+    int64_t calls = 0;
+
+    // Time from capture of a block until this stage is done with it
+    LatencyHistogram latency;
+
+    // Latency of the most recent block. This and latencyMetric are
+    // the only fields that can be read while the demodulator is running.
+    std::atomic<int64_t> lastLatency{0};
+
+    // Sequence number of the most recent block
+    uint64_t seq = 0;
+
+    // Same latency (in seconds) in the metric registry.
+    // Set by initialize.
+    Histogram* latencyMetric = nullptr;
+  };
+
+  // Metrics written by the stage threads. Safe to read any time.
+  struct Metrics {
+    Gauge* gain = nullptr;
+    Gauge* frequency = nullptr;
+    Gauge* omega = nullptr;
+  };
+
+  const Metrics& getMetrics() const {
+    return metrics_;
+  }
+
+  // Stats for every stage, keyed by stage name.
+  // Only safe to read when the demodulator is stopped (see above).
+  const std::map<std::string, StageStats>& getStageStats() const {
+    return stageStats_;
+  }
+
+  // Overflow counters of every queue, keyed by the stage writing
+  // to it ("source" for the queue between source and first stage).
+  // Safe to call while the demodulator is running.
+  std::map<std::string, QueueStats> getQueueStats();
+
+  std::shared_ptr<Queue<SoftBits> > getSoftBitsQueue() {
     return softBitsQueue_;
   }
 
@@ -32,16 +93,41 @@ public:
   void stop();
 
 protected:
+  // Copy state of a stage to its metrics (on the thread of the stage)
+  void updateAGC();
+  void updateCostas();
+  void updateClockRecovery();
+
   void publishStats();
 
+  // Run every stage in sequence on a single thread
+  void startSequential();
+
+  // Run every stage on its own thread
+  void startPipeline();
+
   uint32_t symbolRate_;
   uint32_t sampleRate_;
 
+  // Sample rate and frequency offset after the front end
+  uint32_t frontEndSampleRate_;
+  float frequencyOffset_;
+  bool pipeline_;
+
   std::unique_ptr<Source> source_;
   std::unique_ptr<StatsPublisher> statsPublisher_;
-  std::thread thread_;
+  std::map<std::string, Config::Thread> threadConfig_;
 
-  // DSP blocks
+  std::shared_ptr<MetricRegistry> registry_;
+  std::string labels_;
+  Metrics metrics_;
+  std::vector<std::thread> threads_;
+
+  // Every entry is only written by the thread running that stage
+  std::map<std::string, StageStats> stageStats_;
+
+  // DSP blocks (front end is optional)
+  std::unique_ptr<FrontEnd> frontEnd_;
   std::unique_ptr<AGC> agc_;
   std::unique_ptr<Costas> costas_;
   std::unique_ptr<RRC> rrc_;
@@ -49,10 +135,13 @@ protected:
   std::unique_ptr<Quantize> quantization_;
 
   // Queues
-  std::shared_ptr<Queue<Samples> > sourceQueue_;
+  std::shared_ptr<Queue<RawSamples> > sourceQueue_;
+
+  // Same as sourceQueue_ if there is no front end
+  std::shared_ptr<Queue<RawSamples> > frontEndQueue_;
   std::shared_ptr<Queue<Samples> > agcQueue_;
   std::shared_ptr<Queue<Samples> > costasQueue_;
   std::shared_ptr<Queue<Samples> > rrcQueue_;
   std::shared_ptr<Queue<Samples> > clockRecoveryQueue_;
-  std::shared_ptr<Queue<std::vector<int8_t> > > softBitsQueue_;
+  std::shared_ptr<Queue<SoftBits> > softBitsQueue_;
 };
@@ -0,0 +1,310 @@
+#include "file_source.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <nlohmann/json.hpp>
+
+#include <util/error.h>
+
+#include "threads.h"
+
+namespace {
+
+// Position and format of the samples in a recording
+struct Layout {
+  RawSamples::Format format = RawSamples::CF32;
+  uint32_t sampleRate = 0;
+  size_t offset = 0;
+  size_t size = 0;
+  bool hasFormat = false;
+};
+
+bool endsWith(const std::string& str, const std::string& suffix) {
+  return str.size() >= suffix.size() &&
+    str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+void throwFileError(const std::string& path, const std::string& what) {
+  std::stringstream ss;
+  ss << "Unable to read " << path << ": " << what;
+  throw std::runtime_error(ss.str());
+}
+
+RawSamples::Format parseFormat(const std::string& format) {
+  if (format == "cu8") {
+    return RawSamples::CU8;
+  }
+  if (format == "cs8") {
+    return RawSamples::CS8;
+  }
+  if (format == "cs16") {
+    return RawSamples::CS16;
+  }
+  if (format == "cf32") {
+    return RawSamples::CF32;
+  }
+  throw std::invalid_argument("Invalid sample format: " + format);
+}
+
+// Little endian integer at p (WAV headers are little endian)
+uint32_t le(const uint8_t* p, size_t n) {
+  uint32_t v = 0;
+  for (size_t i = 0; i < n; i++) {
+    v |= (uint32_t) p[i] << (8 * i);
+  }
+  return v;
+}
+
+// Finds the "fmt " and "data" chunks in a RIFF/WAVE file.
+Layout parseWAV(const std::string& path, const uint8_t* buf, size_t size) {
+  Layout layout;
+  if (size < 12 || memcmp(buf, "RIFF", 4) != 0 || memcmp(buf + 8, "WAVE", 4) != 0) {
+    throwFileError(path, "not a WAV file");
+  }
+
+  bool fmt = false;
+  size_t pos = 12;
+  while (pos + 8 <= size) {
+    const uint8_t* chunk = buf + pos;
+    const size_t len = le(chunk + 4, 4);
+    pos += 8;
+
+    if (memcmp(chunk, "fmt ", 4) == 0) {
+      if (len < 16 || pos + len > size) {
+        throwFileError(path, "invalid fmt chunk");
+      }
+      auto tag = le(chunk + 8, 2);
+      const auto channels = le(chunk + 10, 2);
+      const auto bits = le(chunk + 22, 2);
+
+      // Extensible format stores the actual tag in the subformat GUID
+      if (tag == 0xfffe && len >= 26) {
+        tag = le(chunk + 32, 2);
+      }
+      if (channels != 2) {
+        throwFileError(path, "expected 2 channels (I/Q)");
+      }
+      if (tag == 1 && bits == 8) {
+        layout.format = RawSamples::CU8;
+      } else if (tag == 1 && bits == 16) {
+        layout.format = RawSamples::CS16;
+      } else if (tag == 3 && bits == 32) {
+        layout.format = RawSamples::CF32;
+      } else {
+        throwFileError(path, "unsupported sample format");
+      }
+      layout.sampleRate = le(chunk + 12, 4);
+      layout.hasFormat = true;
+      fmt = true;
+    } else if (memcmp(chunk, "data", 4) == 0) {
+      if (!fmt) {
+        throwFileError(path, "data chunk before fmt chunk");
+      }
+      layout.offset = pos;
+      // Size may be unset if the recording was not finalized
+      layout.size = std::min(len, size - pos);
+      return layout;
+    }
+
+    // Chunks are padded to an even size
+    pos += len + (len & 1);
+  }
+
+  throwFileError(path, "no data chunk");
+  return layout;
+}
+
+// Reads the global object of a SigMF metadata file.
+Layout parseSigMF(const std::string& path) {
+  Layout layout;
+  nlohmann::json meta;
+  try {
+    std::ifstream ifs(path);
+    if (!ifs) {
+      throwFileError(path, strerror(errno));
+    }
+    ifs >> meta;
+  } catch (nlohmann::json::exception& e) {
+    throwFileError(path, e.what());
+  }
+
+  const auto& global = meta["global"];
+  const auto datatype = global.value("core:datatype", std::string());
+  if (datatype == "cu8") {
+    layout.format = RawSamples::CU8;
+  } else if (datatype == "ci8") {
+    layout.format = RawSamples::CS8;
+  } else if (datatype == "ci16_le") {
+    layout.format = RawSamples::CS16;
+  } else if (datatype == "cf32_le") {
+    layout.format = RawSamples::CF32;
+  } else {
+    throwFileError(path, "unsupported datatype \"" + datatype + "\"");
+  }
+  layout.sampleRate = global.value("core:sample_rate", 0.0);
+  layout.hasFormat = true;
+  return layout;
+}
+
+} // namespace
+
+std::unique_ptr<FileSource> FileSource::open(const Config::File& config) {
+  auto path = config.path;
+
+  // SigMF recordings are a pair of files
+  Layout layout;
+  const bool sigmf =
+    endsWith(path, ".sigmf-meta") || endsWith(path, ".sigmf-data");
+  if (sigmf) {
+    const auto base = path.substr(0, path.size() - 11);
+    layout = parseSigMF(base + ".sigmf-meta");
+    path = base + ".sigmf-data";
+  }
+
+  auto fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throwFileError(path, strerror(errno));
+  }
+
+  struct stat st;
+  auto rv = fstat(fd, &st);
+  if (rv < 0 || st.st_size == 0) {
+    ::close(fd);
+    throwFileError(path, rv < 0 ? strerror(errno) : "empty file");
+  }
+
+  const size_t size = st.st_size;
+  void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    throwFileError(path, strerror(errno));
+  }
+
+  // Samples are read once, front to back
+  madvise(map, size, MADV_SEQUENTIAL);
+
+  try {
+    if (endsWith(path, ".wav")) {
+      layout = parseWAV(path, (const uint8_t*) map, size);
+    } else {
+      layout.size = size;
+    }
+
+    // Configuration overrides what the recording says
+    if (!config.format.empty()) {
+      layout.format = parseFormat(config.format);
+      layout.hasFormat = true;
+    }
+    if (config.sampleRate != 0) {
+      layout.sampleRate = config.sampleRate;
+    }
+    if (!layout.hasFormat) {
+      throw std::invalid_argument("Key not set: format");
+    }
+    if (layout.sampleRate == 0) {
+      throw std::invalid_argument("Key not set: sample_rate");
+    }
+  } catch (...) {
+    munmap(map, size);
+    throw;
+  }
+
+  return std::make_unique<FileSource>(
+    map,
+    size,
+    layout.offset,
+    layout.size,
+    layout.format,
+    layout.sampleRate);
+}
+
+FileSource::FileSource(
+    void* map,
+    size_t mapSize,
+    size_t offset,
+    size_t size,
+    RawSamples::Format format,
+    uint32_t sampleRate) :
+    map_(map),
+    mapSize_(mapSize),
+    data_((const uint8_t*) map + offset),
+    size_(size),
+    format_(format),
+    sampleRate_(sampleRate),
+    speed_(0.0f),
+    blockSize_(64 * 1024),
+    stop_(false) {
+}
+
+FileSource::~FileSource() {
+  munmap(map_, mapSize_);
+}
+
+uint32_t FileSource::getSampleRate() const {
+  return sampleRate_;
+}
+
+void FileSource::loop() {
+  // The stages downstream process 4 samples at a time,
+  // so every block (including the last) is a multiple of 4.
+  const size_t sampleSize = RawSamples::sampleSize(format_);
+  const size_t blockSize = std::max<size_t>(blockSize_ & ~(size_t) 3, 4);
+  const size_t nsamples = (size_ / sampleSize) & ~(size_t) 3;
+
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < nsamples && !stop_; i += blockSize) {
+    const auto n = std::min(blockSize, nsamples - i);
+    auto out = queue_->popForWrite();
+    out->resize(format_, n);
+    memcpy(out->data.data(), data_ + i * sampleSize, n * sampleSize);
+    stamp(*out);
+
+    // Publish output if applicable
+    if (samplePublisher_) {
+      samplePublisher_->publish(*out);
+    }
+
+    // Return buffer to queue
+    queue_->pushWrite(std::move(out));
+
+    // Rate limit to the configured multiple of real time
+    if (speed_ > 0.0f) {
+      const std::chrono::duration<double> t((i + n) / (sampleRate_ * (double) speed_));
+      std::this_thread::sleep_until(
+        start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(t));
+    }
+  }
+
+  // Signal end of stream
+  queue_->close();
+}
+
+void FileSource::start(const std::shared_ptr<Queue<RawSamples> >& queue) {
+  queue_ = queue;
+  thread_ = std::thread(&FileSource::loop, this);
+  configureThread(thread_, "file", threadConfig_);
+}
+
+void FileSource::stop() {
+  stop_ = true;
+
+  // Wait for thread to terminate
+  thread_.join();
+
+  // Close queue to signal downstream (no-op if loop finished)
+  queue_->close();
+
+  // Clear reference to queue
+  queue_.reset();
+}
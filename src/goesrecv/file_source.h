@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "source.h"
+
+// Source that replays a recording of I/Q samples.
+//
+// The file is memory mapped and copied block by block into the
+// source queue, in the format it was recorded in. Supported are
+// raw files (format and sample rate set in the configuration), WAV
+// files with 2 channels (8 bit unsigned, 16 bit signed, or 32 bit
+// float), and SigMF recordings (cu8, ci8, ci16_le, or cf32_le).
+//
+// Samples are produced as fast as the demodulator consumes them,
+// or at a multiple of real time if a replay speed is set. At the
+// end of the file the queue is closed, so that the demodulator and
+// decoder drain their queues and exit.
+//
+class FileSource : public Source {
+public:
+  static std::unique_ptr<FileSource> open(const Config::File& config);
+
+  // Takes ownership of the mapping. Samples are
+  // stored at [offset, offset + size) of the file.
+  explicit FileSource(
+      void* map,
+      size_t mapSize,
+      size_t offset,
+      size_t size,
+      RawSamples::Format format,
+      uint32_t sampleRate);
+  ~FileSource();
+
+  void setSamplePublisher(std::unique_ptr<SamplePublisher> samplePublisher) {
+    samplePublisher_ = std::move(samplePublisher);
+  }
+
+  void setSpeed(float speed) {
+    speed_ = speed;
+  }
+
+  void setBlockSize(size_t blockSize) {
+    blockSize_ = blockSize;
+  }
+
+  virtual uint32_t getSampleRate() const override;
+
+  virtual void start(const std::shared_ptr<Queue<RawSamples> >& queue) override;
+
+  virtual void stop() override;
+
+protected:
+  void loop();
+
+  // Mapping of the whole file
+  void* map_;
+  size_t mapSize_;
+
+  // Sample data (excluding any header)
+  const uint8_t* data_;
+  size_t size_;
+
+  RawSamples::Format format_;
+  uint32_t sampleRate_;
+  float speed_;
+  size_t blockSize_;
+
+  std::thread thread_;
+  std::atomic<bool> stop_;
+
+  // Set on start; cleared on stop
+  std::shared_ptr<Queue<RawSamples> > queue_;
+
+  // Optional publisher for samples
+  std::unique_ptr<SamplePublisher> samplePublisher_;
+};
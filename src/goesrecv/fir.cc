@@ -0,0 +1,272 @@
+#include "fir.h"
+
+#include <algorithm>
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+#ifdef HAVE_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+#include <util/error.h>
+
+FIR::FIR(int decimation, const std::vector<float>& taps) :
+    decimation_(decimation) {
+  ASSERT(decimation_ > 0);
+  ASSERT(!taps.empty());
+
+  // Round number of taps up to a multiple of 4 (the vector width)
+  ntaps_ = (taps.size() + 3) & ~((size_t) 3);
+
+  // Reverse taps; padding ends up at the front (oldest samples)
+  taps_.resize(ntaps_, 0.0f);
+  std::reverse_copy(taps.begin(), taps.end(), taps_.end() - taps.size());
+
+  // Duplicate taps for vectorized x86 kernels
+  dupTaps_.resize(2 * ntaps_);
+  for (size_t i = 0; i < ntaps_; i++) {
+    dupTaps_[2 * i + 0] = taps_[i];
+    dupTaps_[2 * i + 1] = taps_[i];
+  }
+
+  // Seed the delay line with zeroes
+  history_.resize(ntaps_ - 1);
+  staging_.reserve(2 * ntaps_ + decimation_);
+}
+
+void FIR::work(
+    size_t nsamples,
+    const std::complex<float>* fi,
+    std::complex<float>* fo) {
+  ASSERT((nsamples % decimation_) == 0);
+  const size_t nhistory = history_.size();
+  const size_t noutputs = nsamples / decimation_;
+
+  // Number of outputs with a window that starts in the delay line
+  const size_t nstaging =
+    std::min(noutputs, (nhistory + decimation_ - 1) / decimation_);
+  if (nstaging > 0) {
+    const size_t nhead = std::min(
+      nsamples,
+      (nstaging - 1) * decimation_ + ntaps_ - nhistory);
+    staging_.assign(history_.begin(), history_.end());
+    staging_.insert(staging_.end(), fi, fi + nhead);
+    filter(nstaging, staging_.data(), fo);
+  }
+
+  // Remaining outputs read directly from the input
+  if (noutputs > nstaging) {
+    filter(
+      noutputs - nstaging,
+      fi + (nstaging * decimation_ - nhistory),
+      fo + nstaging);
+  }
+
+  // Keep final samples around for the next call
+  if (nsamples >= nhistory) {
+    std::copy(fi + nsamples - nhistory, fi + nsamples, history_.begin());
+  } else {
+    std::copy(history_.begin() + nsamples, history_.end(), history_.begin());
+    std::copy(fi, fi + nsamples, history_.end() - nsamples);
+  }
+}
+
+#ifdef __ARM_NEON
+
+void FIR::filter(
+    size_t noutputs,
+    const std::complex<float>* fi,
+    std::complex<float>* fo) {
+  const float* taps = taps_.data();
+  size_t i = 0;
+
+  // Compute 2 outputs at a time so that every tap is loaded once
+  // for both of them and the accumulators don't depend on each other.
+  for (; i + 2 <= noutputs; i += 2) {
+    const float* f0 = (const float*) &fi[(i + 0) * decimation_];
+    const float* f1 = (const float*) &fi[(i + 1) * decimation_];
+    float32x4x2_t acc0;
+    float32x4x2_t acc1;
+    acc0.val[0] = vdupq_n_f32(0.0f);
+    acc0.val[1] = vdupq_n_f32(0.0f);
+    acc1.val[0] = vdupq_n_f32(0.0f);
+    acc1.val[1] = vdupq_n_f32(0.0f);
+
+    for (size_t j = 0; j < ntaps_; j += 4) {
+      float32x4_t t = vld1q_f32(&taps[j]);
+      float32x4x2_t val0 = vld2q_f32(&f0[2 * j]);
+      float32x4x2_t val1 = vld2q_f32(&f1[2 * j]);
+      acc0.val[0] = vmlaq_f32(acc0.val[0], val0.val[0], t);
+      acc0.val[1] = vmlaq_f32(acc0.val[1], val0.val[1], t);
+      acc1.val[0] = vmlaq_f32(acc1.val[0], val1.val[0], t);
+      acc1.val[1] = vmlaq_f32(acc1.val[1], val1.val[1], t);
+    }
+
+    // Sum accumulators; lane 0 holds I, lane 1 holds Q
+    auto acc0i = vpadd_f32(vget_low_f32(acc0.val[0]), vget_high_f32(acc0.val[0]));
+    auto acc0q = vpadd_f32(vget_low_f32(acc0.val[1]), vget_high_f32(acc0.val[1]));
+    auto acc1i = vpadd_f32(vget_low_f32(acc1.val[0]), vget_high_f32(acc1.val[0]));
+    auto acc1q = vpadd_f32(vget_low_f32(acc1.val[1]), vget_high_f32(acc1.val[1]));
+    vst1_f32((float*) &fo[i + 0], vpadd_f32(acc0i, acc0q));
+    vst1_f32((float*) &fo[i + 1], vpadd_f32(acc1i, acc1q));
+  }
+
+  for (; i < noutputs; i++) {
+    const float* f = (const float*) &fi[i * decimation_];
+    float32x4x2_t acc;
+    acc.val[0] = vdupq_n_f32(0.0f);
+    acc.val[1] = vdupq_n_f32(0.0f);
+
+    for (size_t j = 0; j < ntaps_; j += 4) {
+      float32x4_t t = vld1q_f32(&taps[j]);
+      float32x4x2_t val = vld2q_f32(&f[2 * j]);
+      acc.val[0] = vmlaq_f32(acc.val[0], val.val[0], t);
+      acc.val[1] = vmlaq_f32(acc.val[1], val.val[1], t);
+    }
+
+    // Sum accumulators; lane 0 holds I, lane 1 holds Q
+    auto acci = vpadd_f32(vget_low_f32(acc.val[0]), vget_high_f32(acc.val[0]));
+    auto accq = vpadd_f32(vget_low_f32(acc.val[1]), vget_high_f32(acc.val[1]));
+    vst1_f32((float*) &fo[i], vpadd_f32(acci, accq));
+  }
+}
+
+#else
+
+void FIR::filter(
+    size_t noutputs,
+    const std::complex<float>* fi,
+    std::complex<float>* fo) {
+#ifdef HAVE_X86_DISPATCH
+  if (util::cpu::level() >= util::cpu::AVX2) {
+    filterAVX2(noutputs, fi, fo);
+    return;
+  }
+  if (util::cpu::level() >= util::cpu::SSE41) {
+    filterSSE41(noutputs, fi, fo);
+    return;
+  }
+#endif
+
+  for (size_t i = 0; i < noutputs; i++) {
+    const std::complex<float>* f = &fi[i * decimation_];
+    std::complex<float> acc = 0.0f;
+    for (size_t j = 0; j < ntaps_; j++) {
+      acc += f[j] * taps_[j];
+    }
+    fo[i] = acc;
+  }
+}
+
+#ifdef HAVE_X86_DISPATCH
+
+void FIR::filterSSE41(
+    size_t noutputs,
+    const std::complex<float>* fi,
+    std::complex<float>* fo) {
+  const float* taps = dupTaps_.data();
+  float* out = (float*) fo;
+  size_t i = 0;
+
+  // Compute 4 outputs at a time so that every tap is loaded once
+  // for all of them and the accumulators don't depend on each other.
+  // Every register holds 2 interleaved I/Q samples.
+  for (; i + 4 <= noutputs; i += 4) {
+    const float* f0 = (const float*) &fi[(i + 0) * decimation_];
+    const float* f1 = (const float*) &fi[(i + 1) * decimation_];
+    const float* f2 = (const float*) &fi[(i + 2) * decimation_];
+    const float* f3 = (const float*) &fi[(i + 3) * decimation_];
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    __m128 acc2 = _mm_setzero_ps();
+    __m128 acc3 = _mm_setzero_ps();
+
+    for (size_t j = 0; j < 2 * ntaps_; j += 4) {
+      __m128 t = _mm_loadu_ps(&taps[j]);
+      acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(&f0[j]), t));
+      acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(&f1[j]), t));
+      acc2 = _mm_add_ps(acc2, _mm_mul_ps(_mm_loadu_ps(&f2[j]), t));
+      acc3 = _mm_add_ps(acc3, _mm_mul_ps(_mm_loadu_ps(&f3[j]), t));
+    }
+
+    // Sum the two samples in every accumulator, two outputs at a time
+    __m128 out01 = _mm_add_ps(_mm_movelh_ps(acc0, acc1), _mm_movehl_ps(acc1, acc0));
+    __m128 out23 = _mm_add_ps(_mm_movelh_ps(acc2, acc3), _mm_movehl_ps(acc3, acc2));
+    _mm_storeu_ps(&out[2 * i + 0], out01);
+    _mm_storeu_ps(&out[2 * i + 4], out23);
+  }
+
+  for (; i < noutputs; i++) {
+    const float* f = (const float*) &fi[i * decimation_];
+    __m128 acc = _mm_setzero_ps();
+    for (size_t j = 0; j < 2 * ntaps_; j += 4) {
+      acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(&f[j]), _mm_loadu_ps(&taps[j])));
+    }
+
+    // Sum accumulator; I ends up in lane 0, Q in lane 1
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    _mm_storel_pi((__m64*) &out[2 * i], acc);
+  }
+}
+
+void FIR::filterAVX2(
+    size_t noutputs,
+    const std::complex<float>* fi,
+    std::complex<float>* fo) {
+  const float* taps = dupTaps_.data();
+  float* out = (float*) fo;
+  size_t i = 0;
+
+  // Compute 4 outputs at a time (see filterSSE41).
+  // Every register holds 4 interleaved I/Q samples.
+  for (; i + 4 <= noutputs; i += 4) {
+    const float* f0 = (const float*) &fi[(i + 0) * decimation_];
+    const float* f1 = (const float*) &fi[(i + 1) * decimation_];
+    const float* f2 = (const float*) &fi[(i + 2) * decimation_];
+    const float* f3 = (const float*) &fi[(i + 3) * decimation_];
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    __m256 acc2 = _mm256_setzero_ps();
+    __m256 acc3 = _mm256_setzero_ps();
+
+    for (size_t j = 0; j < 2 * ntaps_; j += 8) {
+      __m256 t = _mm256_loadu_ps(&taps[j]);
+      acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(&f0[j]), t, acc0);
+      acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(&f1[j]), t, acc1);
+      acc2 = _mm256_fmadd_ps(_mm256_loadu_ps(&f2[j]), t, acc2);
+      acc3 = _mm256_fmadd_ps(_mm256_loadu_ps(&f3[j]), t, acc3);
+    }
+
+    // Reduce to 2 samples per accumulator
+    __m128 s0 = _mm_add_ps(_mm256_castps256_ps128(acc0), _mm256_extractf128_ps(acc0, 1));
+    __m128 s1 = _mm_add_ps(_mm256_castps256_ps128(acc1), _mm256_extractf128_ps(acc1, 1));
+    __m128 s2 = _mm_add_ps(_mm256_castps256_ps128(acc2), _mm256_extractf128_ps(acc2, 1));
+    __m128 s3 = _mm_add_ps(_mm256_castps256_ps128(acc3), _mm256_extractf128_ps(acc3, 1));
+
+    // Sum the two samples in every accumulator, two outputs at a time
+    __m128 out01 = _mm_add_ps(_mm_movelh_ps(s0, s1), _mm_movehl_ps(s1, s0));
+    __m128 out23 = _mm_add_ps(_mm_movelh_ps(s2, s3), _mm_movehl_ps(s3, s2));
+    _mm_storeu_ps(&out[2 * i + 0], out01);
+    _mm_storeu_ps(&out[2 * i + 4], out23);
+  }
+
+  for (; i < noutputs; i++) {
+    const float* f = (const float*) &fi[i * decimation_];
+
+    __m256 acc = _mm256_setzero_ps();
+    for (size_t j = 0; j < 2 * ntaps_; j += 8) {
+      acc = _mm256_fmadd_ps(_mm256_loadu_ps(&f[j]), _mm256_loadu_ps(&taps[j]), acc);
+    }
+
+    // Sum accumulator; I ends up in lane 0, Q in lane 1
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    _mm_storel_pi((__m64*) &out[2 * i], s);
+  }
+}
+
+#endif
+
+#endif
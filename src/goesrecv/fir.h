@@ -0,0 +1,74 @@
+#pragma once
+
+#include <complex>
+#include <vector>
+
+#include <util/cpu.h>
+
+#include "types.h"
+
+// Decimating FIR filter with real valued taps.
+//
+// Only every decimation-th output is computed (this is equivalent to
+// the polyphase decomposition of the filter followed by summation).
+//
+// Input samples are read directly from the caller's buffer. The delay
+// line only holds the last ntaps - 1 samples of the previous call, so
+// the outputs that straddle two calls are computed from a small
+// staging buffer, and the cost of keeping state across calls does
+// not depend on the block size.
+//
+class FIR {
+public:
+  explicit FIR(int decimation, const std::vector<float>& taps);
+
+  // Filters nsamples input samples into nsamples / decimation output
+  // samples. The number of input samples must be a multiple of the
+  // decimation factor.
+  void work(
+      size_t nsamples,
+      const std::complex<float>* fi,
+      std::complex<float>* fo);
+
+  int getDecimation() const {
+    return decimation_;
+  }
+
+protected:
+  // Computes noutputs output samples; the window for output i starts
+  // at fi[i * decimation_] and spans ntaps_ input samples.
+  void filter(
+      size_t noutputs,
+      const std::complex<float>* fi,
+      std::complex<float>* fo);
+
+#ifdef HAVE_X86_DISPATCH
+  TARGET_SSE41 void filterSSE41(
+      size_t noutputs,
+      const std::complex<float>* fi,
+      std::complex<float>* fo);
+
+  TARGET_AVX2 void filterAVX2(
+      size_t noutputs,
+      const std::complex<float>* fi,
+      std::complex<float>* fo);
+#endif
+
+  int decimation_;
+
+  // Number of taps, rounded up to a multiple of 4
+  size_t ntaps_;
+
+  // Taps in reverse order, with zero padding at the front,
+  // such that output i is the dot product of the window and taps_.
+  std::vector<float> taps_;
+
+  // Every tap twice, to line up with interleaved I/Q
+  std::vector<float> dupTaps_;
+
+  // Last ntaps_ - 1 samples of the previous call
+  Samples history_;
+
+  // History followed by head of the current input
+  Samples staging_;
+};
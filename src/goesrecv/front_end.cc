@@ -0,0 +1,168 @@
+#include "front_end.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <util/error.h>
+
+#include "convert.h"
+
+namespace {
+
+// Windowed sinc low pass filter with cutoff frequency fc (in
+// cycles per sample), Blackman window, and unity gain at DC.
+std::vector<float> taps(int ntaps, double fc) {
+  std::vector<float> taps(ntaps);
+  double sum = 0.0;
+  for (int i = 0; i < ntaps; i++) {
+    const double t = i - (ntaps - 1) / 2.0;
+    const double x = 2 * M_PI * fc * t;
+    const double h = (t == 0) ? 1.0 : sin(x) / x;
+    const double w = 0.42
+      - 0.50 * cos((2 * M_PI * i) / (ntaps - 1))
+      + 0.08 * cos((4 * M_PI * i) / (ntaps - 1));
+    taps[i] = h * w;
+    sum += taps[i];
+  }
+
+  // Normalize
+  for (int i = 0; i < ntaps; i++) {
+    taps[i] /= sum;
+  }
+
+  return taps;
+}
+
+std::vector<float> lowPass(
+    int decimation,
+    int sampleRate,
+    int symbolRate,
+    float rollOff,
+    int ntaps) {
+  const double outputRate = (double) sampleRate / decimation;
+  const double bandwidth = symbolRate * (1.0 + rollOff);
+  ASSERTM(
+    outputRate > bandwidth,
+    "Front end decimation ", decimation,
+    " yields a sample rate below the signal bandwidth");
+
+  // Content above (outputRate - bandwidth / 2) aliases into the
+  // signal after decimation. The transition band ends there.
+  const double transition = (outputRate - bandwidth) / sampleRate;
+
+  // Number of taps for the Blackman window to
+  // reach its stopband attenuation in this band.
+  if (ntaps == 0) {
+    ntaps = (int) ceil(5.5 / transition) | 1;
+  }
+
+  return taps(ntaps, 0.5 / decimation);
+}
+
+} // namespace
+
+FrontEnd::FrontEnd(
+    int decimation,
+    int sampleRate,
+    int symbolRate,
+    float rollOff,
+    float frequencyOffset,
+    int ntaps,
+    size_t alignment) :
+    phase_(0.0),
+    freq_((-2 * M_PI * frequencyOffset) / sampleRate),
+    fir_(decimation, lowPass(decimation, sampleRate, symbolRate, rollOff, ntaps)),
+    alignment_(alignment) {
+  ASSERT(alignment_ > 0);
+  pending_.reserve(alignment_ * decimation);
+}
+
+void FrontEnd::translate(size_t nsamples, std::complex<float>* fi) {
+  if (freq_ == 0.0f) {
+    return;
+  }
+
+  // Compute the oscillator in short runs to bound the
+  // error of the phase computed for every sample.
+  constexpr size_t run = 64;
+  float cos[run];
+  float sin[run];
+  for (size_t i = 0; i < nsamples; i += run) {
+    const auto n = std::min(run, nsamples - i);
+    nco_.sincos(phase_, freq_, n, cos, sin);
+    // Expand the complex multiplication; operator* on std::complex
+    // has NaN handling that prevents vectorization.
+    for (size_t j = 0; j < n; j++) {
+      const float a = fi[i + j].real();
+      const float b = fi[i + j].imag();
+      fi[i + j] = std::complex<float>(
+        a * cos[j] - b * sin[j],
+        a * sin[j] + b * cos[j]);
+    }
+
+    phase_ = fmod(phase_ + n * (double) freq_, 2 * M_PI);
+  }
+}
+
+void FrontEnd::work(
+    const std::shared_ptr<Queue<RawSamples> >& qin,
+    const std::shared_ptr<Queue<RawSamples> >& qout) {
+  auto input = qin->popForRead();
+  if (!input) {
+    qout->close();
+    return;
+  }
+
+  const size_t chunk = alignment_ * fir_.getDecimation();
+  auto nsamples = input->size();
+  std::complex<float>* fi;
+  if (input->format == RawSamples::CF32) {
+    // Nothing reads the input buffer after this stage,
+    // so it can be translated in place.
+    fi = input->as<std::complex<float> >();
+  } else {
+    tmp_.resize(nsamples);
+    toFloat(*input, 0, nsamples, tmp_.data());
+    fi = tmp_.data();
+  }
+
+  translate(nsamples, fi);
+
+  auto output = qout->popForWrite();
+  output->timestamp = input->timestamp;
+  timestamp_ = input->timestamp;
+  output->resize(
+    RawSamples::CF32,
+    ((pending_.size() + nsamples) / chunk) * alignment_);
+  auto fo = output->as<std::complex<float> >();
+
+  // Complete the chunk that was started by the previous call
+  if (!pending_.empty()) {
+    const auto n = std::min(chunk - pending_.size(), nsamples);
+    pending_.insert(pending_.end(), fi, fi + n);
+    fi += n;
+    nsamples -= n;
+    if (pending_.size() == chunk) {
+      fir_.work(chunk, pending_.data(), fo);
+      fo += alignment_;
+      pending_.clear();
+    }
+  }
+
+  // Filter whole chunks straight from the input buffer
+  // (the filter keeps its own delay line)
+  const auto n = (nsamples / chunk) * chunk;
+  fir_.work(n, fi, fo);
+  pending_.insert(pending_.end(), fi + n, fi + nsamples);
+
+  // Return read buffer
+  qin->pushRead(std::move(input));
+
+  // Publish output if applicable
+  if (samplePublisher_) {
+    samplePublisher_->publish(*output);
+  }
+
+  // Return output buffer
+  qout->pushWrite(std::move(output));
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <memory>
+
+#include "fir.h"
+#include "nco.h"
+#include "sample_publisher.h"
+#include "types.h"
+
+// Frequency translating decimator.
+//
+// Optional first stage of the demodulator. It shifts the signal by a
+// fixed frequency offset, low pass filters it, and decimates it, so
+// that the AGC and the Costas loop run at a few samples per symbol
+// instead of at the sample rate of the source.
+//
+// The filter passes the signal bandwidth, symbolRate * (1 + rollOff),
+// and attenuates everything that would alias into it.
+//
+// Every output block holds a multiple of alignment samples, so that
+// the stages downstream can process 4 samples at a time and decimate
+// further. Input samples that don't make up a full multiple are kept
+// until the next call.
+//
+// Fixed point input is converted to float before it is translated.
+// The output is always float, but it is passed on as raw samples so
+// that the AGC reads the same queue type with or without this stage.
+//
+class FrontEnd {
+public:
+  explicit FrontEnd(
+      int decimation,
+      int sampleRate,
+      int symbolRate,
+      float rollOff,
+      float frequencyOffset,
+      int ntaps,
+      size_t alignment);
+
+  void setSamplePublisher(std::unique_ptr<SamplePublisher> samplePublisher) {
+    samplePublisher_ = std::move(samplePublisher);
+  }
+
+  const Timestamp& getTimestamp() const {
+    return timestamp_;
+  }
+
+  void work(
+      const std::shared_ptr<Queue<RawSamples> >& qin,
+      const std::shared_ptr<Queue<RawSamples> >& qout);
+
+protected:
+  // Shifts nsamples samples in place by the frequency offset
+  void translate(size_t nsamples, std::complex<float>* fi);
+
+  NCO nco_;
+
+  // Phase (double to avoid drift) and frequency in radians per sample
+  double phase_;
+  float freq_;
+
+  FIR fir_;
+
+  // Number of output samples in every chunk of input samples
+  size_t alignment_;
+
+  // Head of the next chunk of input samples
+  Samples pending_;
+
+  // Float copy of fixed point input
+  Samples tmp_;
+
+  std::unique_ptr<SamplePublisher> samplePublisher_;
+
+  // Of the most recent input block
+  Timestamp timestamp_;
+};
@@ -1,13 +1,18 @@
 #include <signal.h>
 
+#include <chrono>
 #include <iostream>
+#include <thread>
 
+#include "channelizer.h"
 #include "config.h"
 #include "decoder.h"
 #include "demodulator.h"
+#include "metrics_server.h"
 #include "monitor.h"
 #include "options.h"
 #include "publisher.h"
+#include "threads.h"
 
 static bool sigint = false;
 
@@ -16,10 +21,17 @@ static void signalHandler(int signum) {
   sigint = true;
 }
 
-int main(int argc, char** argv) {
-  auto opts = parseOptions(argc, argv);
-  auto config = Config::load(opts.config);
+// Demodulator and decoder for a single downlink
+struct Chain {
+  std::unique_ptr<Demodulator> demod;
+  std::unique_ptr<Decoder> decode;
+};
 
+static Chain createChain(
+    Config& config,
+    std::unique_ptr<Source> source,
+    std::shared_ptr<MetricRegistry> registry,
+    size_t channel) {
   // Convert string option to enum
   Demodulator::Type downlinkType;
   if (config.demodulator.downlinkType == "lrit") {
@@ -34,14 +46,57 @@ int main(int argc, char** argv) {
     exit(1);
   }
 
-  Demodulator demod(downlinkType);
-  demod.initialize(config);
+  const auto labels = formatLabels({{"channel", std::to_string(channel)}});
+  Chain chain;
+  chain.demod = std::make_unique<Demodulator>(downlinkType);
+  chain.demod->setMetrics(registry, labels);
+  chain.demod->initialize(config, std::move(source));
+  chain.decode = std::make_unique<Decoder>(chain.demod->getSoftBitsQueue());
+  chain.decode->setMetrics(registry, labels);
+  chain.decode->initialize(config);
+  return chain;
+}
+
+int main(int argc, char** argv) {
+  auto opts = parseOptions(argc, argv);
+  auto config = Config::load(opts.config);
+
+  // Before allocating buffers, so that they are faulted in on allocation
+  if (config.memory.lock) {
+    lockMemory();
+  }
+
+  // With additional channels, the source is shared by all of them.
+  // The top level configuration is the first channel.
+  std::vector<std::unique_ptr<Source> > sources;
+  sources.push_back(Source::build(config.demodulator.source, config));
+  if (!config.channels.empty()) {
+    sources = Channelizer::split(
+      std::move(sources[0]),
+      1 + config.channels.size(),
+      config.demodulator.sourceQueueDepth,
+      config.demodulator.sourceQueueOverflow);
+  }
 
-  Decoder decode(demod.getSoftBitsQueue());
-  decode.initialize(config);
+  // Metrics of all channels, labeled with the channel index
+  auto registry = std::make_shared<MetricRegistry>();
+  std::vector<Chain> chains;
+  chains.push_back(createChain(config, std::move(sources[0]), registry, 0));
+  for (size_t i = 0; i < config.channels.size(); i++) {
+    chains.push_back(createChain(
+      *config.channels[i], std::move(sources[i + 1]), registry, i + 1));
+  }
 
+  // Only the first channel is monitored
   Monitor monitor(opts.verbose, opts.interval);
-  monitor.initialize(config);
+  monitor.initialize(config, *chains[0].demod, *chains[0].decode);
+
+  // All channels are exposed on the metrics endpoint
+  std::unique_ptr<MetricsServer> metricsServer;
+  if (!config.monitor.metricsAddress.empty()) {
+    metricsServer = std::make_unique<MetricsServer>(
+      registry, config.monitor.metricsAddress);
+  }
 
   // Install signal handler
   struct sigaction sa;
@@ -51,17 +106,39 @@ int main(int argc, char** argv) {
   sigaction(SIGINT, &sa, NULL);
   sigaction(SIGTERM, &sa, NULL);
 
-  demod.start();
-  decode.start();
+  for (auto& chain : chains) {
+    chain.demod->start();
+    chain.decode->start();
+  }
   monitor.start();
+  if (metricsServer) {
+    metricsServer->start();
+  }
 
-  while (!sigint) {
-    pause();
+  // Run until interrupted, or until a source with a
+  // finite stream (a file) has been fully processed.
+  auto done = [&] {
+    for (const auto& chain : chains) {
+      if (!chain.decode->done()) {
+        return false;
+      }
+    }
+    return true;
+  };
+  while (!sigint && !done()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
   }
 
-  demod.stop();
-  decode.stop();
+  for (auto& chain : chains) {
+    chain.demod->stop();
+  }
+  for (auto& chain : chains) {
+    chain.decode->stop();
+  }
   monitor.stop();
+  if (metricsServer) {
+    metricsServer->stop();
+  }
 
   return 0;
 }
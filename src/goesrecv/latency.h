@@ -0,0 +1,71 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+// Histogram of latencies in power of two buckets, from 1us up.
+//
+// Bucket i counts latencies in [2^(i-1), 2^i) microseconds; the first
+// bucket also counts everything below 1us and the last bucket also
+// counts everything beyond its range. Recording is a few integer
+// operations, cheap enough to do for every block of samples.
+//
+class LatencyHistogram {
+public:
+  static constexpr int kBuckets = 32;
+
+  void record(int64_t ns) {
+    const uint64_t us = ns > 0 ? ns / 1000 : 0;
+    int i = 0;
+    if (us > 0) {
+      i = 64 - __builtin_clzll(us);
+      if (i >= kBuckets) {
+        i = kBuckets - 1;
+      }
+    }
+    buckets_[i]++;
+    count_++;
+    if (ns > max_) {
+      max_ = ns;
+    }
+  }
+
+  void merge(const LatencyHistogram& other) {
+    for (int i = 0; i < kBuckets; i++) {
+      buckets_[i] += other.buckets_[i];
+    }
+    count_ += other.count_;
+    if (other.max_ > max_) {
+      max_ = other.max_;
+    }
+  }
+
+  int64_t count() const {
+    return count_;
+  }
+
+  int64_t max() const {
+    return max_;
+  }
+
+  // Returns upper bound (in nanoseconds) of the bucket that holds
+  // the given percentile (0-100), capped at the maximum recorded
+  // latency, or 0 if nothing was recorded.
+  int64_t percentile(double p) const {
+    const double target = (p / 100.0) * count_;
+    int64_t n = 0;
+    for (int i = 0; i < kBuckets; i++) {
+      n += buckets_[i];
+      if (n > 0 && n >= target) {
+        return std::min((int64_t(1) << i) * 1000, max_);
+      }
+    }
+    return 0;
+  }
+
+protected:
+  std::array<int64_t, kBuckets> buckets_{};
+  int64_t count_ = 0;
+  int64_t max_ = 0;
+};
@@ -0,0 +1,288 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <util/error.h>
+
+#include "queue_stats.h"
+
+// Bounded ring of pointers for exactly one producer and one consumer.
+//
+// The producer only writes tail_ and the consumer only writes head_,
+// so neither side needs a lock or read-modify-write instruction.
+// The indices are kept on separate cache lines to avoid false sharing
+// between the producer and consumer cores.
+//
+template <class T>
+class SPSCRing {
+public:
+  explicit SPSCRing(size_t capacity) : head_(0), tail_(0) {
+    // Round up to power of 2 so we can mask instead of modulo
+    size_t size = 1;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    mask_ = size - 1;
+    slots_.resize(size, nullptr);
+  }
+
+  // Returns false if the ring is full
+  bool push(T* v) {
+    const auto tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) > mask_) {
+      return false;
+    }
+    slots_[tail & mask_] = v;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Number of items in the ring (exact only on the producer side)
+  size_t size() const {
+    return tail_.load(std::memory_order_relaxed) -
+      head_.load(std::memory_order_acquire);
+  }
+
+  // Returns nullptr if the ring is empty
+  T* pop() {
+    const auto head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    auto v = slots_[head & mask_];
+    head_.store(head + 1, std::memory_order_release);
+    return v;
+  }
+
+protected:
+  static constexpr size_t cacheLineSize = 64;
+
+  std::atomic<size_t> head_;
+  char headPad_[cacheLineSize - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t> tail_;
+  char tailPad_[cacheLineSize - sizeof(std::atomic<size_t>)];
+
+  size_t mask_;
+  std::vector<T*> slots_;
+};
+
+// Waiting strategy for the lock-free queue.
+//
+// Yield for a little while first, because the other side typically
+// makes progress in a matter of microseconds. If it doesn't, sleep
+// with exponential backoff (capped at 1ms) so that an idle stage
+// doesn't keep a core busy.
+//
+class Backoff {
+public:
+  Backoff() : spins_(0), sleep_(std::chrono::microseconds(10)) {
+  }
+
+  void wait() {
+    if (spins_ < 64) {
+      spins_++;
+      std::this_thread::yield();
+      return;
+    }
+
+    std::this_thread::sleep_for(sleep_);
+    if (sleep_ < std::chrono::microseconds(1000)) {
+      sleep_ *= 2;
+    }
+  }
+
+protected:
+  int spins_;
+  std::chrono::microseconds sleep_;
+};
+
+// Lock-free version of LockingQueue (see locking_queue.h).
+//
+// It has the same popForWrite/pushWrite/popForRead/pushRead contract,
+// but requires that there is a single producer thread (the one calling
+// popForWrite and pushWrite) and a single consumer thread (the one
+// calling popForRead and pushRead). This holds for every queue between
+// the goesrecv stages.
+//
+// Buffers travel from producer to consumer through the read ring,
+// and are returned from consumer to producer through the write ring.
+// Since there are never more than capacity buffers in flight,
+// neither ring can overflow.
+//
+// The producer cannot take buffers back from the read ring without
+// racing the consumer, so DROP_OLDEST is not supported (the
+// configuration rejects it when built with lock-free queues).
+//
+template <class T>
+class LockFreeQueue {
+public:
+  LockFreeQueue(size_t capacity, OverflowPolicy policy = OverflowPolicy::BLOCK) :
+      elements_(0),
+      capacity_(capacity),
+      policy_(policy),
+      closed_(false),
+      write_(capacity),
+      read_(capacity),
+      spareRaw_(nullptr),
+      dropped_(0),
+      highWater_(0),
+      blockedNs_(0) {
+    ASSERT(policy_ != OverflowPolicy::DROP_OLDEST);
+
+    // Allocate up front so that popForWrite never allocates
+    for (size_t i = 0; i < capacity_; i++) {
+      write_.push(new T());
+      elements_++;
+    }
+    if (policy_ != OverflowPolicy::BLOCK) {
+      spare_ = std::make_unique<T>();
+      spareRaw_ = spare_.get();
+    }
+  }
+
+  ~LockFreeQueue() {
+    T* v;
+    while ((v = write_.pop()) != nullptr) {
+      delete v;
+    }
+    while ((v = read_.pop()) != nullptr) {
+      delete v;
+    }
+  }
+
+  // Calls fn on every buffer (see LockingQueue::prefault).
+  // Must be called before the producer and consumer start.
+  template <typename Fn>
+  void prefault(Fn fn) {
+    std::vector<T*> tmp;
+    T* v;
+    while ((v = write_.pop()) != nullptr) {
+      fn(*v);
+      tmp.push_back(v);
+    }
+    for (auto v : tmp) {
+      write_.push(v);
+    }
+    if (spare_) {
+      fn(*spare_);
+    }
+  }
+
+  size_t size() {
+    return elements_.load();
+  }
+
+  bool closed() {
+    return closed_.load(std::memory_order_acquire);
+  }
+
+  QueueStats getStats() {
+    QueueStats stats;
+    stats.dropped = dropped_.load(std::memory_order_relaxed);
+    stats.highWater = highWater_.load(std::memory_order_relaxed);
+    stats.blockedNs = blockedNs_.load(std::memory_order_relaxed);
+    return stats;
+  }
+
+  void close() {
+    closed_.store(true, std::memory_order_release);
+  }
+
+  // popForWrite returns existing item to write to
+  std::unique_ptr<T> popForWrite() {
+    ASSERT(!closed());
+
+    auto v = write_.pop();
+    if (v == nullptr) {
+      // Discarded by pushWrite
+      if (policy_ != OverflowPolicy::BLOCK) {
+        ASSERT(spare_);
+        return std::move(spare_);
+      }
+
+      // Wait until pushRead makes an item available
+      const auto start = std::chrono::steady_clock::now();
+      Backoff backoff;
+      while ((v = write_.pop()) == nullptr) {
+        backoff.wait();
+      }
+      add(blockedNs_, std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+    }
+
+    return std::unique_ptr<T>(v);
+  }
+
+  // pushWrite returns written item to read queue
+  void pushWrite(std::unique_ptr<T> v) {
+    ASSERT(!closed());
+
+    if (v.get() == spareRaw_) {
+      spare_ = std::move(v);
+      add(dropped_, 1);
+      return;
+    }
+
+    auto ok = read_.push(v.release());
+    ASSERT(ok);
+
+    const int64_t size = read_.size();
+    if (size > highWater_.load(std::memory_order_relaxed)) {
+      highWater_.store(size, std::memory_order_relaxed);
+    }
+  }
+
+  // popForRead returns existing item to read from
+  std::unique_ptr<T> popForRead() {
+    Backoff backoff;
+    for (;;) {
+      auto v = read_.pop();
+      if (v != nullptr) {
+        return std::unique_ptr<T>(v);
+      }
+
+      // Allow read side to drain. The producer pushes its final item
+      // before closing, so check the ring once more after observing
+      // that the queue has closed.
+      if (closed()) {
+        return std::unique_ptr<T>(read_.pop());
+      }
+
+      backoff.wait();
+    }
+  }
+
+  // pushRead returns read item to write queue
+  void pushRead(std::unique_ptr<T> v) {
+    if (!closed()) {
+      auto ok = write_.push(v.release());
+      ASSERT(ok);
+    }
+  }
+
+protected:
+  // Counters are only written by the producer
+  static void add(std::atomic<int64_t>& counter, int64_t v) {
+    counter.store(counter.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+  }
+
+  std::atomic<size_t> elements_;
+  const size_t capacity_;
+  const OverflowPolicy policy_;
+  std::atomic<bool> closed_;
+
+  SPSCRing<T> write_;
+  SPSCRing<T> read_;
+
+  // Buffer for blocks that are dropped (only used by the producer)
+  std::unique_ptr<T> spare_;
+  T* spareRaw_;
+
+  std::atomic<int64_t> dropped_;
+  std::atomic<int64_t> highWater_;
+  std::atomic<int64_t> blockedNs_;
+};
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+
+#include <util/error.h>
+
+#include "queue_stats.h"
+
+template <class T>
+class LockingQueue {
+public:
+  LockingQueue(size_t capacity, OverflowPolicy policy = OverflowPolicy::BLOCK) :
+      elements_(0),
+      capacity_(capacity),
+      policy_(policy),
+      closed_(false),
+      spareRaw_(nullptr) {
+    // Allocate up front so that popForWrite never allocates
+    for (; elements_ < capacity_; elements_++) {
+      write_.push_back(std::make_unique<T>());
+    }
+    if (policy_ == OverflowPolicy::DROP_NEWEST) {
+      spare_ = std::make_unique<T>();
+      spareRaw_ = spare_.get();
+    }
+  }
+
+  // Calls fn on every buffer, for example to size the buffers for the
+  // blocks the producer writes and touch their memory, so that the
+  // producer doesn't allocate or page fault when it first fills them.
+  // Must be called before the producer and consumer start.
+  template <typename Fn>
+  void prefault(Fn fn) {
+    std::unique_lock<std::mutex> lock(m_);
+    for (auto& v : write_) {
+      fn(*v);
+    }
+    if (spare_) {
+      fn(*spare_);
+    }
+  }
+
+  size_t size() {
+    std::unique_lock<std::mutex> lock(m_);
+    return elements_;
+  }
+
+  bool closed() {
+    std::unique_lock<std::mutex> lock(m_);
+    return closed_;
+  }
+
+  QueueStats getStats() {
+    std::unique_lock<std::mutex> lock(m_);
+    return stats_;
+  }
+
+  void close() {
+    std::unique_lock<std::mutex> lock(m_);
+    closed_ = true;
+    cv_.notify_one();
+  }
+
+  // popForWrite returns existing item to write to
+  std::unique_ptr<T> popForWrite() {
+    std::unique_lock<std::mutex> lock(m_);
+    ASSERT(!closed_);
+
+    // Ensure there is an item to return
+    if (write_.size() == 0) {
+      if (policy_ == OverflowPolicy::DROP_OLDEST && read_.size() > 0) {
+        write_.push_back(std::move(read_.front()));
+        read_.pop_front();
+        stats_.dropped++;
+      } else if (policy_ == OverflowPolicy::DROP_NEWEST) {
+        // Discarded by pushWrite
+        ASSERT(spare_);
+        return std::move(spare_);
+      } else {
+        // Wait until pushRead makes an item available
+        const auto start = std::chrono::steady_clock::now();
+        while (write_.size() == 0) {
+          cv_.wait(lock);
+        }
+        stats_.blockedNs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start).count();
+      }
+    }
+
+    auto v = std::move(write_.front());
+    write_.pop_front();
+    return v;
+  }
+
+  // pushWrite returns written item to read queue
+  void pushWrite(std::unique_ptr<T> v) {
+    std::unique_lock<std::mutex> lock(m_);
+    ASSERT(!closed_);
+
+    if (v.get() == spareRaw_) {
+      spare_ = std::move(v);
+      stats_.dropped++;
+      return;
+    }
+
+    read_.push_back(std::move(v));
+    if ((int64_t) read_.size() > stats_.highWater) {
+      stats_.highWater = read_.size();
+    }
+    cv_.notify_one();
+  }
+
+  // popForRead returns existing item to read from
+  std::unique_ptr<T> popForRead() {
+    std::unique_lock<std::mutex> lock(m_);
+    while (read_.size() == 0 && !closed_) {
+      cv_.wait(lock);
+    }
+
+    // Allow read side to drain
+    if (read_.size() == 0 && closed_) {
+      return std::unique_ptr<T>(nullptr);
+    }
+
+    auto v = std::move(read_.front());
+    read_.pop_front();
+    return v;
+  }
+
+  // pushRead returns read item to write queue
+  void pushRead(std::unique_ptr<T> v) {
+    std::unique_lock<std::mutex> lock(m_);
+    if (!closed_) {
+      write_.push_back(std::move(v));
+      cv_.notify_one();
+    }
+  }
+
+protected:
+  std::mutex m_;
+  std::condition_variable cv_;
+
+  size_t elements_;
+  size_t capacity_;
+  OverflowPolicy policy_;
+  bool closed_;
+  QueueStats stats_;
+
+  std::deque<std::unique_ptr<T> > write_;
+  std::deque<std::unique_ptr<T> > read_;
+
+  // Buffer for blocks that are dropped (see DROP_NEWEST)
+  std::unique_ptr<T> spare_;
+  T* spareRaw_;
+};
@@ -0,0 +1,199 @@
+#include "metrics.h"
+
+#include <cmath>
+#include <sstream>
+
+#include <util/error.h>
+
+namespace {
+
+// Prometheus spells special values differently than iostreams
+void writeValue(std::ostream& os, double v) {
+  if (std::isnan(v)) {
+    os << "NaN";
+  } else if (std::isinf(v)) {
+    os << (v > 0 ? "+Inf" : "-Inf");
+  } else {
+    os << v;
+  }
+}
+
+void writeSample(
+    std::ostream& os,
+    const std::string& name,
+    const std::string& labels) {
+  os << name;
+  if (!labels.empty()) {
+    os << "{" << labels << "}";
+  }
+  os << " ";
+}
+
+} // namespace
+
+void Counter::write(
+    std::ostream& os,
+    const std::string& name,
+    const std::string& labels) const {
+  writeSample(os, name, labels);
+  os << value() << "\n";
+}
+
+void Gauge::write(
+    std::ostream& os,
+    const std::string& name,
+    const std::string& labels) const {
+  writeSample(os, name, labels);
+  writeValue(os, value());
+  os << "\n";
+}
+
+Histogram::Histogram(std::vector<double> bounds)
+    : bounds_(std::move(bounds)),
+      buckets_(new std::atomic<int64_t>[bounds_.size() + 1]) {
+  ASSERT(std::is_sorted(bounds_.begin(), bounds_.end()));
+  for (size_t i = 0; i <= bounds_.size(); i++) {
+    buckets_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+Histogram::Snapshot Histogram::snapshot() const {
+  Snapshot out;
+  out.buckets.resize(bounds_.size() + 1);
+  for (size_t i = 0; i <= bounds_.size(); i++) {
+    out.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+    out.count += out.buckets[i];
+  }
+  out.sum = sum_.load(std::memory_order_relaxed);
+  return out;
+}
+
+Histogram::Snapshot Histogram::Snapshot::operator-(const Snapshot& other) const {
+  Snapshot out = *this;
+  if (other.buckets.size() == buckets.size()) {
+    for (size_t i = 0; i < buckets.size(); i++) {
+      out.buckets[i] -= other.buckets[i];
+    }
+    out.count -= other.count;
+    out.sum -= other.sum;
+  }
+  return out;
+}
+
+void Histogram::write(
+    std::ostream& os,
+    const std::string& name,
+    const std::string& labels) const {
+  const auto snap = snapshot();
+  const auto prefix = labels.empty() ? std::string() : labels + ",";
+  int64_t cumulative = 0;
+  for (size_t i = 0; i <= bounds_.size(); i++) {
+    std::stringstream le;
+    le << prefix << "le=\"";
+    writeValue(le, i < bounds_.size() ? bounds_[i] : INFINITY);
+    le << "\"";
+    cumulative += snap.buckets[i];
+    writeSample(os, name + "_bucket", le.str());
+    os << cumulative << "\n";
+  }
+  writeSample(os, name + "_sum", labels);
+  writeValue(os, snap.sum);
+  os << "\n";
+  writeSample(os, name + "_count", labels);
+  os << cumulative << "\n";
+}
+
+void CallbackMetric::write(
+    std::ostream& os,
+    const std::string& name,
+    const std::string& labels) const {
+  writeSample(os, name, labels);
+  writeValue(os, fn_());
+  os << "\n";
+}
+
+Counter& MetricRegistry::counter(
+    const std::string& name,
+    const std::string& help,
+    const std::string& labels) {
+  return static_cast<Counter&>(
+    add(name, help, "counter", labels, std::make_unique<Counter>()));
+}
+
+Gauge& MetricRegistry::gauge(
+    const std::string& name,
+    const std::string& help,
+    const std::string& labels) {
+  return static_cast<Gauge&>(
+    add(name, help, "gauge", labels, std::make_unique<Gauge>()));
+}
+
+Histogram& MetricRegistry::histogram(
+    const std::string& name,
+    const std::string& help,
+    std::vector<double> bounds,
+    const std::string& labels) {
+  return static_cast<Histogram&>(
+    add(name, help, "histogram", labels,
+        std::make_unique<Histogram>(std::move(bounds))));
+}
+
+void MetricRegistry::callback(
+    const std::string& name,
+    const std::string& help,
+    const std::string& type,
+    const std::string& labels,
+    std::function<double()> fn) {
+  ASSERT(type == "counter" || type == "gauge");
+  add(name, help, type, labels, std::make_unique<CallbackMetric>(std::move(fn)));
+}
+
+Metric& MetricRegistry::add(
+    const std::string& name,
+    const std::string& help,
+    const std::string& type,
+    const std::string& labels,
+    std::unique_ptr<Metric> metric) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (const auto& entry : entries_) {
+    ASSERTM(entry.name != name || entry.labels != labels, name);
+    ASSERTM(entry.name != name || entry.type == type, name);
+  }
+  entries_.push_back(Entry{name, help, type, labels, std::move(metric)});
+  return *entries_.back().metric;
+}
+
+void MetricRegistry::write(std::ostream& os) {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  // Samples of a name must be adjacent (in order of registration)
+  std::vector<const Entry*> entries;
+  for (const auto& entry : entries_) {
+    entries.push_back(&entry);
+  }
+  std::stable_sort(
+    entries.begin(),
+    entries.end(),
+    [] (const Entry* a, const Entry* b) { return a->name < b->name; });
+
+  const std::string* name = nullptr;
+  for (const auto entry : entries) {
+    if (!name || *name != entry->name) {
+      name = &entry->name;
+      os << "# HELP " << entry->name << " " << entry->help << "\n";
+      os << "# TYPE " << entry->name << " " << entry->type << "\n";
+    }
+    entry->metric->write(os, entry->name, entry->labels);
+  }
+}
+
+std::string formatLabels(
+    const std::vector<std::pair<std::string, std::string> >& labels) {
+  std::stringstream ss;
+  const char* sep = "";
+  for (const auto& label : labels) {
+    ss << sep << label.first << "=\"" << label.second << "\"";
+    sep = ",";
+  }
+  return ss.str();
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Base class for everything in a MetricRegistry. Metrics are written
+// by the threads doing the work, without locks or allocations, and
+// read concurrently when they are exported.
+class Metric {
+public:
+  virtual ~Metric() {}
+
+  // Writes samples in Prometheus text format
+  virtual void write(
+      std::ostream& os,
+      const std::string& name,
+      const std::string& labels) const = 0;
+};
+
+class Counter : public Metric {
+public:
+  void add(int64_t v = 1) {
+    value_.fetch_add(v, std::memory_order_relaxed);
+  }
+
+  int64_t value() const {
+    return value_.load(std::memory_order_relaxed);
+  }
+
+  virtual void write(
+      std::ostream& os,
+      const std::string& name,
+      const std::string& labels) const override;
+
+protected:
+  std::atomic<int64_t> value_{0};
+};
+
+class Gauge : public Metric {
+public:
+  void set(double v) {
+    value_.store(v, std::memory_order_relaxed);
+  }
+
+  double value() const {
+    return value_.load(std::memory_order_relaxed);
+  }
+
+  virtual void write(
+      std::ostream& os,
+      const std::string& name,
+      const std::string& labels) const override;
+
+protected:
+  std::atomic<double> value_{0.0};
+};
+
+// Histogram with fixed buckets, given by their (inclusive) upper
+// bounds in ascending order. Values beyond the last bound are only
+// counted in the implicit +Inf bucket.
+class Histogram : public Metric {
+public:
+  struct Snapshot {
+    // Count per bucket (not cumulative); the last one is +Inf
+    std::vector<int64_t> buckets;
+    int64_t count = 0;
+    double sum = 0.0;
+
+    // Difference with an earlier snapshot of the same histogram
+    Snapshot operator-(const Snapshot& other) const;
+
+    double mean() const {
+      return count > 0 ? sum / count : 0.0;
+    }
+  };
+
+  explicit Histogram(std::vector<double> bounds);
+
+  void observe(double v) {
+    const auto it = std::lower_bound(bounds_.begin(), bounds_.end(), v);
+    buckets_[it - bounds_.begin()].fetch_add(1, std::memory_order_relaxed);
+    auto sum = sum_.load(std::memory_order_relaxed);
+    while (!sum_.compare_exchange_weak(sum, sum + v, std::memory_order_relaxed)) {
+    }
+  }
+
+  const std::vector<double>& bounds() const {
+    return bounds_;
+  }
+
+  Snapshot snapshot() const;
+
+  virtual void write(
+      std::ostream& os,
+      const std::string& name,
+      const std::string& labels) const override;
+
+protected:
+  const std::vector<double> bounds_;
+  std::unique_ptr<std::atomic<int64_t>[]> buckets_;
+  std::atomic<double> sum_{0.0};
+};
+
+// Metric whose value is read from elsewhere when it is exported
+// (e.g. counters that a queue keeps itself).
+class CallbackMetric : public Metric {
+public:
+  explicit CallbackMetric(std::function<double()> fn) : fn_(std::move(fn)) {
+  }
+
+  virtual void write(
+      std::ostream& os,
+      const std::string& name,
+      const std::string& labels) const override;
+
+protected:
+  std::function<double()> fn_;
+};
+
+// Set of named metrics, exported in Prometheus text format.
+//
+// Metrics are registered at initialization and live as long as the
+// registry, so the references that are returned can be kept and
+// written to without going through the registry. Labels are given
+// preformatted (e.g. "channel=\"0\",stage=\"agc\"").
+//
+class MetricRegistry {
+public:
+  Counter& counter(
+      const std::string& name,
+      const std::string& help,
+      const std::string& labels = "");
+
+  Gauge& gauge(
+      const std::string& name,
+      const std::string& help,
+      const std::string& labels = "");
+
+  Histogram& histogram(
+      const std::string& name,
+      const std::string& help,
+      std::vector<double> bounds,
+      const std::string& labels = "");
+
+  // Type is "counter" or "gauge"
+  void callback(
+      const std::string& name,
+      const std::string& help,
+      const std::string& type,
+      const std::string& labels,
+      std::function<double()> fn);
+
+  // Writes all metrics, grouped by name
+  void write(std::ostream& os);
+
+protected:
+  struct Entry {
+    std::string name;
+    std::string help;
+    std::string type;
+    std::string labels;
+    std::unique_ptr<Metric> metric;
+  };
+
+  Metric& add(
+      const std::string& name,
+      const std::string& help,
+      const std::string& type,
+      const std::string& labels,
+      std::unique_ptr<Metric> metric);
+
+  std::mutex mutex_;
+  std::vector<Entry> entries_;
+};
+
+// Joins label names and values into the format used above
+std::string formatLabels(
+    const std::vector<std::pair<std::string, std::string> >& labels);
@@ -0,0 +1,183 @@
+#include "metrics_server.h"
+
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include "threads.h"
+
+// Not available on macOS, which uses SO_NOSIGPIPE instead (see below)
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace {
+
+void throwSocketError(const std::string& address, const std::string& what) {
+  std::stringstream ss;
+  ss << "Unable to serve metrics on " << address << ": " << what;
+  throw std::runtime_error(ss.str());
+}
+
+bool sendAll(int fd, const std::string& data) {
+  size_t pos = 0;
+  while (pos < data.size()) {
+    auto rv = send(fd, data.data() + pos, data.size() - pos, MSG_NOSIGNAL);
+    if (rv < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    pos += rv;
+  }
+  return true;
+}
+
+std::string response(const std::string& status, const std::string& body) {
+  std::stringstream ss;
+  ss << "HTTP/1.0 " << status << "\r\n";
+  ss << "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n";
+  ss << "Content-Length: " << body.size() << "\r\n";
+  ss << "Connection: close\r\n";
+  ss << "\r\n";
+  ss << body;
+  return ss.str();
+}
+
+} // namespace
+
+MetricsServer::MetricsServer(
+    std::shared_ptr<MetricRegistry> registry,
+    const std::string& address)
+    : registry_(std::move(registry)),
+      fd_(-1),
+      stop_(false) {
+  std::string host = address;
+  std::string port;
+  const auto pos = address.rfind(':');
+  if (pos != std::string::npos) {
+    host = address.substr(0, pos);
+    port = address.substr(pos + 1);
+  }
+  if (host.empty()) {
+    host = "localhost";
+  }
+  if (port.empty()) {
+    throwSocketError(address, "no port");
+  }
+
+  struct addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+  struct addrinfo* res = nullptr;
+  auto rv = getaddrinfo(host.c_str(), port.c_str(), &hints, &res);
+  if (rv != 0) {
+    throwSocketError(address, gai_strerror(rv));
+  }
+
+  fd_ = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+  if (fd_ < 0) {
+    freeaddrinfo(res);
+    throwSocketError(address, strerror(errno));
+  }
+
+  int one = 1;
+  setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+#ifdef SO_NOSIGPIPE
+  setsockopt(fd_, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+  rv = bind(fd_, res->ai_addr, res->ai_addrlen);
+  freeaddrinfo(res);
+  if (rv < 0 || listen(fd_, 4) < 0) {
+    const auto err = errno;
+    close(fd_);
+    throwSocketError(address, strerror(err));
+  }
+}
+
+MetricsServer::~MetricsServer() {
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+void MetricsServer::start() {
+  thread_ = std::thread(&MetricsServer::loop, this);
+  setThreadName(thread_, "metrics");
+}
+
+void MetricsServer::stop() {
+  stop_ = true;
+  thread_.join();
+}
+
+void MetricsServer::loop() {
+  lowerCurrentThreadPriority();
+
+  struct pollfd pfd;
+  pfd.fd = fd_;
+  pfd.events = POLLIN;
+  while (!stop_) {
+    // Wake up regularly to check if we should stop
+    auto rv = poll(&pfd, 1, 100);
+    if (rv <= 0) {
+      continue;
+    }
+
+    auto fd = accept(fd_, nullptr, nullptr);
+    if (fd < 0) {
+      continue;
+    }
+
+    // Don't let a client that doesn't send anything block the loop
+    struct timeval tv;
+    tv.tv_sec = 1;
+    tv.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    handle(fd);
+    close(fd);
+  }
+}
+
+void MetricsServer::handle(int fd) {
+  // Only the request line matters; read until the end of the headers
+  std::string request;
+  char buf[1024];
+  while (request.find("\r\n\r\n") == std::string::npos &&
+         request.find("\n\n") == std::string::npos &&
+         request.size() < 8192) {
+    auto rv = recv(fd, buf, sizeof(buf), 0);
+    if (rv <= 0) {
+      break;
+    }
+    request.append(buf, rv);
+  }
+
+  std::stringstream ss(request);
+  std::string method;
+  std::string path;
+  ss >> method >> path;
+  if (method != "GET") {
+    sendAll(fd, response("405 Method Not Allowed", "Method not allowed\n"));
+    return;
+  }
+  if (path != "/metrics") {
+    sendAll(fd, response("404 Not Found", "Not found\n"));
+    return;
+  }
+
+  std::stringstream body;
+  registry_->write(body);
+  sendAll(fd, response("200 OK", body.str()));
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "metrics.h"
+
+// Minimal HTTP server that exposes a metric registry on /metrics,
+// in the Prometheus text format.
+//
+// Requests are handled one at a time on a single low priority thread,
+// so a scrape never takes time away from the demodulator or decoder
+// threads beyond reading their atomics.
+//
+class MetricsServer {
+public:
+  // Address is "host:port" (e.g. "127.0.0.1:6003")
+  explicit MetricsServer(
+      std::shared_ptr<MetricRegistry> registry,
+      const std::string& address);
+  ~MetricsServer();
+
+  void start();
+  void stop();
+
+protected:
+  void loop();
+  void handle(int fd);
+
+  std::shared_ptr<MetricRegistry> registry_;
+  int fd_;
+
+  std::atomic<bool> stop_;
+  std::thread thread_;
+};
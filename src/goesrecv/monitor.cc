@@ -7,44 +7,10 @@
 #include <sstream>
 #include <stdexcept>
 
-#include <nanomsg/nn.h>
-#include <nanomsg/pubsub.h>
-#include <nlohmann/json.hpp>
 #include <pthread.h>
 
-using namespace nlohmann;
-
 namespace {
 
-int connect(const std::string& endpoint) {
-  auto fd = nn_socket(AF_SP, NN_SUB);
-  if (fd < 0) {
-    std::stringstream ss;
-    ss << "nn_socket: " << nn_strerror(nn_errno());
-    throw std::runtime_error(ss.str());
-  }
-
-  auto rv = nn_connect(fd, endpoint.c_str());
-  if (rv < 0) {
-    nn_close(fd);
-    std::stringstream ss;
-    ss << "nn_connect: " << nn_strerror(nn_errno());
-    ss << " (" << endpoint << ")";
-    throw std::runtime_error(ss.str());
-  }
-
-  rv = nn_setsockopt(fd, NN_SUB, NN_SUB_SUBSCRIBE, "", 0);
-  if (rv < 0) {
-    nn_close(fd);
-    std::stringstream ss;
-    ss << "nn_setsockopt: " << nn_strerror(nn_errno());
-    ss << " (" << endpoint << ")";
-    throw std::runtime_error(ss.str());
-  }
-
-  return fd;
-}
-
 template <typename T>
 T sum(const std::vector<T>& vs) {
   T r = 0;
@@ -67,40 +33,17 @@ T avg(const std::vector<T>& vs) {
 Monitor::Monitor(bool verbose, std::chrono::milliseconds interval)
     : verbose_(verbose),
       interval_(interval),
+      demod_(nullptr),
+      decode_(nullptr),
       stop_(false) {
 }
 
 Monitor::~Monitor() {
 }
 
-void Monitor::initialize(Config& config) {
-  const std::string inprocPrefix = "inproc://";
-
-  // Connect to demodulator stats publisher
-  std::string demodulatorEndpoint;
-  for (const auto& endpoint : config.demodulator.statsPublisher.bind) {
-    if (endpoint.compare(0, inprocPrefix.size(), inprocPrefix) == 0) {
-      demodulatorEndpoint = endpoint;
-      break;
-    }
-  }
-  if (demodulatorEndpoint.size() == 0) {
-    throw std::runtime_error("no demodulator stats endpoint");
-  }
-  demodulatorFd_ = connect(demodulatorEndpoint);
-
-  // Connect to decoder stats publisher
-  std::string decoderEndpoint;
-  for (const auto& endpoint : config.decoder.statsPublisher.bind) {
-    if (endpoint.compare(0, inprocPrefix.size(), inprocPrefix) == 0) {
-      decoderEndpoint = endpoint;
-      break;
-    }
-  }
-  if (decoderEndpoint.size() == 0) {
-    throw std::runtime_error("no decoder stats endpoint");
-  }
-  decoderFd_ = connect(decoderEndpoint);
+void Monitor::initialize(Config& config, Demodulator& demod, Decoder& decode) {
+  demod_ = &demod;
+  decode_ = &decode;
 
   // Create statsd socket if one is configured
   const auto& statsdAddress = config.monitor.statsdAddress;
@@ -109,121 +52,110 @@ void Monitor::initialize(Config& config) {
   }
 }
 
+Monitor::Totals Monitor::totals() {
+  const auto& decoder = decode_->getMetrics();
+  Totals out;
+  out.ok = decoder.ok->value();
+  out.dropped = decoder.dropped->value();
+  out.saved = decoder.saved->value();
+  out.viterbiErrors = decoder.viterbiErrors->snapshot();
+  out.reedSolomonErrors = decoder.reedSolomonErrors->snapshot();
+  out.packetLatency = decoder.packetLatency->snapshot();
+  for (const auto& it : demod_->getStageStats()) {
+    out.latency[it.first] = it.second.latencyMetric->snapshot();
+  }
+  return out;
+}
+
 void Monitor::loop() {
-  struct nn_pollfd pfd[2];
-  pfd[0].fd = demodulatorFd_;
-  pfd[0].events = NN_POLLIN;
-  pfd[1].fd = decoderFd_;
-  pfd[1].events = NN_POLLIN;
+  // Gauges are sampled at this interval and averaged
+  const auto sampleInterval = std::chrono::milliseconds(100);
 
+  auto last = totals();
   auto start = std::chrono::steady_clock::now();
+  auto next = start;
   while (!stop_) {
-    auto delta = std::chrono::duration_cast<std::chrono::milliseconds>(
-      std::chrono::steady_clock::now() - start);
-    if (delta >= interval_) {
-      Stats tmp;
-      std::swap(tmp, stats_);
-      if (verbose_) {
-        print(tmp);
-      }
-      start += interval_;
+    const auto& demodulator = demod_->getMetrics();
+    stats_.gain.push_back(demodulator.gain->value());
+    stats_.frequency.push_back(demodulator.frequency->value());
+    stats_.omega.push_back(demodulator.omega->value());
+
+    next += sampleInterval;
+    std::this_thread::sleep_until(next);
+    if (std::chrono::steady_clock::now() - start < interval_) {
       continue;
     }
 
-    const auto timeout = (interval_ - delta).count() + 1;
-    auto rv = nn_poll(pfd, 2, timeout);
-    if (rv == 0) {
-      continue;
+    // Counters and histograms over the last interval
+    auto now = totals();
+    stats_.totalOK = now.ok - last.ok;
+    stats_.totalDropped = now.dropped - last.dropped;
+    stats_.totalSaved = now.saved - last.saved;
+    stats_.viterbiErrors = now.viterbiErrors - last.viterbiErrors;
+    stats_.reedSolomonErrors = now.reedSolomonErrors - last.reedSolomonErrors;
+    stats_.packetLatency = now.packetLatency - last.packetLatency;
+    for (const auto& it : now.latency) {
+      stats_.latency[it.first] = it.second - last.latency[it.first];
     }
+    for (const auto& it : demod_->getQueueStats()) {
+      stats_.queueDropped += it.second.dropped;
+      stats_.queues[it.first] = it.second;
+    }
+    last = std::move(now);
 
-    for (auto i = 0; i < 2; i++) {
-      if (!(pfd[i].revents & NN_POLLIN)) {
-        continue;
-      }
-
-      char* buf = nullptr;
-      rv = nn_recv(pfd[i].fd, &buf, NN_MSG, 0);
-      if (rv < 0) {
-        // Either fd is closed; terminate
-        return;
-      }
-
-      process(std::string(buf, rv));
-
-      // Processed message; free nanomsg buffer
-      nn_freemsg(buf);
+    Stats tmp;
+    std::swap(tmp, stats_);
+    if (statsd_) {
+      send(tmp);
+    }
+    if (verbose_) {
+      print(tmp);
     }
+    start += interval_;
   }
 }
 
-void Monitor::process(const std::string& json) {
-  std::string error;
-  auto data = json::parse(json);
-  if (!error.empty()) {
-    throw new std::runtime_error(error);
-  }
-
-  // Accumulate statsd compatible payload
+void Monitor::send(const Stats& stats) {
   std::stringstream statsd;
 
-  for (json::iterator it = data.begin(); it != data.end(); ++it) {
-    const auto& key = it.key();
-    const auto& value = it.value();
-
-    if (key == "gain") {
-      stats_.gain.push_back(value.get<double>());
-      statsd << key << ":" << value.get<double>() << "|g" << std::endl;
-      continue;
-    }
-
-    if (key == "frequency") {
-      stats_.frequency.push_back(value.get<double>());
-      // First set to 0 to support negative values.
-      // See: https://github.com/etsy/statsd/blob/master/docs/metric_types.md#gauges
-      statsd << key << ":0|g" << std::endl;
-      statsd << key << ":" << value.get<double>() << "|g" << std::endl;
-      continue;
-    }
+  statsd << "gain:" << avg(stats.gain) << "|g" << std::endl;
+  // First set to 0 to support negative values.
+  // See: https://github.com/etsy/statsd/blob/master/docs/metric_types.md#gauges
+  statsd << "frequency:0|g" << std::endl;
+  statsd << "frequency:" << avg(stats.frequency) << "|g" << std::endl;
+  statsd << "omega:" << avg(stats.omega) << "|g" << std::endl;
 
-    if (key == "omega") {
-      stats_.omega.push_back(value.get<double>());
-      statsd << key << ":" << value.get<double>() << "|g" << std::endl;
-      continue;
-    }
+  statsd << "packets_ok:" << stats.totalOK << "|c" << std::endl;
+  statsd << "packets_dropped:" << stats.totalDropped << "|c" << std::endl;
+  statsd << "packets_saved:" << stats.totalSaved << "|c" << std::endl;
 
-    if (key == "viterbi_errors") {
-      stats_.viterbiErrors.push_back(value.get<int>());
-      statsd << key << ":" << value.get<int>() << "|h" << std::endl;
-      continue;
-    }
-
-    if (key == "reed_solomon_errors") {
-      const auto& v = value.get<int>();
-      if (v >= 0) {
-        stats_.reedSolomonErrors.push_back(v);
-        statsd << key << ":" << v << "|h" << std::endl;
-      }
-      continue;
-    }
+  // Averages over the interval
+  if (stats.viterbiErrors.count > 0) {
+    statsd << "viterbi_errors:" << stats.viterbiErrors.mean() << "|g" << std::endl;
+  }
+  if (stats.reedSolomonErrors.count > 0) {
+    statsd << "reed_solomon_errors:" << stats.reedSolomonErrors.mean() << "|g" << std::endl;
+  }
 
-    if (key == "ok") {
-      const auto& ok = value.get<int>();
-      if (ok != 0) {
-        stats_.totalOK++;
-        statsd << "packets_ok:1|c" << std::endl;
-        statsd << "packets_dropped:0|c" << std::endl;
-      } else {
-        stats_.totalDropped++;
-        statsd << "packets_ok:0|c" << std::endl;
-        statsd << "packets_dropped:1|c" << std::endl;
-      }
-      continue;
+  // Latency in milliseconds
+  if (stats.packetLatency.count > 0) {
+    statsd << "packet_latency:" << stats.packetLatency.mean() * 1e3 << "|g" << std::endl;
+  }
+  for (const auto& it : stats.latency) {
+    if (it.second.count > 0) {
+      statsd << "latency." << it.first << ":" << it.second.mean() * 1e3 << "|g" << std::endl;
     }
   }
 
-  if (statsd_) {
-    statsd_->send(statsd.str());
+  // Counters since start, per queue
+  for (const auto& it : stats.queues) {
+    const auto prefix = "queue." + it.first + ".";
+    statsd << prefix << "dropped:" << it.second.dropped << "|g" << std::endl;
+    statsd << prefix << "high_water:" << it.second.highWater << "|g" << std::endl;
+    statsd << prefix << "blocked:" << it.second.blockedNs / 1e6 << "|g" << std::endl;
   }
+
+  statsd_->send(statsd.str());
 }
 
 void Monitor::print(const Stats& stats) {
@@ -252,16 +184,24 @@ void Monitor::print(const Stats& stats) {
      << avg(stats.omega) << ", ";
   ss << "vit(avg): "
      << std::setw(4)
-     << avg(stats.viterbiErrors) << ", ";
+     << (int) stats.viterbiErrors.mean() << ", ";
   ss << "rs(sum): "
      << std::setw(4)
-     << sum(stats.reedSolomonErrors) << ", ";
+     << (int) stats.reedSolomonErrors.sum << ", ";
   ss << "packets: "
      << std::setw(packetWidth)
      << stats.totalOK << ", ";
   ss << "drops: "
      << std::setw(packetWidth)
-     << stats.totalDropped;
+     << stats.totalDropped << ", ";
+  ss << "saved: "
+     << std::setw(packetWidth)
+     << stats.totalSaved << ", ";
+  ss << "latency: "
+     << std::setprecision(1) << std::setw(6)
+     << stats.packetLatency.mean() * 1e3 << "ms, ";
+  ss << "overruns: "
+     << stats.queueDropped;
   std::cout << ss.str() << std::endl;
 }
 
@@ -275,8 +215,6 @@ void Monitor::start() {
 }
 
 void Monitor::stop() {
-  nn_close(demodulatorFd_);
-  nn_close(decoderFd_);
   stop_ = true;
 
   // Wait for thread to terminate
@@ -2,47 +2,74 @@
 
 #include <atomic>
 #include <chrono>
+#include <map>
 #include <memory>
 #include <thread>
 
 #include "config.h"
 #include "datagram_socket.h"
+#include "decoder.h"
+#include "demodulator.h"
 
+// Reads the metrics of a demodulator and decoder at a fixed interval,
+// and prints them (if verbose) and/or sends them to statsd.
 class Monitor {
 public:
   explicit Monitor(bool verbose, std::chrono::milliseconds interval);
   ~Monitor();
 
-  void initialize(Config& config);
+  void initialize(Config& config, Demodulator& demod, Decoder& decode);
 
   void start();
   void stop();
 
 protected:
   struct Stats {
-    // Demodulator stats
+    // Demodulator stats (sampled every 100ms)
     std::vector<float> gain;
     std::vector<float> frequency;
     std::vector<float> omega;
 
-    // Decoder stats
-    std::vector<int> viterbiErrors;
-    std::vector<int> reedSolomonErrors;
-    int totalOK = 0;
-    int totalDropped = 0;
+    // Decoder stats (over the last interval)
+    Histogram::Snapshot viterbiErrors;
+    Histogram::Snapshot reedSolomonErrors;
+    int64_t totalOK = 0;
+    int64_t totalDropped = 0;
+    int64_t totalSaved = 0;
+
+    // Time from capture to publication of a packet (over the last
+    // interval), and until a stage is done with a block
+    Histogram::Snapshot packetLatency;
+    std::map<std::string, Histogram::Snapshot> latency;
+
+    // Blocks dropped by demodulator queues since start
+    int64_t queueDropped = 0;
+    std::map<std::string, QueueStats> queues;
+  };
+
+  // Counters and histograms since start
+  struct Totals {
+    int64_t ok = 0;
+    int64_t dropped = 0;
+    int64_t saved = 0;
+    Histogram::Snapshot viterbiErrors;
+    Histogram::Snapshot reedSolomonErrors;
+    Histogram::Snapshot packetLatency;
+    std::map<std::string, Histogram::Snapshot> latency;
   };
 
   Stats stats_;
 
+  Totals totals();
   void loop();
-  void process(const std::string& json);
+  void send(const Stats& stats);
   void print(const Stats& stats);
 
   const bool verbose_;
   const std::chrono::milliseconds interval_;
 
-  int demodulatorFd_;
-  int decoderFd_;
+  Demodulator* demod_;
+  Decoder* decode_;
   std::unique_ptr<DatagramSocket> statsd_;
 
   std::atomic<bool> stop_;
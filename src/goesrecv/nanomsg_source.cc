@@ -1,5 +1,6 @@
 #include "nanomsg_source.h"
 
+#include <cstring>
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
@@ -7,6 +8,8 @@
 #include <nanomsg/nn.h>
 #include <nanomsg/pubsub.h>
 
+#include "threads.h"
+
 std::unique_ptr<Nanomsg> Nanomsg::open(const Config& config) {
   int rv;
 
@@ -74,21 +77,16 @@ void Nanomsg::loop() {
     }
 
     uint32_t nsamples = nbytes / 2;
-    int8_t* fi = (int8_t*) buf;
 
     // Expect multiple of 4
     ASSERT((nsamples & 0x3) == 0);
 
-    // Grab buffer from queue
+    // Grab buffer from queue.
+    // Samples are converted to float by the first stage.
     auto out = queue_->popForWrite();
-    out->resize(nsamples);
-
-    // Convert to std::complex<float>
-    auto fo = out->data();
-    for (uint32_t i = 0; i < nsamples; i++) {
-      fo[i].real((float) fi[i*2+0] / 127.0f);
-      fo[i].imag((float) fi[i*2+1] / 127.0f);
-    }
+    out->resize(RawSamples::CS8, nsamples);
+    memcpy(out->data.data(), buf, nbytes);
+    stamp(*out);
 
     // Processed samples; free nanomsg buffer
     nn_freemsg(buf);
@@ -103,14 +101,10 @@ void Nanomsg::loop() {
   }
 }
 
-void Nanomsg::start(const std::shared_ptr<Queue<Samples> >& queue) {
+void Nanomsg::start(const std::shared_ptr<Queue<RawSamples> >& queue) {
   queue_ = queue;
   thread_ = std::thread(&Nanomsg::loop, this);
-#ifdef __APPLE__
-  pthread_setname_np("nanomsg");
-#else
-  pthread_setname_np(thread_.native_handle(), "nanomsg");
-#endif
+  configureThread(thread_, "nanomsg", threadConfig_);
 }
 
 void Nanomsg::stop() {
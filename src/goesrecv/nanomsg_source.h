@@ -21,7 +21,7 @@ public:
 
   virtual uint32_t getSampleRate() const override;
 
-  virtual void start(const std::shared_ptr<Queue<Samples> >& queue) override;
+  virtual void start(const std::shared_ptr<Queue<RawSamples> >& queue) override;
 
   virtual void stop() override;
 
@@ -35,7 +35,7 @@ protected:
   uint32_t sampleRate_;
 
   // Set on start; cleared on stop
-  std::shared_ptr<Queue<Samples> > queue_;
+  std::shared_ptr<Queue<RawSamples> > queue_;
 
   // Optional publisher for samples
   std::unique_ptr<SamplePublisher> samplePublisher_;
@@ -0,0 +1,13 @@
+#include "nco.h"
+
+#include <cmath>
+
+constexpr float NCO::scale_;
+constexpr float NCO::step_;
+
+NCO::NCO() {
+  for (size_t i = 0; i < coarse_.size(); i++) {
+    coarse_[i] = std::polar(1.0, (2.0 * M_PI * i) / 256.0);
+    fine_[i] = std::polar(1.0, (2.0 * M_PI * i) / 65536.0);
+  }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+
+// Numerically controlled oscillator.
+//
+// Computes cos/sin with two lookup tables instead of a polynomial
+// approximation. The phase is quantized to 16 bits: the 8 most
+// significant bits index a coarse table (steps of 2pi/256) and the
+// 8 least significant bits index a fine table (steps of 2pi/65536).
+// The residual phase (less than 2pi/65536) is corrected for with a
+// first order approximation (e^ix ~= 1 + ix). The remaining error is
+// dominated by rounding of the scaled phase, and is less than 1e-6
+// for phases in [-2pi, 2pi].
+//
+// This is plain scalar code so that every backend (generic, NEON,
+// and x86) uses the same implementation. The compiler vectorizes
+// the index computation; the table lookups remain scalar.
+//
+class NCO {
+public:
+  explicit NCO();
+
+  // Computes cos/sin of (phase + k * freq) for k in [0, n).
+  // The phase does not have to be wrapped, but its magnitude (in
+  // radians) must be small enough for the index to fit in 31 bits.
+  void sincos(float phase, float freq, size_t n, float* cos, float* sin) const {
+    for (size_t k = 0; k < n; k++) {
+      const float x = (phase + k * freq) * scale_;
+      const int32_t xi = (int32_t) x;
+      const float dx = (x - (float) xi) * step_;
+      const uint32_t idx = ((uint32_t) xi) & 0xffff;
+      const auto& a = coarse_[idx >> 8];
+      const auto& b = fine_[idx & 0xff];
+
+      // Residual rotation of fine table entry: b * (1 + i * dx)
+      const float bc = b.real() - b.imag() * dx;
+      const float bs = b.imag() + b.real() * dx;
+
+      // Rotate by coarse table entry
+      cos[k] = a.real() * bc - a.imag() * bs;
+      sin[k] = a.real() * bs + a.imag() * bc;
+    }
+  }
+
+protected:
+  // Table index units per radian and vice versa
+  static constexpr float scale_ = 65536.0f / (2.0f * (float) M_PI);
+  static constexpr float step_ = (2.0f * (float) M_PI) / 65536.0f;
+
+  std::array<std::complex<float>, 256> coarse_;
+  std::array<std::complex<float>, 256> fine_;
+};
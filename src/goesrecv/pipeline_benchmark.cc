@@ -0,0 +1,412 @@
+#include <getopt.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+
+#include <util/cpu.h>
+
+#include "channelizer.h"
+#include "config.h"
+#include "decoder.h"
+#include "demodulator.h"
+#include "synthetic_source.h"
+
+// End-to-end benchmark of goesrecv.
+//
+// Generates a synthetic LRIT or HRIT signal with a known number of
+// frames, runs it through the same demodulator and decoder that
+// goesrecv uses, and reports throughput, per-stage CPU time, and
+// the number of packets that were recovered.
+//
+
+namespace {
+
+struct Options {
+  SignalGenerator::Params params;
+  int decimation = 1;
+  size_t blockSize = 256 * 1024;
+  bool pipeline = false;
+  int decoderWorkers = 0;
+  int viterbiErrorInterval = 1;
+  int reedSolomonErasures = 0;
+  int frontEndDecimation = 1;
+  float frontEndOffset = 0.0f;
+  RawSamples::Format format = RawSamples::CF32;
+  int channels = 1;
+};
+
+void usage(int argc, char** argv) {
+  fprintf(stderr, "Usage: %s [OPTIONS]\n", argv[0]);
+  fprintf(stderr, "Benchmark demodulator and decoder with a synthetic signal.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Options:\n");
+  fprintf(stderr, "      --mode MODE             Downlink type (lrit or hrit; default: hrit)\n");
+  fprintf(stderr, "      --sample-rate RATE      Sample rate in Hz (default: 2400000)\n");
+  fprintf(stderr, "      --decimation N          Decimation at RRC stage (default: 1)\n");
+  fprintf(stderr, "      --frames N              Number of frames (default: 100)\n");
+  fprintf(stderr, "      --snr DB                Es/N0 in dB (default: 10)\n");
+  fprintf(stderr, "      --frequency-offset HZ   Carrier frequency offset (default: 0)\n");
+  fprintf(stderr, "      --clock-drift PPM       Symbol clock offset (default: 0)\n");
+  fprintf(stderr, "      --block-size N          Samples per source block (default: 262144)\n");
+  fprintf(stderr, "      --seed N                Seed for random number generators\n");
+  fprintf(stderr, "      --pipeline              Run every stage in its own thread\n");
+  fprintf(stderr, "      --decoder-workers N     Number of decoder worker threads (default: 0)\n");
+  fprintf(stderr, "      --viterbi-errors N      Count Viterbi errors every Nth packet (default: 1)\n");
+  fprintf(stderr, "      --rs-erasures N         Retry Reed-Solomon with up to N erasures (default: 0)\n");
+  fprintf(stderr, "      --front-end N           Decimation before AGC and Costas loop (default: 1)\n");
+  fprintf(stderr, "      --front-end-offset HZ   Frequency shift in front end (default: 0)\n");
+  fprintf(stderr, "      --format FORMAT         Source sample format (cu8, cs8, cs16, cf32; default: cf32)\n");
+  fprintf(stderr, "      --channels N            Demodulate the signal N times from one source (default: 1)\n");
+  fprintf(stderr, "      --help                  Show this help\n");
+  fprintf(stderr, "\n");
+  exit(0);
+}
+
+Options parseOptions(int argc, char** argv) {
+  Options opts;
+
+  while (1) {
+    static struct option longOpts[] = {
+      {"mode",             required_argument, nullptr, 0x1001},
+      {"sample-rate",      required_argument, nullptr, 0x1002},
+      {"decimation",       required_argument, nullptr, 0x1003},
+      {"frames",           required_argument, nullptr, 0x1004},
+      {"snr",              required_argument, nullptr, 0x1005},
+      {"frequency-offset", required_argument, nullptr, 0x1006},
+      {"clock-drift",      required_argument, nullptr, 0x1007},
+      {"block-size",       required_argument, nullptr, 0x1008},
+      {"seed",             required_argument, nullptr, 0x1009},
+      {"pipeline",         no_argument,       nullptr, 0x100a},
+      {"decoder-workers",  required_argument, nullptr, 0x100b},
+      {"viterbi-errors",   required_argument, nullptr, 0x100c},
+      {"front-end",        required_argument, nullptr, 0x100d},
+      {"front-end-offset", required_argument, nullptr, 0x100e},
+      {"format",           required_argument, nullptr, 0x100f},
+      {"channels",         required_argument, nullptr, 0x1010},
+      {"rs-erasures",      required_argument, nullptr, 0x1011},
+      {"help",             no_argument,       nullptr, 0x1337},
+      {nullptr,            0,                 nullptr, 0},
+    };
+
+    auto c = getopt_long(argc, argv, "", longOpts, nullptr);
+    if (c == -1) {
+      break;
+    }
+
+    switch (c) {
+    case 0:
+      break;
+    case 0x1001:
+      if (strcmp(optarg, "lrit") == 0) {
+        opts.params.hrit = false;
+      } else if (strcmp(optarg, "hrit") == 0) {
+        opts.params.hrit = true;
+      } else {
+        std::cerr << "Invalid mode: " << optarg << std::endl;
+        exit(1);
+      }
+      break;
+    case 0x1002:
+      opts.params.sampleRate = strtoul(optarg, nullptr, 10);
+      break;
+    case 0x1003:
+      opts.decimation = atoi(optarg);
+      break;
+    case 0x1004:
+      opts.params.frames = atoi(optarg);
+      break;
+    case 0x1005:
+      opts.params.snr = atof(optarg);
+      break;
+    case 0x1006:
+      opts.params.frequencyOffset = atof(optarg);
+      break;
+    case 0x1007:
+      opts.params.clockDrift = atof(optarg);
+      break;
+    case 0x1008:
+      opts.blockSize = strtoul(optarg, nullptr, 10);
+      break;
+    case 0x1009:
+      opts.params.seed = strtoul(optarg, nullptr, 10);
+      break;
+    case 0x100a:
+      opts.pipeline = true;
+      break;
+    case 0x100b:
+      opts.decoderWorkers = atoi(optarg);
+      break;
+    case 0x100c:
+      opts.viterbiErrorInterval = atoi(optarg);
+      break;
+    case 0x100d:
+      opts.frontEndDecimation = atoi(optarg);
+      break;
+    case 0x100e:
+      opts.frontEndOffset = atof(optarg);
+      break;
+    case 0x100f:
+      if (strcmp(optarg, "cu8") == 0) {
+        opts.format = RawSamples::CU8;
+      } else if (strcmp(optarg, "cs8") == 0) {
+        opts.format = RawSamples::CS8;
+      } else if (strcmp(optarg, "cs16") == 0) {
+        opts.format = RawSamples::CS16;
+      } else if (strcmp(optarg, "cf32") == 0) {
+        opts.format = RawSamples::CF32;
+      } else {
+        std::cerr << "Invalid format: " << optarg << std::endl;
+        exit(1);
+      }
+      break;
+    case 0x1010:
+      opts.channels = atoi(optarg);
+      break;
+    case 0x1011:
+      opts.reedSolomonErasures = atoi(optarg);
+      break;
+    case 0x1337:
+      usage(argc, argv);
+      break;
+    default:
+      std::cerr << "Invalid option" << std::endl;
+      exit(1);
+    }
+  }
+
+  if (opts.decoderWorkers < 0 || opts.viterbiErrorInterval < 0) {
+    std::cerr << "Number of decoder workers and Viterbi error interval must be non-negative" << std::endl;
+    exit(1);
+  }
+
+  if (opts.params.sampleRate == 0 || opts.params.frames <= 0) {
+    std::cerr << "Sample rate and number of frames must be positive" << std::endl;
+    exit(1);
+  }
+
+  if (opts.reedSolomonErasures < 0 || opts.reedSolomonErasures > 24) {
+    std::cerr << "Number of Reed-Solomon erasures must be between 0 and 24" << std::endl;
+    exit(1);
+  }
+
+  if (opts.channels <= 0) {
+    std::cerr << "Number of channels must be positive" << std::endl;
+    exit(1);
+  }
+
+  if (opts.frontEndDecimation <= 0) {
+    std::cerr << "Front end decimation must be positive" << std::endl;
+    exit(1);
+  }
+
+  if (opts.decimation <= 0 || opts.blockSize == 0 ||
+      (opts.blockSize % opts.decimation) != 0) {
+    std::cerr << "Block size must be a multiple of the decimation factor" << std::endl;
+    exit(1);
+  }
+
+  return opts;
+}
+
+double seconds(std::chrono::high_resolution_clock::duration d) {
+  return std::chrono::duration_cast<std::chrono::duration<double> >(d).count();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  auto opts = parseOptions(argc, argv);
+
+  std::cerr.setf(std::ios::fixed, std::ios::floatfield);
+  std::cerr.precision(3);
+
+  std::cerr
+    << "Mode: " << (opts.params.hrit ? "HRIT" : "LRIT")
+    << ", sample rate: " << opts.params.sampleRate / 1e6 << "M"
+    << ", front end: " << opts.frontEndDecimation
+    << ", decimation: " << opts.decimation
+    << ", " << (opts.pipeline ? "pipeline" : "sequential")
+    << ", decoder workers: " << opts.decoderWorkers
+    << ", channels: " << opts.channels
+    << " (" << util::cpu::levelToString(util::cpu::level()) << ")"
+    << std::endl;
+
+  // Generate the complete signal up front so that the
+  // source does not limit the throughput of the pipeline.
+  SignalGenerator generator(opts.params);
+  auto t0 = std::chrono::high_resolution_clock::now();
+  auto blocks = generator.generate(opts.blockSize);
+  auto t1 = std::chrono::high_resolution_clock::now();
+  const auto nsamples = blocks.size() * opts.blockSize;
+  const auto duration = (double) nsamples / opts.params.sampleRate;
+  std::cerr
+    << "Generated " << opts.params.frames << " frames, "
+    << nsamples << " samples (" << duration << "s of signal) in "
+    << seconds(t1 - t0) << "s"
+    << std::endl;
+
+  Config config;
+  config.demodulator.downlinkType = opts.params.hrit ? "hrit" : "lrit";
+  config.demodulator.decimation = opts.decimation;
+  config.demodulator.pipeline = opts.pipeline;
+  config.frontEnd.decimation = opts.frontEndDecimation;
+  config.frontEnd.frequencyOffset = opts.frontEndOffset;
+  config.decoder.workers = opts.decoderWorkers;
+  config.decoder.viterbiErrorInterval = opts.viterbiErrorInterval;
+  config.decoder.reedSolomonErasures = opts.reedSolomonErasures;
+
+  // Every channel demodulates and decodes the same signal
+  std::vector<std::unique_ptr<Source> > sources;
+  sources.push_back(
+    std::make_unique<SyntheticSource>(
+      opts.params.sampleRate,
+      blocks,
+      opts.format));
+  if (opts.channels > 1) {
+    sources = Channelizer::split(
+      std::move(sources[0]),
+      opts.channels,
+      config.demodulator.sourceQueueDepth,
+      config.demodulator.sourceQueueOverflow);
+  }
+
+  std::vector<std::unique_ptr<Demodulator> > demods;
+  std::vector<std::unique_ptr<Decoder> > decoders;
+  for (auto& source : sources) {
+    auto demod = std::make_unique<Demodulator>(
+      opts.params.hrit ? Demodulator::HRIT : Demodulator::LRIT);
+    demod->initialize(config, std::move(source));
+    auto decode = std::make_unique<Decoder>(demod->getSoftBitsQueue());
+    decode->initialize(config);
+    demods.push_back(std::move(demod));
+    decoders.push_back(std::move(decode));
+  }
+
+  // The decoders return when the demodulators have
+  // drained the source and closed the soft bits queues.
+  t0 = std::chrono::high_resolution_clock::now();
+  for (size_t i = 0; i < demods.size(); i++) {
+    decoders[i]->start();
+    demods[i]->start();
+  }
+  for (auto& decode : decoders) {
+    decode->stop();
+  }
+  t1 = std::chrono::high_resolution_clock::now();
+  for (auto& demod : demods) {
+    demod->stop();
+  }
+
+  const auto elapsed = seconds(t1 - t0);
+  std::cerr
+    << "Processed in " << elapsed << "s: "
+    << (nsamples / elapsed) / 1e6 << "M samples/s"
+    << ", " << duration / elapsed << "x real time"
+    << std::endl;
+
+  // CPU time per stage, normalized by the number of input samples
+  std::cerr << "CPU time per input sample:" << std::endl;
+  int64_t total = 0;
+  auto row = [&] (const std::string& name, int64_t ns) {
+    std::cerr
+      << "  "
+      << std::left << std::setw(16) << (name + ":")
+      << std::right << std::setw(10) << (double) ns / nsamples
+      << "ns"
+      << std::endl;
+    total += ns;
+  };
+  // Summed over all channels
+  std::map<std::string, int64_t> stages;
+  for (const auto& demod : demods) {
+    for (const auto& it : demod->getStageStats()) {
+      stages[it.first] += it.second.ns;
+    }
+  }
+  for (const auto& it : stages) {
+    row(it.first, it.second);
+  }
+  Decoder::Stats stats;
+  for (const auto& decode : decoders) {
+    stats.ok += decode->getStats().ok;
+    stats.dropped += decode->getStats().dropped;
+    stats.saved += decode->getStats().saved;
+    stats.ns += decode->getStats().ns;
+  }
+  row("decoder", stats.ns);
+  std::cerr
+    << "  "
+    << std::left << std::setw(16) << "total:"
+    << std::right << std::setw(10) << (double) total / nsamples
+    << "ns"
+    << std::endl;
+
+  // Time from capture of a block until a stage is done with it.
+  // Histograms use power of two buckets, so percentiles are upper bounds.
+  std::cerr << "Latency (p50 / p99 / max):" << std::endl;
+  auto latencyRow = [&] (const std::string& name, const LatencyHistogram& h) {
+    std::cerr
+      << "  "
+      << std::left << std::setw(16) << (name + ":")
+      << std::right
+      << std::setw(10) << h.percentile(50) / 1e6 << "ms"
+      << std::setw(10) << h.percentile(99) / 1e6 << "ms"
+      << std::setw(10) << h.max() / 1e6 << "ms"
+      << std::endl;
+  };
+  std::map<std::string, LatencyHistogram> latencies;
+  for (const auto& demod : demods) {
+    for (const auto& it : demod->getStageStats()) {
+      latencies[it.first].merge(it.second.latency);
+    }
+  }
+  for (const auto& it : latencies) {
+    latencyRow(it.first, it.second);
+  }
+  LatencyHistogram packetLatency;
+  for (const auto& decode : decoders) {
+    packetLatency.merge(decode->getStats().latency);
+  }
+  latencyRow("packet", packetLatency);
+
+  // Queues are named after the stage writing to them. Time blocked
+  // is where a producer waited for the stage downstream.
+  std::cerr << "Queues (dropped / high water / blocked):" << std::endl;
+  std::map<std::string, QueueStats> queues;
+  for (const auto& demod : demods) {
+    for (const auto& it : demod->getQueueStats()) {
+      auto& q = queues[it.first];
+      q.dropped += it.second.dropped;
+      q.highWater = std::max(q.highWater, it.second.highWater);
+      q.blockedNs += it.second.blockedNs;
+    }
+  }
+  for (const auto& it : queues) {
+    std::cerr
+      << "  "
+      << std::left << std::setw(16) << (it.first + ":")
+      << std::right
+      << std::setw(10) << it.second.dropped
+      << std::setw(10) << it.second.highWater
+      << std::setw(10) << it.second.blockedNs / 1e6 << "ms"
+      << std::endl;
+  }
+
+  // The packets in the lead-in and lead-out are never valid
+  const int64_t frames = (int64_t) opts.params.frames * opts.channels;
+  const auto missed = std::max<int64_t>(0, frames - stats.ok);
+  std::cerr
+    << "Packets: "
+    << stats.ok << " ok, "
+    << stats.dropped << " dropped, "
+    << stats.saved << " saved, "
+    << (stats.ok / elapsed) << " packets/s, "
+    << "packet error rate: " << (double) missed / frames
+    << std::endl;
+
+  return 0;
+}
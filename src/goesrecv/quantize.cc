@@ -4,25 +4,26 @@ Quantize::Quantize() {
 }
 
 void Quantize::work(
-    const std::shared_ptr<Queue<std::vector<std::complex<float> > > >& qin,
-    const std::shared_ptr<Queue<std::vector<int8_t> > >& qout) {
+    const std::shared_ptr<Queue<Samples> >& qin,
+    const std::shared_ptr<Queue<SoftBits> >& qout) {
   auto input = qin->popForRead();
   if (!input) {
     qout->close();
     return;
   }
 
-  // Clear output so we can use push_back.
+  // Resize output so we can write to it directly.
   // It will retain the associated memory allocation.
+  auto nsamples = input->size();
   auto output = qout->popForWrite();
-  output->clear();
+  output->timestamp = input->timestamp;
+  timestamp_ = input->timestamp;
+  output->resize(nsamples);
 
-  auto& rinput = *input;
-  auto& routput = *output;
-  auto nsamples = input->size();
+  auto rinput = input->data();
+  auto routput = output->data();
   for (size_t i = 0; i < nsamples; i++) {
-    int8_t v = rinput[i].real() * 127.0f;
-    routput.push_back(v);
+    routput[i] = rinput[i].real() * 127.0f;
   }
 
   // Return input buffer
@@ -13,10 +13,17 @@ public:
     softBitPublisher_ = std::move(softBitPublisher);
   }
 
+  const Timestamp& getTimestamp() const {
+    return timestamp_;
+  }
+
   void work(
-      const std::shared_ptr<Queue<std::vector<std::complex<float> > > >& qin,
-      const std::shared_ptr<Queue<std::vector<int8_t> > >& qout);
+      const std::shared_ptr<Queue<Samples> >& qin,
+      const std::shared_ptr<Queue<SoftBits> >& qout);
 
 protected:
   std::unique_ptr<SoftBitPublisher> softBitPublisher_;
+
+  // Of the most recent input block
+  Timestamp timestamp_;
 };
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+// What popForWrite does when every buffer of a queue is in use,
+// i.e. when the consumer has fallen behind the producer.
+enum class OverflowPolicy {
+  // Wait until the consumer returns a buffer
+  BLOCK,
+
+  // Take back the oldest block that is queued for reading
+  DROP_OLDEST,
+
+  // Return a spare buffer whose contents are discarded on pushWrite
+  DROP_NEWEST,
+};
+
+// Counters of a queue. Only the producer updates them,
+// but they may be read from any thread.
+struct QueueStats {
+  // Number of blocks dropped because of overflow
+  int64_t dropped = 0;
+
+  // Maximum number of blocks queued for reading
+  int64_t highWater = 0;
+
+  // Time the producer spent waiting for a buffer
+  int64_t blockedNs = 0;
+};
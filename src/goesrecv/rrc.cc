@@ -2,20 +2,14 @@
 
 #include <cstring>
 
-#ifdef __ARM_NEON
-#include <arm_neon.h>
-#endif
-
 #include <util/error.h>
 
 namespace {
 
 // Implementation of RRC filter definition as found on Wikipedia.
 // Manually cross checked results against taps generated by GNU Radio.
-std::vector<float> taps(int sampleRate, int symbolRate) {
+std::vector<float> taps(int sampleRate, int symbolRate, int ntaps, double beta) {
   const double sps = (double) sampleRate / (double) symbolRate;
-  constexpr int ntaps = RRC::NTAPS;
-  constexpr double beta = 0.5f;
   std::vector<float> taps(ntaps);
   for (int i = 0; i < (int) ntaps; i++) {
     int t = i - (ntaps / 2);
@@ -62,77 +56,15 @@ std::vector<float> taps(int sampleRate, int symbolRate) {
 
 } // namespace
 
-RRC::RRC(int decimation, int sampleRate, int symbolRate) :
-    decimation_(decimation) {
-  taps_ = taps(sampleRate, symbolRate);
-
-  // Last tap is zero (so it is a multiple of 4)
-  static_assert((NTAPS + 1) % 4 == 0, "NTAPS + 1 not a multiple of 4");
-  taps_.resize(NTAPS + 1);
-  taps_[NTAPS] = 0.0f;
-
-  // Seed the delay line with zeroes
-  tmp_.resize(NTAPS);
-}
-
-#ifdef __ARM_NEON
-
-void RRC::work(
-    size_t nsamples,
-    std::complex<float>* fi,
-    std::complex<float>* fo) {
-  // Load taps
-  float32x4_t taps[(NTAPS + 1) / 4];
-  for (size_t i = 0; i < (NTAPS + 1); i += 4) {
-    taps[i / 4] = vld1q_f32(&taps_[i]);
-  }
-
-  for (size_t i = 0; i < (nsamples / decimation_); i++) {
-    float32x4x2_t acc;
-    acc.val[0] = vdupq_n_f32(0.0f);
-    acc.val[1] = vdupq_n_f32(0.0f);
-
-    // The compiler should unroll this
-    for (size_t j = 0; j < (NTAPS + 1); j += 4) {
-      float32x4x2_t val = vld2q_f32((const float32_t*) &fi[j]);
-      acc.val[0] = vmlaq_f32(acc.val[0], val.val[0], taps[j / 4]);
-      acc.val[1] = vmlaq_f32(acc.val[1], val.val[1], taps[j / 4]);
-    }
-
-    // Sum accumulators
-    auto acci = vpadd_f32(vget_low_f32(acc.val[0]), vget_high_f32(acc.val[0]));
-    auto accq = vpadd_f32(vget_low_f32(acc.val[1]), vget_high_f32(acc.val[1]));
-    acci = vpadd_f32(acci, acci);
-    accq = vpadd_f32(accq, accq);
-    fo->real(vget_lane_f32(acci, 0));
-    fo->imag(vget_lane_f32(accq, 0));
-
-    // Advance input/output cursors
-    fi += decimation_;
-    fo += 1;
-  }
-}
-
-#else
-
-void RRC::work(
-    size_t nsamples,
-    std::complex<float>* fi,
-    std::complex<float>* fo) {
-  for (size_t i = 0; i < (nsamples / decimation_); i++) {
-    *fo = 0.0f;
-    for (size_t j = 0; j < (NTAPS + 1); j++) {
-      *fo += fi[j] * taps_[j];
-    }
-
-    // Advance input/output cursors
-    fi += decimation_;
-    fo += 1;
-  }
+RRC::RRC(
+    int decimation,
+    int sampleRate,
+    int symbolRate,
+    int ntaps,
+    float rollOff) :
+    fir_(decimation, taps(sampleRate, symbolRate, ntaps, rollOff)) {
 }
 
-#endif
-
 void RRC::work(
     const std::shared_ptr<Queue<Samples> >& qin,
     const std::shared_ptr<Queue<Samples> >& qout) {
@@ -143,23 +75,17 @@ void RRC::work(
   }
 
   auto output = qout->popForWrite();
+  output->timestamp = input->timestamp;
+  timestamp_ = input->timestamp;
   auto nsamples = input->size();
-  ASSERT((nsamples % decimation_) == 0);
-  output->resize(nsamples / decimation_);
-  tmp_.insert(tmp_.end(), input->begin(), input->end());
-  ASSERT(tmp_.size() == input->size() + NTAPS);
+  ASSERT((nsamples % fir_.getDecimation()) == 0);
+  output->resize(nsamples / fir_.getDecimation());
 
-  // Return read buffer (it has been copied into tmp_)
-  qin->pushRead(std::move(input));
-
-  // Do actual work
-  std::complex<float>* fi = tmp_.data();
-  std::complex<float>* fo = output->data();
-  work(nsamples, fi, fo);
+  // Do actual work (the filter keeps its own delay line)
+  fir_.work(nsamples, input->data(), output->data());
 
-  // Keep final NTAPS samples around
-  tmp_.erase(tmp_.begin(), tmp_.end() - NTAPS);
-  ASSERT(tmp_.size() == NTAPS);
+  // Return read buffer
+  qin->pushRead(std::move(input));
 
   // Publish output if applicable
   if (samplePublisher_) {
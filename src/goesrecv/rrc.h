@@ -1,35 +1,37 @@
 #pragma once
 
-#include <array>
 #include <memory>
 
+#include "fir.h"
 #include "sample_publisher.h"
 #include "types.h"
 
 class RRC {
 public:
-  static constexpr size_t NTAPS = 31;
-
-  explicit RRC(int df, int sampleRate, int symbolRate);
+  explicit RRC(
+      int decimation,
+      int sampleRate,
+      int symbolRate,
+      int ntaps,
+      float rollOff);
 
   void setSamplePublisher(std::unique_ptr<SamplePublisher> samplePublisher) {
     samplePublisher_ = std::move(samplePublisher);
   }
 
+  const Timestamp& getTimestamp() const {
+    return timestamp_;
+  }
+
   void work(
       const std::shared_ptr<Queue<Samples> >& qin,
       const std::shared_ptr<Queue<Samples> >& qout);
 
 protected:
-  void work(
-      size_t nsamples,
-      std::complex<float>* fi,
-      std::complex<float>* fo);
-
-  int decimation_;
-  std::vector<float> taps_;
-
-  Samples tmp_;
+  FIR fir_;
 
   std::unique_ptr<SamplePublisher> samplePublisher_;
+
+  // Of the most recent input block
+  Timestamp timestamp_;
 };
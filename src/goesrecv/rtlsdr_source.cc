@@ -1,17 +1,14 @@
 #include "rtlsdr_source.h"
 
-#include <pthread.h>
-
 #include <climits>
 #include <cmath>
+#include <cstring>
 #include <iostream>
 
-#ifdef __ARM_NEON
-#include <arm_neon.h>
-#endif
-
 #include <util/error.h>
 
+#include "threads.h"
+
 std::unique_ptr<RTLSDR> RTLSDR::open(uint32_t index) {
   rtlsdr_dev_t* dev = nullptr;
   auto rv = rtlsdr_open(&dev, index);
@@ -119,23 +116,28 @@ void RTLSDR::setBiasTee(bool on) {
 #endif
 }
 
+// Buffer length passed to rtlsdr_read_async (the librtlsdr default)
+static constexpr uint32_t bufferLength = 16 * 32 * 512;
+
 static void rtlsdr_callback(unsigned char* buf, uint32_t len, void* ptr) {
   RTLSDR* rtlsdr = reinterpret_cast<RTLSDR*>(ptr);
   rtlsdr->handle(buf, len);
 }
 
-void RTLSDR::start(const std::shared_ptr<Queue<Samples> >& queue) {
+void RTLSDR::start(const std::shared_ptr<Queue<RawSamples> >& queue) {
   ASSERT(dev_ != nullptr);
   rtlsdr_reset_buffer(dev_);
   queue_ = queue;
+
+  // Every callback fills a block of bufferLength bytes
+  prefault(*queue_, RawSamples::CU8, bufferLength / 2);
+
   thread_ = std::thread([&] {
-      rtlsdr_read_async(dev_, rtlsdr_callback, this, 0, 0);
+      rtlsdr_read_async(dev_, rtlsdr_callback, this, 0, bufferLength);
     });
-#ifdef __APPLE__
-  pthread_setname_np("rtlsdr");
-#else
-  pthread_setname_np(thread_.native_handle(), "rtlsdr");
-#endif
+
+  // Callbacks run on this thread
+  configureThread(thread_, "rtlsdr", threadConfig_);
 }
 
 void RTLSDR::stop() {
@@ -153,74 +155,18 @@ void RTLSDR::stop() {
   queue_.reset();
 }
 
-#ifdef __ARM_NEON
-
-void RTLSDR::process(
-    size_t nsamples,
-    unsigned char* buf,
-    std::complex<float>* fo) {
-  // Number to subtract from samples for normalization
-  // See http://cgit.osmocom.org/gr-osmosdr/tree/lib/rtl/rtl_source_c.cc#n176
-  const float32_t norm_ = 127.4f / 128.0f;
-  float32x4_t norm = vld1q_dup_f32(&norm_);
-
-  // Iterate over samples in blocks of 4 (each sample has I and Q)
-  for (uint32_t i = 0; i < (nsamples / 4); i++) {
-    uint32x4_t ui;
-    ui[0] = buf[i * 8 + 0];
-    ui[1] = buf[i * 8 + 2];
-    ui[2] = buf[i * 8 + 4];
-    ui[3] = buf[i * 8 + 6];
-
-    uint32x4_t uq;
-    uq[0] = buf[i * 8 + 1];
-    uq[1] = buf[i * 8 + 3];
-    uq[2] = buf[i * 8 + 5];
-    uq[3] = buf[i * 8 + 7];
-
-    // Convert to float32x4 and divide by 2^7 (128)
-    float32x4_t fi = vcvtq_n_f32_u32(ui, 7);
-    float32x4_t fq = vcvtq_n_f32_u32(uq, 7);
-
-    // Subtract to normalize to [-1.0, 1.0]
-    float32x4x2_t fiq;
-    fiq.val[0] = vsubq_f32(fi, norm);
-    fiq.val[1] = vsubq_f32(fq, norm);
-
-    // Store in output
-    vst2q_f32((float*) (&fo[i * 4]), fiq);
-  }
-}
-
-#else
-
-void RTLSDR::process(
-    size_t nsamples,
-    unsigned char* buf,
-    std::complex<float>* fo) {
-  // Number to subtract from samples for normalization
-  // See http://cgit.osmocom.org/gr-osmosdr/tree/lib/rtl/rtl_source_c.cc#n176
-  const float norm = 127.4f / 128.0f;
-  for (uint32_t i = 0; i < nsamples; i++) {
-    fo[i].real((buf[i*2+0] / 128.0f) - norm);
-    fo[i].imag((buf[i*2+1] / 128.0f) - norm);
-  }
-}
-
-#endif
-
 void RTLSDR::handle(unsigned char* buf, uint32_t len) {
   uint32_t nsamples = len / 2;
 
   // Expect multiple of 4
   ASSERT((nsamples & 0x3) == 0);
 
-  // Grab buffer from queue
+  // Grab buffer from queue.
+  // Samples are converted to float by the first stage.
   auto out = queue_->popForWrite();
-  out->resize(nsamples);
-
-  // Convert unsigned char to std::complex<float>
-  process(nsamples, buf, out->data());
+  out->resize(RawSamples::CU8, nsamples);
+  memcpy(out->data.data(), buf, len);
+  stamp(*out);
 
   // Publish output if applicable
   if (samplePublisher_) {
@@ -35,25 +35,20 @@ public:
     samplePublisher_ = std::move(samplePublisher);
   }
 
-  virtual void start(const std::shared_ptr<Queue<Samples> >& queue) override;
+  virtual void start(const std::shared_ptr<Queue<RawSamples> >& queue) override;
 
   virtual void stop() override;
 
   void handle(unsigned char* buf, uint32_t len);
 
 protected:
-  void process(
-      size_t nsamples,
-      unsigned char* buf,
-      std::complex<float>* fo);
-
   rtlsdr_dev_t* dev_;
 
   std::vector<int> tunerGains_;
   std::thread thread_;
 
   // Set on start; cleared on stop
-  std::shared_ptr<Queue<Samples> > queue_;
+  std::shared_ptr<Queue<RawSamples> > queue_;
 
   // Optional publisher for samples
   std::unique_ptr<SamplePublisher> samplePublisher_;
@@ -1,46 +1,137 @@
 #include "sample_publisher.h"
 
-#include <cmath>
+#include <cstring>
 
 #include <nanomsg/nn.h>
 #include <nanomsg/pubsub.h>
 
 #include <util/error.h>
 
+#include "convert.h"
+#include "threads.h"
+
 std::unique_ptr<SamplePublisher> SamplePublisher::create(const std::string& endpoint) {
   auto fd = Publisher::bind(endpoint);
   return std::make_unique<SamplePublisher>(fd);
 }
 
 SamplePublisher::SamplePublisher(int fd)
-    : Publisher(fd) {
+    : Publisher(fd),
+      decimation_(1),
+      blocks_(0),
+      interval_(0),
+      subscribers_(false),
+      stop_(false),
+      pending_(false) {
+  thread_ = std::thread(&SamplePublisher::loop, this);
 }
 
 SamplePublisher::~SamplePublisher() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_one();
+  thread_.join();
 }
 
 void SamplePublisher::publish(const Samples& samples) {
-  if (!hasSubscribers()) {
+  if (!accept()) {
+    return;
+  }
+
+  snapshot(RawSamples::CF32, samples.data(), samples.size());
+}
+
+void SamplePublisher::publish(const RawSamples& samples) {
+  if (!accept()) {
     return;
   }
 
-  // Scale samples to 8 bit.
-  // Otherwise it is impossible to stream 3M complex samples/second from a RPi.
-  tmp_.resize(samples.size());
-  for (size_t i = 0; i < samples.size(); i++) {
-    auto si = samples[i].real() * 127;
-    auto sq = samples[i].imag() * 127;
+  snapshot(samples.format, samples.data.data(), samples.size());
+}
+
+bool SamplePublisher::accept() {
+  if (!subscribers_.load(std::memory_order_relaxed)) {
+    return false;
+  }
+
+  if (decimation_ > 1) {
+    if (++blocks_ < decimation_) {
+      return false;
+    }
+    blocks_ = 0;
+  }
+
+  if (interval_.count() > 0) {
+    auto now = std::chrono::steady_clock::now();
+    if (now < next_) {
+      return false;
+    }
+    next_ = now + interval_;
+  }
+
+  return true;
+}
 
-    // Clamp
-    si = (0.5f * (fabsf(si + 127.0f) - fabsf(si - 127.0f)));
-    sq = (0.5f * (fabsf(sq + 127.0f) - fabsf(sq - 127.0f)));
+void SamplePublisher::snapshot(
+    RawSamples::Format format,
+    const void* buf,
+    size_t nsamples) {
+  {
+    // Don't wait for the publisher thread
+    std::unique_lock<std::mutex> lock(mutex_, std::try_to_lock);
+    if (!lock.owns_lock() || pending_) {
+      return;
+    }
 
-    // Convert to int8_t
-    tmp_[i].real((int8_t) si);
-    tmp_[i].imag((int8_t) sq);
+    snapshot_.resize(format, nsamples);
+    memcpy(snapshot_.data.data(), buf, snapshot_.data.size());
+    pending_ = true;
   }
 
-  auto rv = nn_send(fd_, tmp_.data(), tmp_.size() * sizeof(tmp_[0]), 0);
+  cv_.notify_one();
+}
+
+void SamplePublisher::loop() {
+  lowerCurrentThreadPriority();
+
+  // Interval to check for subscribers while there is nothing to publish
+  const auto poll = std::chrono::milliseconds(100);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    subscribers_ = hasSubscribers();
+    cv_.wait_for(lock, poll, [this] { return stop_ || pending_; });
+    if (stop_) {
+      break;
+    }
+    if (!pending_) {
+      continue;
+    }
+
+    // Take snapshot and release the lock while working on it
+    std::swap(snapshot_, work_);
+    pending_ = false;
+    lock.unlock();
+
+    if (work_.format == RawSamples::CS8) {
+      // Send 8 bit samples as is
+      send(work_.data.data(), work_.data.size());
+    } else {
+      // Scale samples to 8 bit.
+      // Otherwise it is impossible to stream 3M complex samples/second from a RPi.
+      tmp_.resize(work_.size());
+      toInt8(work_, tmp_.data());
+      send(tmp_.data(), tmp_.size() * sizeof(tmp_[0]));
+    }
+
+    lock.lock();
+  }
+}
+
+void SamplePublisher::send(const void* buf, size_t len) {
+  auto rv = nn_send(fd_, buf, len, 0);
   if (rv < 0) {
     fprintf(stderr, "nn_send: %s\n", nn_strerror(nn_errno()));
     ASSERT(false);
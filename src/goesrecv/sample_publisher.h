@@ -1,8 +1,27 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #include "publisher.h"
 #include "types.h"
 
+// Publishes sample blocks as 8 bit I/Q.
+//
+// The stage that calls publish() only copies the block into a
+// snapshot buffer. Conversion and sending happen on a separate, low
+// priority thread. If that thread is still busy with the previous
+// snapshot, the block is dropped, so that a slow subscriber or a
+// loaded system never slows down the demodulator.
+//
+// Subscribers that only need a few blocks per second (e.g. for a
+// constellation plot) can limit the rate with setDecimation() (only
+// consider every Nth block) and setInterval() (minimum time between
+// published blocks). Blocks that are skipped cost nothing.
+//
 class SamplePublisher : public Publisher {
 public:
   static std::unique_ptr<SamplePublisher> create(const std::string& endpoint);
@@ -10,8 +29,48 @@ public:
   explicit SamplePublisher(int fd);
   virtual ~SamplePublisher();
 
+  void setDecimation(int decimation) {
+    decimation_ = decimation;
+  }
+
+  void setInterval(std::chrono::milliseconds interval) {
+    interval_ = interval;
+  }
+
   void publish(const Samples& samples);
 
+  // Samples that are not 8 bit already are converted (see convert.h)
+  void publish(const RawSamples& samples);
+
 protected:
+  // Returns true if the next block should be published
+  bool accept();
+
+  // Copies block into snapshot buffer if the thread is idle
+  void snapshot(RawSamples::Format format, const void* buf, size_t nsamples);
+
+  void loop();
+
+  void send(const void* buf, size_t len);
+
+  int decimation_;
+  int blocks_;
+  std::chrono::milliseconds interval_;
+  std::chrono::steady_clock::time_point next_;
+
+  // Updated by the publisher thread so that the
+  // hot path doesn't have to query the socket.
+  std::atomic<bool> subscribers_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_;
+  bool pending_;
+  RawSamples snapshot_;
+
+  // Only used by the publisher thread
+  RawSamples work_;
   std::vector<std::complex<int8_t> > tmp_;
+
+  std::thread thread_;
 };
@@ -10,11 +10,20 @@
 #include "rtlsdr_source.h"
 #endif
 
+#include "file_source.h"
 #include "nanomsg_source.h"
 
 std::unique_ptr<Source> Source::build(
     const std::string& type,
     Config& config) {
+  auto source = create(type, config);
+  source->setThreadConfig(config.threads);
+  return source;
+}
+
+std::unique_ptr<Source> Source::create(
+    const std::string& type,
+    Config& config) {
   if (type == "airspy") {
 #ifdef BUILD_AIRSPY
     auto airspy = Airspy::open();
@@ -85,9 +94,26 @@ std::unique_ptr<Source> Source::build(
     nanomsg->setSamplePublisher(std::move(config.nanomsg.samplePublisher));
     return std::unique_ptr<Source>(nanomsg.release());
   }
+  if (type == "file") {
+    auto file = FileSource::open(config.file);
+    file->setSpeed(config.file.speed);
+    file->setBlockSize(config.file.blockSize);
+    file->setSamplePublisher(std::move(config.file.samplePublisher));
+    return std::unique_ptr<Source>(file.release());
+  }
 
   throw std::runtime_error("Invalid source: " + type);
 }
 
 Source::~Source() {
 }
+
+void Source::prefault(
+    Queue<RawSamples>& queue,
+    RawSamples::Format format,
+    size_t nsamples) {
+  queue.prefault([&] (RawSamples& samples) {
+      // Resizing writes zeroes, so this touches every page
+      samples.resize(format, nsamples);
+    });
+}
@@ -19,8 +19,38 @@ public:
   virtual uint32_t getSampleRate() const = 0;
 
   // Start producing samples
-  virtual void start(const std::shared_ptr<Queue<Samples> >& queue) = 0;
+  virtual void start(const std::shared_ptr<Queue<RawSamples> >& queue) = 0;
 
   // Stop producing samples
   virtual void stop() = 0;
+
+  // Settings for the threads of this source (see Config::Thread)
+  void setThreadConfig(const std::map<std::string, Config::Thread>& threads) {
+    threadConfig_ = threads;
+  }
+
+protected:
+  static std::unique_ptr<Source> create(
+      const std::string& type,
+      Config& config);
+
+  // Assigns the next sequence number and the current time to a
+  // block. Called by every source before pushing a block.
+  void stamp(RawSamples& samples) {
+    samples.timestamp.seq = seq_++;
+    samples.timestamp.time = Timestamp::now();
+  }
+
+  // Sizes every buffer in the queue for blocks of nsamples samples and
+  // faults in their memory. Sources that produce blocks of a known
+  // size call this on start, so that the first blocks they produce
+  // don't allocate memory on a device library's callback thread.
+  static void prefault(
+      Queue<RawSamples>& queue,
+      RawSamples::Format format,
+      size_t nsamples);
+
+  uint64_t seq_ = 0;
+
+  std::map<std::string, Config::Thread> threadConfig_;
 };
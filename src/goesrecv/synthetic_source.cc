@@ -0,0 +1,278 @@
+#include "synthetic_source.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+#include <util/error.h>
+
+#include "decoder/derandomizer.h"
+#include "decoder/reed_solomon.h"
+#include "decoder/viterbi.h"
+
+#include "threads.h"
+
+namespace {
+
+constexpr size_t frameBytes = 1024;
+constexpr size_t syncWordBytes = 4;
+constexpr size_t codeBlockBytes = 1020;
+constexpr size_t dataBytes = 892;
+
+// Root raised cosine pulse at time t (in symbols)
+double rrc(double t, double beta) {
+  if (t == 0.0) {
+    return 1.0 - beta + (4.0 * beta / M_PI);
+  }
+
+  // Special case for denominator equal to zero
+  const double tmp = 4.0 * beta * t;
+  if (fabs(1.0 - tmp * tmp) < 1e-6) {
+    const double t1 = (1.0 + 2.0 / M_PI) * sin(M_PI / (4.0 * beta));
+    const double t2 = (1.0 - 2.0 / M_PI) * cos(M_PI / (4.0 * beta));
+    return beta / sqrt(2.0) * (t1 + t2);
+  }
+
+  const double t1 = sin(M_PI * t * (1.0 - beta));
+  const double t2 = 4.0 * beta * t * cos(M_PI * t * (1.0 + beta));
+  return (t1 + t2) / (M_PI * t * (1.0 - tmp * tmp));
+}
+
+} // namespace
+
+SignalGenerator::SignalGenerator(const Params& params) : params_(params) {
+}
+
+uint32_t SignalGenerator::getSymbolRate() const {
+  return params_.hrit ? 927000 : 293883;
+}
+
+std::vector<uint8_t> SignalGenerator::encode(size_t* nbits) {
+  decoder::ReedSolomon reedSolomon;
+  decoder::Derandomizer randomizer;
+  decoder::Viterbi viterbi;
+  std::mt19937 gen(params_.seed);
+
+  // Random data before the first frame and after the last frame.
+  // This gives the demodulator some time to lock before the first
+  // frame, and lets the decoder read past the end of the last frame.
+  auto random = [&] (std::vector<uint8_t>& out, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+      out.push_back(gen() & 0xff);
+    }
+  };
+
+  std::vector<uint8_t> stream;
+  stream.reserve((params_.frames + 2) * frameBytes);
+  random(stream, frameBytes);
+
+  std::array<uint8_t, dataBytes> data;
+  std::array<uint8_t, frameBytes> frame;
+  for (int i = 0; i < params_.frames; i++) {
+    // VCDU primary header (version 1, virtual channel 0)
+    // with the frame number as counter, followed by random data.
+    data[0] = 0x40;
+    data[1] = 0x00;
+    data[2] = (i >> 16) & 0xff;
+    data[3] = (i >> 8) & 0xff;
+    data[4] = (i >> 0) & 0xff;
+    data[5] = 0x00;
+    for (size_t j = 6; j < data.size(); j++) {
+      data[j] = gen() & 0xff;
+    }
+
+    // Sync word, followed by randomized code block
+    frame[0] = 0x1a;
+    frame[1] = 0xcf;
+    frame[2] = 0xfc;
+    frame[3] = 0x1d;
+    reedSolomon.encode(data.data(), data.size(), &frame[syncWordBytes]);
+    randomizer.run(&frame[syncWordBytes], codeBlockBytes);
+    stream.insert(stream.end(), frame.begin(), frame.end());
+  }
+
+  random(stream, frameBytes);
+
+  // HRIT uses NRZ-M coding. A 1 means a bit change, a 0 means
+  // no bit change: o[i+1] = in[i] ^ o[i].
+  if (params_.hrit) {
+    uint8_t b = 0;
+    for (auto& byte : stream) {
+      uint8_t out = 0;
+      for (int j = 7; j >= 0; j--) {
+        b ^= (byte >> j) & 0x1;
+        out = (out << 1) | b;
+      }
+      byte = out;
+    }
+  }
+
+  // Convolutionally encode the stream as a whole
+  const auto len = viterbi.encodeLength(stream.size());
+  std::vector<uint8_t> encoded((len + 7) / 8);
+  auto rv = viterbi.encode(stream.data(), stream.size(), encoded.data());
+  ASSERT(rv == len);
+  *nbits = len;
+  return encoded;
+}
+
+std::vector<Samples> SignalGenerator::generate(size_t blockSize) {
+  ASSERT(blockSize > 0);
+
+  size_t nsymbols;
+  const auto bits = encode(&nsymbols);
+
+  // Pulse shape is sampled at a fixed number of phases per symbol,
+  // and spans a fixed number of symbols on either side of its peak.
+  // It is normalized to unit energy, such that with unit amplitude
+  // symbols the signal has unit power.
+  constexpr int span = 8;
+  constexpr int phases = 64;
+  std::vector<float> pulse(2 * span * phases + 1);
+  double energy = 0.0;
+  for (size_t i = 0; i < pulse.size(); i++) {
+    const double t = ((double) i / phases) - span;
+    pulse[i] = rrc(t, params_.rollOff);
+    energy += pulse[i] * pulse[i];
+  }
+  const float norm = 1.0 / sqrt(energy / phases);
+  for (auto& p : pulse) {
+    p *= norm;
+  }
+
+  // Samples per transmitted symbol (including clock offset)
+  const double symbolRate = getSymbolRate() * (1.0 + params_.clockDrift * 1e-6);
+  const double sps = params_.sampleRate / symbolRate;
+
+  // With unit signal power, Es/N0 = sps / noise power
+  const float sigma = sqrt(sps * pow(10.0, -params_.snr / 10.0) / 2.0);
+  std::mt19937 gen(params_.seed + 1);
+  std::normal_distribution<float> noise(0.0f, sigma);
+
+  // Carrier is rotated by this much every sample
+  std::uniform_real_distribution<float> uniform(0.0f, 2 * M_PI);
+  std::complex<double> carrier = std::polar(1.0, (double) uniform(gen));
+  const std::complex<double> rotate =
+    std::polar(1.0, 2 * M_PI * params_.frequencyOffset / params_.sampleRate);
+
+  auto symbol = [&] (int64_t k) -> float {
+    if (k < 0 || k >= (int64_t) nsymbols) {
+      return 0.0f;
+    }
+    // Bit 1 maps to a negative symbol (see Quantize)
+    return ((bits[k / 8] >> (7 - (k % 8))) & 0x1) ? -1.0f : +1.0f;
+  };
+
+  // Round up to a whole number of blocks; the tail is only noise
+  const size_t nblocks = ((size_t) (nsymbols * sps) + blockSize - 1) / blockSize;
+  std::vector<Samples> blocks;
+  blocks.reserve(nblocks);
+  for (size_t n = 0; n < nblocks * blockSize; n++) {
+    if ((n % blockSize) == 0) {
+      blocks.emplace_back();
+      blocks.back().reserve(blockSize);
+    }
+
+    // Sum contributions of neighboring symbols
+    const double tau = n / sps;
+    const int64_t k0 = (int64_t) tau;
+    float acc = 0.0f;
+    for (int64_t k = k0 - span + 1; k <= k0 + span; k++) {
+      const auto idx = (int) ((tau - k + span) * phases + 0.5);
+      acc += symbol(k) * pulse[idx];
+    }
+
+    // Apply frequency offset and noise
+    const auto s = std::complex<float>((double) acc * carrier);
+    blocks.back().emplace_back(
+      s.real() + noise(gen),
+      s.imag() + noise(gen));
+    carrier *= rotate;
+
+    // Counter accumulation of rounding errors
+    if ((n % 1024) == 0) {
+      carrier /= std::abs(carrier);
+    }
+  }
+
+  return blocks;
+}
+
+SyntheticSource::SyntheticSource(
+    uint32_t sampleRate,
+    const std::vector<Samples>& blocks,
+    RawSamples::Format format) :
+    sampleRate_(sampleRate) {
+  // Round to nearest and clamp to full scale
+  auto fixed = [] (float v, float scale, float offset, float min, float max) {
+    return std::min(max, std::max(min, roundf(v * scale + offset)));
+  };
+
+  blocks_.resize(blocks.size());
+  for (size_t i = 0; i < blocks.size(); i++) {
+    const auto& in = blocks[i];
+    auto& out = blocks_[i];
+    out.resize(format, in.size());
+    const float* fi = (const float*) in.data();
+    const size_t n = 2 * in.size();
+    switch (format) {
+    case RawSamples::CU8:
+      for (size_t j = 0; j < n; j++) {
+        out.as<uint8_t>()[j] = fixed(fi[j], 128.0f, 127.4f, 0.0f, 255.0f);
+      }
+      break;
+    case RawSamples::CS8:
+      for (size_t j = 0; j < n; j++) {
+        out.as<int8_t>()[j] = fixed(fi[j], 127.0f, 0.0f, -127.0f, 127.0f);
+      }
+      break;
+    case RawSamples::CS16:
+      for (size_t j = 0; j < n; j++) {
+        out.as<int16_t>()[j] = fixed(fi[j], 32768.0f, 0.0f, -32768.0f, 32767.0f);
+      }
+      break;
+    case RawSamples::CF32:
+      memcpy(out.as<float>(), fi, n * sizeof(float));
+      break;
+    }
+  }
+}
+
+SyntheticSource::~SyntheticSource() {
+}
+
+uint32_t SyntheticSource::getSampleRate() const {
+  return sampleRate_;
+}
+
+void SyntheticSource::loop() {
+  for (const auto& block : blocks_) {
+    auto out = queue_->popForWrite();
+    out->format = block.format;
+    out->data.assign(block.data.begin(), block.data.end());
+    stamp(*out);
+    queue_->pushWrite(std::move(out));
+  }
+
+  // Signal end of stream
+  queue_->close();
+}
+
+void SyntheticSource::start(const std::shared_ptr<Queue<RawSamples> >& queue) {
+  queue_ = queue;
+  thread_ = std::thread(&SyntheticSource::loop, this);
+  setThreadName(thread_, "synthetic");
+}
+
+void SyntheticSource::stop() {
+  // Wait for thread to terminate
+  thread_.join();
+
+  // Close queue to signal downstream (no-op if loop finished)
+  queue_->close();
+
+  // Clear reference to queue
+  queue_.reset();
+}
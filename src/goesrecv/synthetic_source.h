@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "source.h"
+
+// Generates a baseband LRIT or HRIT signal from synthetic frames.
+//
+// Every frame is Reed-Solomon encoded, randomized, and prefixed with
+// the sync word. The resulting bit stream is NRZ-M encoded (HRIT only),
+// convolutionally encoded, BPSK modulated with an RRC pulse shape, and
+// impaired with a frequency offset, a symbol clock offset, and
+// additive white Gaussian noise.
+//
+class SignalGenerator {
+public:
+  struct Params {
+    // HRIT or LRIT
+    bool hrit = true;
+
+    uint32_t sampleRate = 2400000;
+
+    // Number of frames to generate
+    int frames = 100;
+
+    // Signal to noise ratio (Es/N0 in dB)
+    float snr = 10.0f;
+
+    // Carrier frequency offset in Hz
+    float frequencyOffset = 0.0f;
+
+    // Symbol clock offset in parts per million
+    float clockDrift = 0.0f;
+
+    // Roll-off factor of the pulse shape
+    float rollOff = 0.5f;
+
+    // Seed for frame contents, noise, and carrier phase
+    unsigned seed = 0;
+  };
+
+  explicit SignalGenerator(const Params& params);
+
+  uint32_t getSymbolRate() const;
+
+  // Returns signal in blocks of blockSize samples.
+  // The final block is padded with noise.
+  std::vector<Samples> generate(size_t blockSize);
+
+protected:
+  // Returns convolutionally encoded bit stream
+  std::vector<uint8_t> encode(size_t* nbits);
+
+  Params params_;
+};
+
+// Source that produces a fixed set of sample blocks as fast as the
+// demodulator consumes them and closes its queue when it is done.
+// The blocks are converted to the specified format up front, to
+// mimic sources that produce fixed point samples.
+class SyntheticSource : public Source {
+public:
+  explicit SyntheticSource(
+      uint32_t sampleRate,
+      const std::vector<Samples>& blocks,
+      RawSamples::Format format = RawSamples::CF32);
+  virtual ~SyntheticSource();
+
+  virtual uint32_t getSampleRate() const override;
+
+  virtual void start(const std::shared_ptr<Queue<RawSamples> >& queue) override;
+
+  virtual void stop() override;
+
+protected:
+  void loop();
+
+  const uint32_t sampleRate_;
+  std::vector<RawSamples> blocks_;
+  std::thread thread_;
+
+  // Set on start; cleared on stop
+  std::shared_ptr<Queue<RawSamples> > queue_;
+};
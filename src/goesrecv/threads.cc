@@ -0,0 +1,152 @@
+#include "threads.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <ctime>
+#include <cstring>
+#include <exception>
+#include <sstream>
+#include <stdexcept>
+
+#include <util/error.h>
+
+namespace {
+
+void setThreadAffinity(
+    pthread_t thread,
+    const std::string& name,
+    const std::vector<int>& cpus) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (const auto cpu : cpus) {
+    CPU_SET(cpu, &set);
+  }
+  auto rv = pthread_setaffinity_np(thread, sizeof(set), &set);
+  if (rv != 0) {
+    std::stringstream ss;
+    ss << "Unable to pin thread \"" << name << "\" to CPU";
+    for (const auto cpu : cpus) {
+      ss << " " << cpu;
+    }
+    ss << ": " << strerror(rv);
+    throw std::runtime_error(ss.str());
+  }
+#else
+  throw std::runtime_error("Thread affinity is only supported on Linux");
+#endif
+}
+
+void setThreadPriority(pthread_t thread, const std::string& name, int priority) {
+  struct sched_param param;
+  memset(&param, 0, sizeof(param));
+  param.sched_priority = priority;
+  auto rv = pthread_setschedparam(thread, SCHED_FIFO, &param);
+  if (rv != 0) {
+    std::stringstream ss;
+    ss << "Unable to set real-time priority " << priority;
+    ss << " for thread \"" << name << "\": " << strerror(rv);
+    if (rv == EPERM) {
+      ss << " (needs CAP_SYS_NICE or an rtprio limit, see limits.conf(5))";
+    }
+    throw std::runtime_error(ss.str());
+  }
+}
+
+void configure(
+    pthread_t thread,
+    const std::string& name,
+    const std::map<std::string, Config::Thread>& threads) {
+  auto it = threads.find(name);
+  if (it == threads.end()) {
+    return;
+  }
+
+  const auto& config = it->second;
+  if (!config.cpus.empty()) {
+    setThreadAffinity(thread, name, config.cpus);
+  }
+  if (config.priority > 0) {
+    setThreadPriority(thread, name, config.priority);
+  }
+}
+
+} // namespace
+
+void setThreadName(std::thread& thread, const std::string& name) {
+#ifdef __APPLE__
+  pthread_setname_np(name.c_str());
+#else
+  pthread_setname_np(thread.native_handle(), name.c_str());
+#endif
+}
+
+void configureThread(
+    std::thread& thread,
+    const std::string& name,
+    const std::map<std::string, Config::Thread>& threads) {
+  setThreadName(thread, name);
+  configure(thread.native_handle(), name, threads);
+}
+
+void configureCurrentThread(
+    const std::string& name,
+    const std::map<std::string, Config::Thread>& threads) {
+#ifdef __APPLE__
+  pthread_setname_np(name.c_str());
+#else
+  pthread_setname_np(pthread_self(), name.c_str());
+#endif
+  configure(pthread_self(), name, threads);
+}
+
+void checkThreadConfig(
+    const std::string& name,
+    const std::map<std::string, Config::Thread>& threads) {
+  std::exception_ptr error;
+  std::thread thread([&] {
+      try {
+        configureCurrentThread(name, threads);
+      } catch (...) {
+        error = std::current_exception();
+      }
+    });
+  thread.join();
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+void lowerCurrentThreadPriority() {
+#ifdef __linux__
+  setpriority(PRIO_PROCESS, syscall(SYS_gettid), 19);
+#endif
+}
+
+void lockMemory() {
+  auto rv = mlockall(MCL_CURRENT | MCL_FUTURE);
+  if (rv != 0) {
+    std::stringstream ss;
+    ss << "Unable to lock memory: " << strerror(errno);
+    if (errno == ENOMEM || errno == EPERM) {
+      ss << " (needs CAP_IPC_LOCK or a memlock limit, see limits.conf(5))";
+    }
+    throw std::runtime_error(ss.str());
+  }
+}
+
+int64_t threadCPUTime() {
+  struct timespec ts;
+  auto rv = clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  ASSERT(rv >= 0);
+  return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
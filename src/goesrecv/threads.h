@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <thread>
+
+#include "config.h"
+
+// Set name of thread such that it shows up in tools like top(1).
+void setThreadName(std::thread& thread, const std::string& name);
+
+// Name thread and apply the settings configured for this name (if any).
+void configureThread(
+    std::thread& thread,
+    const std::string& name,
+    const std::map<std::string, Config::Thread>& threads);
+
+// Same as configureThread, for threads that are not created by us
+// (e.g. the thread running the callbacks of a device library).
+void configureCurrentThread(
+    const std::string& name,
+    const std::map<std::string, Config::Thread>& threads);
+
+// Applies the settings configured for this name (if any) to a short
+// lived thread. Throws if they can't be applied. Use this to check the
+// settings for a thread that configureCurrentThread is called on
+// later, where an error can't be handled.
+void checkThreadConfig(
+    const std::string& name,
+    const std::map<std::string, Config::Thread>& threads);
+
+// Gives the calling thread the lowest scheduling priority, for
+// threads that serve clients and must not delay the stages.
+// Only has an effect on Linux, where the nice value is per thread.
+void lowerCurrentThreadPriority();
+
+// Lock current and future memory of the process in RAM. Throws if
+// the process lacks the privilege or the memlock limit is too low.
+void lockMemory();
+
+// Returns CPU time consumed by the calling thread (in nanoseconds).
+// This excludes time spent waiting, so it measures the actual cost of
+// the work done by a thread, regardless of what other threads do.
+int64_t threadCPUTime();
@@ -1,8 +1,103 @@
 #pragma once
 
+#include <chrono>
 #include <complex>
+#include <cstdint>
 #include <vector>
 
 #include "queue.h"
 
-typedef std::vector<std::complex<float> > Samples;
+// Sequence number and capture time of a block of samples.
+//
+// Sources stamp every block they produce. Every stage copies the
+// stamp of its input block to its output block, such that the time
+// a block spent in goesrecv can be measured at any point downstream.
+// Stages that carry samples over from one block to the next stamp
+// their output with the most recent input block.
+//
+struct Timestamp {
+  // Nanoseconds on the monotonic clock
+  static int64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  // Sequence number of the block at the source
+  uint64_t seq = 0;
+
+  // Capture time (see now()); 0 if the block was never stamped
+  int64_t time = 0;
+};
+
+// Vector that carries the timestamp of the samples it holds
+template <typename T>
+class Block : public std::vector<T> {
+public:
+  using std::vector<T>::vector;
+
+  Timestamp timestamp;
+};
+
+typedef Block<std::complex<float> > Samples;
+
+typedef Block<int8_t> SoftBits;
+
+// Block of samples as produced by a source.
+//
+// Sources that produce fixed point samples (e.g. the RTL-SDR) pass
+// them on as is instead of converting them to float. This cuts the
+// memory bandwidth between the source and the first stage by 4x for
+// 8 bit samples and by 2x for 16 bit samples. The first stage
+// converts them to float as it reads them (see convert.h).
+//
+struct RawSamples {
+  enum Format {
+    // Unsigned 8 bit I/Q with a DC offset of 127.4 (RTL-SDR)
+    CU8,
+    // Signed 8 bit I/Q, full scale is 127
+    CS8,
+    // Signed 16 bit I/Q, full scale is 32768
+    CS16,
+    // 32 bit float I/Q
+    CF32,
+  };
+
+  static size_t sampleSize(Format format) {
+    switch (format) {
+    case CU8:
+    case CS8:
+      return 2 * sizeof(int8_t);
+    case CS16:
+      return 2 * sizeof(int16_t);
+    case CF32:
+      return 2 * sizeof(float);
+    }
+    return 0;
+  }
+
+  // Number of samples
+  size_t size() const {
+    return data.size() / sampleSize(format);
+  }
+
+  // Changes format and number of samples.
+  // Retains the associated memory allocation.
+  void resize(Format f, size_t nsamples) {
+    format = f;
+    data.resize(nsamples * sampleSize(format));
+  }
+
+  template <typename T>
+  T* as() {
+    return reinterpret_cast<T*>(data.data());
+  }
+
+  template <typename T>
+  const T* as() const {
+    return reinterpret_cast<const T*>(data.data());
+  }
+
+  Format format = CF32;
+  std::vector<uint8_t> data;
+  Timestamp timestamp;
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+// Runtime CPU feature detection.
+//
+// The build does not assume any x86 instruction set extensions, so
+// vectorized kernels are compiled with a function level target
+// attribute and only called if the CPU that we run on supports the
+// instruction set they were compiled for.
+//
+// On ARM, NEON is selected at compile time (see CMakeLists.txt).
+//
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_DISPATCH 1
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+namespace util {
+namespace cpu {
+
+enum Level {
+  GENERIC = 0,
+  SSE41 = 1,
+  AVX2 = 2,
+};
+
+inline const char* levelToString(Level level) {
+  switch (level) {
+  case GENERIC:
+    return "generic";
+  case SSE41:
+    return "SSE4.1";
+  case AVX2:
+    return "AVX2";
+  }
+  return "";
+}
+
+// Highest instruction set level supported by this CPU.
+inline Level detect() {
+#ifdef HAVE_X86_DISPATCH
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return AVX2;
+  }
+  if (__builtin_cpu_supports("sse4.1")) {
+    return SSE41;
+  }
+#endif
+  return GENERIC;
+}
+
+// Instruction set level that kernels should use.
+// Defaults to the highest level supported by this CPU.
+inline Level& level() {
+  static Level level = detect();
+  return level;
+}
+
+// Lower the instruction set level used by kernels (e.g. to compare
+// the performance of different implementations in a benchmark).
+inline void setLevel(Level l) {
+  if (l < detect()) {
+    level() = l;
+  } else {
+    level() = detect();
+  }
+}
+
+} // namespace cpu
+} // namespace util
@@ -10,9 +10,12 @@ std::string stringTime() {
   struct timespec ts;
   auto rv = clock_gettime(CLOCK_REALTIME, &ts);
   ASSERT(rv >= 0);
+  // Called from multiple threads (e.g. demodulator and decoder)
+  struct tm tm;
+  gmtime_r(&ts.tv_sec, &tm);
   std::array<char, 128> tsbuf;
   auto len = strftime(
-      tsbuf.data(), tsbuf.size(), "%Y-%m-%dT%H:%M:%S.", gmtime(&ts.tv_sec));
+      tsbuf.data(), tsbuf.size(), "%Y-%m-%dT%H:%M:%S.", &tm);
   len += snprintf(
       tsbuf.data() + len, tsbuf.size() - len, "%03ldZ", ts.tv_nsec / 1000000);
   ASSERT(len < tsbuf.size());